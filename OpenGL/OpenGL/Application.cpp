@@ -15,7 +15,9 @@
 
 // Shader Classes by Thomas Angeland
 #include "Shader.h"
-#include "Framebuffer.h"
+#include "ShaderVariants.h"
+#include "GLState.h"
+#include "RenderGraph.h"
 // 3D Object classes by Thomas Angeland
 #include "CubeMap.h"
 #include "Rectangle.h"
@@ -25,8 +27,21 @@
 #include "Diamond.h"
 // Texture Classes by Thomas Angeland
 #include "Texture.h"
+#include "TextureCache.h"
 #include "Material.h"
+#include "MaterialLibrary.h"
 #include "CloudTexture.h"
+#include "CloudNoise.h"
+#include "CloudLighting.h"
+#include "CloudSky.h"
+#include "DepthTiles.h"
+#include "CloudBricks.h"
+#include "CloudRaymarcher.h"
+#include "Bloom.h"
+#include "DynamicResolution.h"
+#include "UniformBuffer.h"
+#include "LightBuffer.h"
+#include "LightClusters.h"
 // 3D Light class by Thomas Angeland
 #include "Light.h"
 #include "DirectionalLight.h"
@@ -46,14 +61,20 @@
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 
 // Presets
 #define DEBUG true
 #define FULLSCREEN false
-#define MSAA_SAMPLES 4
 #define DRAW_WIREFRAME false
+#define CLOUD_QUALITY CloudNoise::MEDIUM
+#define CLOUD_TEMPORAL true
+#define CLOUD_SKY true
+#define CLOUD_BRICKS true
+#define DYNAMIC_RESOLUTION true
 double getTimeSeconds(clock_t time_begin, clock_t time_end);
+float halton(int index, int base);
 clock_t start_time_init;
 
 //Enables Vsync
@@ -61,13 +82,15 @@ bool vsync = true;
 
 // Window
 const char window_title[] = "ITF21215 OpenGL group project";
-const int openGL_min = 4, openGL_max = 4;
+const int openGL_min = 5, openGL_max = 4;
 GLFWwindow* window;
 unsigned int WINDOW_WIDTH = 1200, WINDOW_HEIGHT = 700;
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
-void renderObjects(mat4 projection, mat4 view);
-void renderLights(mat4 projection, mat4 view);
+void renderObjects(const mat4 & view, const mat4 & projection);
+Shader * objectVariant(int material, ShaderVariants::Features lights);
+void updateLights();
+void renderLights();
 void processInput(GLFWwindow *window,float deltaTime);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -109,7 +132,7 @@ Text text;
 bool playerConsole = true;
 bool holdTab = false;
 std::string keyInputMenu = "WASD = movement | SPACE = Jump | I = inverted mouse controls | F1 = on/off clouds | 1/2 = clouds render distance"; //<-- Legg til her
-std::string keyInputMenu2 = "B = on/off Bloom | Q/E = increasing/decreasing bloom | G = on/off collision and gravity ";
+std::string keyInputMenu2 = "B = on/off Bloom | Q/E = increasing/decreasing bloom | G = on/off collision and gravity | F2/F3 = on/off FXAA/TAA | F4 = forward/deferred | L = on/off light field";
 
 // Lights
 std::vector<Light> lights;
@@ -118,14 +141,77 @@ vec3 sunPosition = vec3(1000.0f, 1000.0f, 0.0f);
 vec3 sunColor = vec3(1.0f, 1.0f, 0.5f);
 vec3 lightColor = vec3(1.0f, 0.5f, 1.0f);
 SpotLight flashlight = SpotLight(&player.camera, vec3(1.0f));
-
-// Framebuffers
-Framebuffer cloudFBO;
-Framebuffer sceneFBO;
-Framebuffer pingpongFBO[2];
+// A grid of small colored lights over the ground, to see the clusters at work
+const int LIGHT_FIELD_SIZE = 16;
+const float LIGHT_FIELD_SPACING = 5.0f;
+std::vector<Light> light_field;
+bool render_light_field = false;
+
+// Camera and lights of the frame, shared by every program through the uniform blocks
+UniformBuffer camera_buffer;
+LightBuffer light_buffer;
+// The point and spot lights of the frame sorted into clusters of the view, the object shader only reads the lights of
+// the cluster of every fragment
+LightClusters light_clusters;
+
+// Render targets of the frame
+RenderGraph graph;
 
 // Shaders
-Shader objectShader, lightShader, blurShader, bloomShader, cloudShader, cubeMapShader;
+// The object shader is built per material and per set of light counts, with the unused paths compiled out
+ShaderVariants object_variants;
+// The same per material, for the G-buffer of the deferred path
+ShaderVariants gbuffer_variants;
+Shader lightShader, bloomShader, cloudShader, cloudResolveShader, cloudSkyShader, cubeMapShader, fxaaShader, taaShader, deferredShader;
+
+// Temporal clouds: one pixel of every 4x4 block is marched per frame, in the order of a 4x4 Bayer matrix so
+// the pixels of consecutive frames are far apart. The rest is reprojected from the previous frames
+const int CLOUD_BLOCK = 4;
+const int CLOUD_BAYER_ORDER[16][2] = {
+	{ 0, 0 }, { 2, 2 }, { 2, 0 }, { 0, 2 }, { 1, 1 }, { 3, 3 }, { 3, 1 }, { 1, 3 },
+	{ 1, 0 }, { 3, 2 }, { 3, 0 }, { 1, 2 }, { 0, 1 }, { 2, 3 }, { 2, 1 }, { 0, 3 }
+};
+unsigned int cloud_frame = 0;
+bool cloud_history_valid = false;
+mat4 previous_view, previous_projection;
+vec3 previous_cloud_position;
+
+// Cloud sky: clouds further away than CLOUD_SKY_NEAR are baked into a cubemap, one tile of a face per frame
+const float CLOUD_SKY_NEAR = 150.0f;
+const int CLOUD_SKY_SIZE = 512;
+const int CLOUD_SKY_TILES = 2;
+CloudSky cloud_sky;
+
+// Smallest and largest scene depth per tile, so clouds stop at the scene
+DepthTiles depth_tiles;
+
+// Bloom: the bright color is blurred down a chain of BLOOM_LEVELS half size textures and back up again
+const int BLOOM_LEVELS = 6;
+const float BLOOM_RADIUS = 1.0f;
+Bloom bloom_chain;
+
+// Dynamic resolution: the scene and clouds are rendered smaller, in steps of RENDER_SCALE_STEP, while the GPU takes longer
+// than RENDER_TARGET_MS per frame. The composite upscales them to the window with sharpening
+const float RENDER_TARGET_MS = 14.0f;
+const float RENDER_SCALE_MIN = 0.5f;
+const float RENDER_SCALE_STEP = 0.125f;
+const float RENDER_SHARPNESS = 0.5f;
+DynamicResolution dynamic_resolution;
+
+// Anti-aliasing of the tonemapped image at the window resolution. FXAA blends along the edges it finds in the image,
+// TAA renders the scene with a different sub-pixel offset every frame (the first TAA_JITTER_FRAMES of the Halton (2, 3)
+// sequence) and blends the frames together
+const int TAA_JITTER_FRAMES = 8;
+const float TAA_BLEND = 0.1f;
+bool fxaa = true, taa = false;
+unsigned int taa_frame = 0;
+bool taa_history_valid = false;
+
+// Deferred shading: the objects write their surface to a G-buffer (albedo, specular and normals, at units 6 to 8 when
+// read), and every pixel is lit once after by the directional lights and the lights of its cluster. Forward shading
+// lights the objects as they are drawn
+const int GBUFFER_UNIT = 6;
+bool deferred = false;
 
 // Cubemap
 CubeMap cubemap = CubeMap();
@@ -143,7 +229,14 @@ Rect rect = Rect(1.0f, 1.0f);
 
 // Textures & Materials
 Material metal, tile, mixedstone;
+// The maps of the materials in texture arrays, the draws only pick their index
+MaterialLibrary material_library;
+int metal_material, tile_material, mixedstone_material;
 Texture cloud_texture, cloud_structure_texture;
+CloudLighting cloud_lighting;
+// Sparse brick cloudscape, kept within CLOUD_BRICK_BUDGET MB of bricks on the GPU
+CloudBricks cloud_bricks;
+const int CLOUD_BRICK_BUDGET = 32;
 
 void initGLFWindow()
 {
@@ -165,8 +258,8 @@ void initGLFWindow()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, openGL_min);
 	// Get access to a smaller subset of OpenGL features (no backwards-compatibility)
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	// Use multisample buffer with 4 samples (MSAA)
-	glfwWindowHint(GLFW_SAMPLES, MSAA_SAMPLES);
+	// The scene is rendered to single sample textures and anti-aliased after tonemapping, the window needs no samples
+	glfwWindowHint(GLFW_SAMPLES, 0);
 
 	// Create a window and it's OpenGL context
 
@@ -184,11 +277,9 @@ void initGLFWindow()
 	glfwSwapInterval(vsync);
 
 	// Configure global OpenGL state
-	glEnable(GL_DEPTH_TEST);
-	// Enable MSAA Anti-Aliasing
-	glEnable(GL_MULTISAMPLE);
+	GLState::enable(GL_DEPTH_TEST);
 	// Enable gamma correction with OpenGL built in sRGB buffer
-	glEnable(GL_FRAMEBUFFER_SRGB);
+	GLState::enable(GL_FRAMEBUFFER_SRGB);
 
 	glewExperimental = GL_TRUE;
 
@@ -206,8 +297,32 @@ void initGLFWindow()
 }
 
 
-void main()
+/* Test the CPU cloud raymarcher against the reference stored next to the noise it was rendered from, without opening a
+window. With update the reference is written from this render instead. Returns the exit code */
+int cloudReferenceCheck(bool update)
+{
+	std::string noise_path = CloudNoise::cache(CloudNoise::settings(CLOUD_QUALITY), "resources/textures");
+	std::string base_path = noise_path.substr(0, noise_path.rfind('.'));
+	CloudRaymarcher raymarcher;
+	if (!raymarcher.init(noise_path.c_str()))
+		return EXIT_FAILURE;
+	if (update)
+		return raymarcher.writeReference((base_path + "_reference.bin").c_str()) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	bool passed = raymarcher.check((base_path + "_reference.bin").c_str(), (base_path + "_diff.ppm").c_str());
+	printf(passed ? "Cloud reference check passed\n" : "Cloud reference check failed\n");
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void main(int argc, char * argv[])
 {
+	// Headless runs: --cloud-reference-check, or --update-cloud-reference after an intended change to the clouds
+	for (int i = 1; i < argc; i++) {
+		bool update = strcmp(argv[i], "--update-cloud-reference") == 0;
+		if (update || strcmp(argv[i], "--cloud-reference-check") == 0)
+			exit(cloudReferenceCheck(update));
+	}
+
 	//init GLFW window
 	initGLFWindow();
 
@@ -226,8 +341,8 @@ void main()
 	glfwSetKeyCallback(window, key_callback);
 
 	//Blending proporties
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::enable(GL_BLEND);
+	GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	//Init fonts and gets native fonts from windows
 	text.initFonts("C:/Windows/Fonts/Arial.ttf", WINDOW_HEIGHT, WINDOW_WIDTH);
@@ -240,10 +355,19 @@ void main()
 	// ===========================================================================================
 	printf("\nSetting up shaders...\n");
 
-	printf("Loading object shader...\n");
-	if (objectShader.init("shaders/object_vert.shader", "shaders/object_frag.shader") != 0) {
+	// The object shader variants are built once the materials and lights are known
+	object_variants.init("shaders/object_vert.shader", "shaders/object_frag.shader", MaterialLibrary::setSamplers);
+	gbuffer_variants.init("shaders/object_vert.shader", "shaders/gbuffer_frag.shader", MaterialLibrary::setSamplers);
+
+	printf("Loading deferred lighting shader...\n");
+	if (deferredShader.init("shaders/bloom_vert.shader", "shaders/deferred_frag.shader") != 0) {
 		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
 	}
+	deferredShader.use();
+	deferredShader.setInt("g_albedo", GBUFFER_UNIT);
+	deferredShader.setInt("g_specular", GBUFFER_UNIT + 1);
+	deferredShader.setInt("g_normals", GBUFFER_UNIT + 2);
+	deferredShader.setInt("scene_depth", 11);
 
 	printf("Loading light shader...\n");
 	if (lightShader.init("shaders/light_vert.shader", "shaders/light_frag.shader") != 0) {
@@ -260,8 +384,13 @@ void main()
 		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
 	}
 
-	printf("Loading blur shader...\n");
-	if (blurShader.init("shaders/blur_vert.shader", "shaders/blur_frag.shader") != 0) {
+	printf("Loading cloud sky shader...\n");
+	if (cloudSkyShader.init("shaders/cloud_vert.shader", "shaders/cloud_frag.shader") != 0) {
+		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
+	}
+
+	printf("Loading cloud resolve shader...\n");
+	if (cloudResolveShader.init("shaders/cloud_vert.shader", "shaders/cloud_resolve_frag.shader") != 0) {
 		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
 	}
 
@@ -270,13 +399,11 @@ void main()
 		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
 	}
 
-	// Set object shader uniforms
-	objectShader.use();
-	objectShader.setInt("material.diffuse", 0);
-	objectShader.setInt("material.specular", 1);
-	objectShader.setInt("material.normal", 2);
-	objectShader.setInt("material.displacement", 3);
-	objectShader.setInt("material.ao", 4);
+	printf("Loading anti-aliasing shaders...\n");
+	if (fxaaShader.init("shaders/bloom_vert.shader", "shaders/fxaa_frag.shader") != 0 ||
+		taaShader.init("shaders/bloom_vert.shader", "shaders/taa_frag.shader") != 0) {
+		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
+	}
 
 	// Set cubemap shader uniforms
 	cubeMapShader.use();
@@ -286,27 +413,71 @@ void main()
 	cloudShader.use();
 	cloudShader.setInt("diffuse_buffer", 10);
 	cloudShader.setInt("depth_buffer", 11);
-
-	// Set blur shader uniforms
-	blurShader.use();
-	blurShader.setInt("image", 0);
+	cloudShader.setInt("depth_tiles", 9);
+	cloudShader.setInt("depth_tile_size", DepthTiles::TILE_SIZE);
+	cloudShader.setBool("temporal", CLOUD_TEMPORAL);
+	cloudShader.setInt("block_size", CLOUD_BLOCK);
+	// Longer steps when temporal, the jittered start hides the banding over a few frames
+	cloudShader.setFloat("step_size", CLOUD_TEMPORAL ? 2.0f : 1.0f);
+	// Only the clouds in front of the baked sky are marched per pixel
+	cloudShader.setFloat("stop", CLOUD_SKY ? CLOUD_SKY_NEAR : 1e6f);
+
+	// Set cloud sky shader uniforms, it writes the clouds alone for every pixel of a cubemap face
+	cloudSkyShader.use();
+	cloudSkyShader.setInt("diffuse_buffer", 10);
+	cloudSkyShader.setBool("temporal", true);
+	cloudSkyShader.setInt("block_size", 1);
+	cloudSkyShader.setVec2("pixel_offset", 0.0f, 0.0f);
+	cloudSkyShader.setFloat("step_size", 2.0f);
+	cloudSkyShader.setFloat("start", CLOUD_SKY_NEAR);
+
+	// Set cubemap shader uniforms for the baked clouds
+	cubeMapShader.use();
+	cubeMapShader.setInt("previous_clouds", 12);
+	cubeMapShader.setInt("clouds", 13);
+
+	// Set cloud resolve shader uniforms
+	cloudResolveShader.use();
+	cloudResolveShader.setInt("diffuse_buffer", 10);
+	cloudResolveShader.setInt("march_color", 12);
+	cloudResolveShader.setInt("march_depth", 13);
+	cloudResolveShader.setInt("previous_color", 14);
+	cloudResolveShader.setInt("previous_depth", 15);
+	cloudResolveShader.setInt("block_size", CLOUD_BLOCK);
+
+	// Set bloom shader uniforms
 	bloomShader.use();
 	bloomShader.setInt("HDR_buffer", 0);
 	bloomShader.setInt("bloom_blur", 5);
 
+	// Set anti-aliasing shader uniforms
+	fxaaShader.use();
+	fxaaShader.setInt("image", 0);
+	taaShader.use();
+	taaShader.setInt("current_color", 0);
+	taaShader.setInt("previous_color", 1);
+	taaShader.setInt("scene_depth", 11);
+	taaShader.setFloat("blend", TAA_BLEND);
+
 	// ===========================================================================================
 	// FRAMEBUFFERS
 	// ===========================================================================================
 	printf("\nSetting up framebuffers...\n");
 
-	// Scenery framebuffer
-	sceneFBO.createSceneFramebuffer(WINDOW_WIDTH, WINDOW_HEIGHT);
-
-	// Clouds framebuffer
-	cloudFBO.createCloudFramebuffer(WINDOW_WIDTH, WINDOW_HEIGHT);
+	// The scene, cloud and history textures are created by the render graph when a frame needs them
+	graph.resize(WINDOW_WIDTH, WINDOW_HEIGHT);
+	if (DYNAMIC_RESOLUTION && !dynamic_resolution.init(RENDER_TARGET_MS, RENDER_SCALE_MIN, 1.0f, RENDER_SCALE_STEP)) {
+		printf("Error: Timer queries are not supported, dynamic resolution is off\n");
+	}
+	if (depth_tiles.init(WINDOW_WIDTH, WINDOW_HEIGHT)) {
+		cloudShader.use();
+		cloudShader.setBool("use_depth", true);
+	}
 
-	// ping-pong framebuffer for blurring
-	Framebuffer::createPingPongFramebuffer(pingpongFBO, WINDOW_WIDTH, WINDOW_HEIGHT);
+	// Bloom chain for blurring
+	if (!bloom_chain.init(WINDOW_WIDTH, WINDOW_HEIGHT, BLOOM_LEVELS)) {
+		printf("Error: Failed to initialize bloom in %s at line %d.\n\n", __FILE__, __LINE__);
+	}
 
 	// ===========================================================================================
 	// LIGHTS - Set up lights
@@ -321,6 +492,24 @@ void main()
 	lights.push_back(PointLight(vec3(1.0f), vec3(0.0f)));
 	lights.push_back(PointLight(vec3(1.0f), vec3(0.0f)));
 
+	// Short range lights with the colors of the rainbow
+	for (int z = 0; z < LIGHT_FIELD_SIZE; z++) {
+		for (int x = 0; x < LIGHT_FIELD_SIZE; x++) {
+			float hue = (float)(x + z * LIGHT_FIELD_SIZE) / (LIGHT_FIELD_SIZE * LIGHT_FIELD_SIZE) * 6.2831853f;
+			vec3 color = vec3(0.5f + 0.5f * cos(hue), 0.5f + 0.5f * cos(hue - 2.0943951f), 0.5f + 0.5f * cos(hue + 2.0943951f));
+			vec3 position = vec3((x - LIGHT_FIELD_SIZE / 2 + 0.5f) * LIGHT_FIELD_SPACING, 0.5f, (z - LIGHT_FIELD_SIZE / 2 + 0.5f) * LIGHT_FIELD_SPACING);
+			light_field.push_back(PointLight(color, position, 0.0f, 1.0f, 0.5f, 1.0f, 0.7f, 1.8f));
+		}
+	}
+
+	// The camera and light blocks of the shaders
+	if (!camera_buffer.init(UniformBuffer::CAMERA_BINDING, sizeof(CameraBlock)) || !light_buffer.init()) {
+		printf("Error: Failed to create uniform buffers in %s at line %d.\n\n", __FILE__, __LINE__);
+	}
+	if (!light_clusters.init()) {
+		printf("Error: Failed to create light cluster buffers in %s at line %d.\n\n", __FILE__, __LINE__);
+	}
+
 	// ===========================================================================================
 	// OBJECTS - Set up vertex data and buffers and configure vertex attributes
 	// ===========================================================================================
@@ -354,36 +543,82 @@ void main()
 	);
 
 	// Load metal textures
-	metal.addDiffuse(Texture("resources/textures/1857-diffuse.jpg"));
-	metal.addSpecular(Texture("resources/textures/1857-specexponent.jpg"));
-	metal.addNormal(Texture("resources/textures/1857-normal.jpg"));
-	metal.addDisplacement(Texture("resources/textures/1857-displacement.jpg"));
+	metal.addDiffuse("resources/textures/1857-diffuse.jpg");
+	metal.addSpecular("resources/textures/1857-specexponent.jpg");
+	metal.addNormal("resources/textures/1857-normal.jpg");
+	metal.addDisplacement("resources/textures/1857-displacement.jpg");
 
 	// Load tile textures
-	tile.addDiffuse(Texture("resources/textures/10744-diffuse.jpg"));
-	tile.addSpecular(Texture("resources/textures/10744-specstrength.jpg"));
-	tile.addNormal(Texture("resources/textures/10744-normal.jpg"));
-	tile.addDisplacement(Texture("resources/textures/10744-displacement.jpg"));
+	tile.addDiffuse("resources/textures/10744-diffuse.jpg");
+	tile.addSpecular("resources/textures/10744-specstrength.jpg");
+	tile.addNormal("resources/textures/10744-normal.jpg");
+	tile.addDisplacement("resources/textures/10744-displacement.jpg");
 
 	// Load mixedstone textures
-	mixedstone.addDiffuse(Texture("resources/textures/mixedstones-diffuse.jpg"));
-	mixedstone.addSpecular(Texture("resources/textures/mixedstones-specular.jpg"));
-	mixedstone.addNormal(Texture("resources/textures/mixedstones-normal.jpg"));
-	mixedstone.addDisplacement(Texture("resources/textures/mixedstones-displace.jpg"));
+	mixedstone.addDiffuse("resources/textures/mixedstones-diffuse.jpg");
+	mixedstone.addSpecular("resources/textures/mixedstones-specular.jpg");
+	mixedstone.addNormal("resources/textures/mixedstones-normal.jpg");
+	mixedstone.addDisplacement("resources/textures/mixedstones-displace.jpg");
+
+	if (DEBUG) {
+		printf("\nTexture memory:\n");
+		TextureCache::printResident();
+	}
+
+	// Pack the maps of the materials into the arrays
+	metal_material = material_library.add(metal);
+	tile_material = material_library.add(tile);
+	mixedstone_material = material_library.add(mixedstone);
+	if (!material_library.build()) {
+		printf("Error: Failed to create the material arrays in %s at line %d.\n\n", __FILE__, __LINE__);
+	}
+
+	// Every material of the scene with the directional lights of the scene, compiled together. The point and spot
+	// lights come from the clusters
+	printf("\nLoading object shader variants...\n");
+	ShaderVariants::Features scene_lights = ShaderVariants::lightCounts(Light::numDirectionalLights(), 0, 0, 0);
+	if (!object_variants.prepare({ material_library.features(metal_material) | scene_lights, material_library.features(tile_material) | scene_lights,
+		material_library.features(mixedstone_material) | scene_lights })) {
+		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
+	}
+	if (!gbuffer_variants.prepare({ material_library.features(metal_material), material_library.features(tile_material),
+		material_library.features(mixedstone_material) })) {
+		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
+	}
 
+	// The cloud noise is generated once per quality tier and cached next to the other textures
 	printf("\nLoading 3D cloud texture...\n");
-	if (createTexture3DFromEX5(&cloud_texture, "resources/textures/noise5.ex5") == false) {
+	std::vector<GLubyte> cloud_density;
+	if (CloudNoise::create(&cloud_texture, CloudNoise::settings(CLOUD_QUALITY), "resources/textures", &cloud_density) == false) {
 		printf("ERROR :: Failed to load texture in %s at line %d.\n\n", __FILE__, __LINE__);
 	}
 
 	// Preprocess the structure of the noise based clouds
 	printf("Preprocessing cloud structure...");
-	CloudTexture::process(&cloud_structure_texture, cloud_texture);
+	CloudTexture::process(&cloud_structure_texture, cloud_density, cloud_texture.width, cloud_texture.height, cloud_texture.depth);
 
 	// Send textures to shaders
 	cloudShader.setTexture3D(cloud_texture, "cloud_texture");
 	cloudShader.setTexture3D(cloud_structure_texture, "cloud_structure");
 
+	// Sun transmittance volume at the resolution of the noise, built on the first frame with clouds
+	if (cloud_lighting.init(cloud_texture.width)) {
+		cloudShader.setTexture3D(cloud_lighting.volume, "light_volume");
+		cloudSkyShader.setTexture3D(cloud_lighting.volume, "light_volume");
+	}
+	cloudSkyShader.setTexture3D(cloud_texture, "cloud_texture");
+	cloudSkyShader.setTexture3D(cloud_structure_texture, "cloud_structure");
+
+	if (CLOUD_SKY) {
+		cloud_sky.init(CLOUD_SKY_SIZE, CLOUD_SKY_TILES);
+	}
+
+	// The noise shaped by a weather map, so the sky does not repeat every 800 units
+	if (CLOUD_BRICKS && cloud_bricks.init(CloudNoise::cachePath(CloudNoise::settings(CLOUD_QUALITY), "resources/textures").c_str(), "resources/textures/weather.png", CLOUD_BRICK_BUDGET)) {
+		cloud_bricks.bind(cloudShader);
+		cloud_bricks.bind(cloudSkyShader);
+	}
+
 	// ===========================================================================================
 	// ENTITIES / PLAYER
 	// ===========================================================================================
@@ -411,11 +646,16 @@ void main()
 		// Process input (if any)
 		processInput(window, deltaTime);
 
+		// Measure the GPU time of everything rendered this frame
+		dynamic_resolution.beginFrame();
+
 		increment_0 += 0.05f * deltaTime;
 		increment_1 += 0.15f * deltaTime;
 		increment_2 += 0.30f * deltaTime;
 		increment_3 += 1.0f * deltaTime;
 		lightColor = vec3(abs(sin(increment_0)), abs(sin(increment_1)), abs(sin(increment_2)));
+		// Before any pass, so the light buffers and the light cubes have the same lights in both paths
+		updateLights();
 
 		// Background color (world color)
 		sunPosition = player.camera.Position + vec3(1337, 1337, 1337);
@@ -425,138 +665,369 @@ void main()
 		mat4 view = player.camera.GetViewMatrix();
 		mat4 projection = mat4::makePerspective(player.camera.Fov, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
 
+		// With TAA the scene moves by less than a pixel every frame. The clouds have their own reprojection and use
+		// the projection as it is
+		mat4 scene_projection = projection;
+		if (taa) {
+			int jitter = taa_frame % TAA_JITTER_FRAMES + 1;
+			scene_projection.matrix[8] += (halton(jitter, 2) - 0.5f) * 2.0f / graph.renderWidth();
+			scene_projection.matrix[9] += (halton(jitter, 3) - 0.5f) * 2.0f / graph.renderHeight();
+		}
+
+		// The camera of the scene for every program that draws it
+		CameraBlock camera_block(view, scene_projection, player.camera.Position);
+		camera_buffer.write(&camera_block);
+
+		vec3 cloud_position = vec3(0.0f, 0.0f, increment_2 * 10);
+		const int * cloud_pixel = CLOUD_BAYER_ORDER[cloud_frame % 16];
+
+		// The light volume is built from the repeating noise, the bricks march their light rays instead
+		bool use_light_volume = cloud_lighting.ready() && !cloud_bricks.ready();
+
+		if (render_clouds) {
+			// Page in the bricks the cloud rays can reach
+			cloud_bricks.update(cloud_position, cloud_render_distance);
+			// Only rebuilt when the sun direction, coverage or render distance changed
+			if (!cloud_bricks.ready()) {
+				cloud_lighting.update(cloud_texture, vec3::normalize(sunPosition - cloud_position), cloud_coverage, cloud_render_distance);
+				use_light_volume = cloud_lighting.ready();
+			}
+		}
+
 		cloudShader.setMat4("view", view);
 		cloudShader.setMat4("proj", projection);
 		cloudShader.setMat4("inv_view", mat4::inverse(view));
 		cloudShader.setMat4("inv_proj", mat4::inverse(projection));
-		cloudShader.setVec2("window_size", vec2(WINDOW_WIDTH, WINDOW_HEIGHT));
-		cloudShader.setVec3("camera_position", vec3(0.0f, 0.0f, increment_2 * 10));
+		cloudShader.setVec2("window_size", vec2((float)graph.renderWidth(), (float)graph.renderHeight()));
+		cloudShader.setVec2("pixel_offset", (float)cloud_pixel[0], (float)cloud_pixel[1]);
+		cloudShader.setInt("frame", cloud_frame);
+		cloudShader.setVec3("camera_position", cloud_position);
 		cloudShader.setVec3("sun_position", sunPosition);
 		cloudShader.setFloat("end", cloud_render_distance);
 		cloudShader.setFloat("coverage", cloud_coverage);
+		cloudShader.setBool("use_light_volume", use_light_volume);
+
+		// Bake the next tile of the distant clouds
+		if (render_clouds && CLOUD_SKY) {
+			cloudSkyShader.use();
+			cloudSkyShader.setVec3("sun_position", sunPosition);
+			cloudSkyShader.setFloat("end", cloud_render_distance);
+			cloudSkyShader.setFloat("coverage", cloud_coverage);
+			cloudSkyShader.setBool("use_light_volume", use_light_volume);
+			cloud_sky.bakeNextTile(cloudSkyShader, cloud_position, renderQuad);
+		}
+		cubeMapShader.use();
+		cubeMapShader.setBool("use_clouds", render_clouds && CLOUD_SKY && cloud_sky.ready());
+		cloud_sky.bind(cubeMapShader, 12);
 
 		/*** OpenGL rendering ***/
 
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
+		// The passes of the frame are declared with the textures they read and write. The graph leaves out passes
+		// nobody needs the result of (clouds while they are off, bloom while it is off) and shares texture memory
+		graph.reset();
+		RenderGraph::Resource scene_color = graph.createTexture("scene color", GL_R11F_G11F_B10F);
+		RenderGraph::Resource scene_bright = graph.createTexture("scene bright", GL_R11F_G11F_B10F);
+		RenderGraph::Resource scene_depth = graph.createTexture("scene depth", GL_DEPTH_COMPONENT24, 1, GL_NEAREST);
+		RenderGraph::Resource cloud_color = graph.createTexture("cloud color", GL_R11F_G11F_B10F);
+		RenderGraph::Resource cloud_bright = graph.createTexture("cloud bright", GL_R11F_G11F_B10F);
+		RenderGraph::Resource cloud_tiles = graph.importTexture("depth tiles", depth_tiles.texture);
+		RenderGraph::Resource bloom_blur = graph.importTexture("bloom", bloom_chain.texture());
+		RenderGraph::Resource backbuffer = graph.importTexture("backbuffer", 0);
+
 		// -----------------------------------------------
 		// 1. render terrain and sky
 		// -----------------------------------------------
 
-		sceneFBO.bind();
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (deferred) {
+			RenderGraph::Resource gbuffer_albedo = graph.createTexture("gbuffer albedo", GL_SRGB8_ALPHA8, 1, GL_NEAREST);
+			RenderGraph::Resource gbuffer_specular = graph.createTexture("gbuffer specular", GL_SRGB8_ALPHA8, 1, GL_NEAREST);
+			RenderGraph::Resource gbuffer_normals = graph.createTexture("gbuffer normals", GL_RGBA16F, 1, GL_NEAREST);
+
+			// The alpha of the G-buffer is data, it is written as it is
+			graph.addPass("gbuffer", {}, { gbuffer_albedo, gbuffer_specular, gbuffer_normals, scene_depth }, [&]() {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				GLState::disable(GL_BLEND);
+				renderObjects(view, projection);
+				GLState::enable(GL_BLEND);
+			});
+
+			// The lights are still bound from the objects. Pixels without an object are black until the sky is drawn
+			graph.addPass("deferred lighting", { gbuffer_albedo, gbuffer_specular, gbuffer_normals, scene_depth }, { scene_color, scene_bright }, [&]() {
+				GLState::activeTexture(GL_TEXTURE0 + GBUFFER_UNIT);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(gbuffer_albedo));
+				GLState::activeTexture(GL_TEXTURE0 + GBUFFER_UNIT + 1);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(gbuffer_specular));
+				GLState::activeTexture(GL_TEXTURE0 + GBUFFER_UNIT + 2);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(gbuffer_normals));
+				GLState::activeTexture(GL_TEXTURE11);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(scene_depth));
+				deferredShader.use();
+				deferredShader.setMat4("inv_view", mat4::inverse(view));
+				deferredShader.setMat4("inv_proj", mat4::inverse(scene_projection));
+				renderQuad();
+			});
+
+			// The light cubes and the sky are drawn forward, tested against the depth of the objects
+			graph.addPass("scene forward", {}, { scene_color, scene_bright, scene_depth }, [&]() {
+				renderLights();
+				cubemap.drawCubemap(&cubeMapShader);
+			});
+		}
+		else {
+			graph.addPass("scene", {}, { scene_color, scene_bright, scene_depth }, [&]() {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// Render objects & light
-		renderLights(projection, view);
-		renderObjects(projection, view);
+				// Render objects & light
+				renderLights();
+				renderObjects(view, projection);
 
-		// Draw cubemap
-		cubemap.drawCubemap(&cubeMapShader, &player.camera, projection);
+				// Draw cubemap
+				cubemap.drawCubemap(&cubeMapShader);
+			});
+		}
 
 		// -----------------------------------------------
 		// 2. render clouds
 		// -----------------------------------------------
-		
-		if (render_clouds) {
-			// Render clouds with resolve shader
-			cloudFBO.bind();
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-			// Use cloud shader
-			cloudShader.use();
+		// The clouds stop at the scene depth (unit 11), whole tiles are skipped with the tile depths (unit 9)
+		graph.addPass("depth tiles", { scene_depth }, { cloud_tiles }, [&]() {
+			depth_tiles.reduce(graph.texture(scene_depth));
+		});
+
+		if (CLOUD_TEMPORAL) {
+			RenderGraph::Resource march_color = graph.createTexture("cloud march color", GL_RGBA16F, CLOUD_BLOCK, GL_NEAREST);
+			RenderGraph::Resource march_depth = graph.createTexture("cloud march depth", GL_R32F, CLOUD_BLOCK, GL_NEAREST);
+			RenderGraph::Resource history_color = graph.createPersistentTexture(cloud_frame % 2 ? "cloud history color 1" : "cloud history color 0", GL_RGBA16F);
+			RenderGraph::Resource history_depth = graph.createPersistentTexture(cloud_frame % 2 ? "cloud history depth 1" : "cloud history depth 0", GL_R32F);
+			RenderGraph::Resource previous_color = graph.createPersistentTexture(cloud_frame % 2 ? "cloud history color 0" : "cloud history color 1", GL_RGBA16F);
+			RenderGraph::Resource previous_depth = graph.createPersistentTexture(cloud_frame % 2 ? "cloud history depth 0" : "cloud history depth 1", GL_R32F);
+
+			// March one pixel of every block into the small textures
+			graph.addPass("cloud march", { scene_depth, cloud_tiles }, { march_color, march_depth }, [&]() {
+				// The march and resolve write colors, alpha and distances as they are
+				GLState::disable(GL_BLEND);
+				GLState::activeTexture(GL_TEXTURE9);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(cloud_tiles));
+				GLState::activeTexture(GL_TEXTURE11);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(scene_depth));
+				cloudShader.use();
+				renderQuad();
+				GLState::enable(GL_BLEND);
+			});
+
+			// Fill in the other pixels from last frame's history, write the new history and composite over the scene
+			graph.addPass("cloud resolve", { scene_color, march_color, march_depth, previous_color, previous_depth },
+				{ history_color, history_depth, cloud_color, cloud_bright }, [&]() {
+				GLState::disable(GL_BLEND);
+				cloudResolveShader.use();
+				cloudResolveShader.setVec2("window_size", vec2((float)graph.renderWidth(), (float)graph.renderHeight()));
+				cloudResolveShader.setVec2("pixel_offset", (float)cloud_pixel[0], (float)cloud_pixel[1]);
+				cloudResolveShader.setBool("history_valid", cloud_history_valid && !graph.isNew(previous_color));
+				cloudResolveShader.setVec3("camera_position", cloud_position);
+				cloudResolveShader.setVec3("previous_camera_position", previous_cloud_position);
+				cloudResolveShader.setMat4("inv_view", mat4::inverse(view));
+				cloudResolveShader.setMat4("inv_proj", mat4::inverse(projection));
+				cloudResolveShader.setMat4("previous_view", previous_view);
+				cloudResolveShader.setMat4("previous_proj", previous_projection);
+
+				GLState::activeTexture(GL_TEXTURE10);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(scene_color));
+				GLState::activeTexture(GL_TEXTURE12);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(march_color));
+				GLState::activeTexture(GL_TEXTURE13);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(march_depth));
+				GLState::activeTexture(GL_TEXTURE14);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(previous_color));
+				GLState::activeTexture(GL_TEXTURE15);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(previous_depth));
+				renderQuad();
+				GLState::enable(GL_BLEND);
+
+				cloud_history_valid = true;
+			});
+		}
+		else {
+			// Render clouds over the scene
+			graph.addPass("clouds", { scene_color, scene_depth, cloud_tiles }, { cloud_color, cloud_bright }, [&]() {
+				glClear(GL_COLOR_BUFFER_BIT);
+				GLState::activeTexture(GL_TEXTURE9);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(cloud_tiles));
+				GLState::activeTexture(GL_TEXTURE11);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(scene_depth));
+
+				// Use cloud shader
+				cloudShader.use();
+
+				// Set texture 10 as scene colorbuffer.
+				GLState::activeTexture(GL_TEXTURE10);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(scene_color));
+
+				// Render scene with clouds
+				renderQuad();
+			});
+		}
 
-			// Set texture 10 as scene colorbuffer.
-			glActiveTexture(GL_TEXTURE10);
-			glBindTexture(GL_TEXTURE_2D, sceneFBO.colorBuffer[0]);
+		// The scene with or without clouds
+		RenderGraph::Resource hdr_color = render_clouds ? cloud_color : scene_color;
 
-			// Render scene with clouds
-			renderQuad();
-		}
-		
 		// -----------------------------------------------
-		// 3. render text
+		// 3. blur scene
 		// -----------------------------------------------
-		if (playerConsole) {
-			text.RenderText(player.consolePlayerPosition(), 20.0f, 20.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
-			text.RenderText(player.consolePlayerCollision(), 20.0f, 60.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
-			text.RenderText(player.consoleOtherTings(), 20.0f, 100.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
-		}
 
-		if (player.interactWithEntity)
-		{
-			text.RenderText("Press E", WINDOW_WIDTH / 2 - 20.0f, WINDOW_HEIGHT / 2, 0.7f, vec3(1.0f, 0.0f, 0.0f));
-		}
-		if(!holdTab)
-			text.RenderText("Hold TAB for key-menu", 20.0f, WINDOW_HEIGHT - 40.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));	
-		else {
-			text.RenderText(keyInputMenu, 20.0f, WINDOW_HEIGHT - 40.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
-			text.RenderText(keyInputMenu2, 20.0f, WINDOW_HEIGHT - 80.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
-
-		}
+		// The bright color is downsampled to smaller and smaller textures and upsampled back, which blurs it wider with
+		// every level
+		graph.addPass("bloom", { scene_bright }, { bloom_blur }, [&]() {
+			bloom_chain.render(graph.texture(scene_bright), BLOOM_RADIUS, renderQuad);
+		});
 
 		// -----------------------------------------------
-		// 4. blur scene
+		// 4. render fbo color buffers
 		// -----------------------------------------------
 
-		// This code executes the Gaussian blur. Here we blur the image 30 times, the more we iterate the blurring process, the more blur will be on
-		// the image. Each iteration, the boolean horizontal will change, so it blurs horizontally first, then vertically, into alternating framebuffers.
-		//
-		bool horizontal = true, first_iteration = true;
-		unsigned int amount = 30;
-		blurShader.use();
-		for (unsigned int i = 0; i < amount; i++)
-		{
-			pingpongFBO[horizontal].bind();
-			blurShader.setInt("horizontal", horizontal);
-			glActiveTexture(GL_TEXTURE0);
-			// bind texture of other framebuffer (or scene if first iteration)
-			glBindTexture(GL_TEXTURE_2D, first_iteration ? sceneFBO.colorBuffer[1] : pingpongFBO[!horizontal].colorBuffer[0]);
-			renderQuad();
-			horizontal = !horizontal;
-			if (first_iteration)
-				first_iteration = false;
-		}
+		// Anti-aliasing needs the tonemapped image in a texture, at the window resolution
+		bool anti_aliasing = fxaa || taa;
+		RenderGraph::Resource tonemapped = anti_aliasing ? graph.createWindowTexture("tonemapped", GL_SRGB8_ALPHA8) : backbuffer;
+
+		graph.addPass("composite", { hdr_color, bloom ? bloom_blur : RenderGraph::NONE }, { tonemapped }, [&]() {
+			// Unbind framebuffer
+			if (!anti_aliasing)
+				GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+			// Bind bloom framebuffer
+			bloomShader.use();
+			// Clear framebuffer color and depth
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			// Set texture 0 as scene from the scene or cloud color
+			GLState::activeTexture(GL_TEXTURE0);
+			GLState::bindTexture(GL_TEXTURE_2D, graph.texture(hdr_color));
+
+			// Set texture 5 as bloom from the bloom chain.
+			bloom_chain.bind(bloomShader, 5);
 
+			// Set bloom and expore uniforms
+			bloomShader.setInt("bloom", bloom);
+			bloomShader.setFloat("exposure", exposure);
+			// Sharpen more the smaller the scene was rendered
+			bloomShader.setFloat("sharpness", RENDER_SHARPNESS * (1.0f - dynamic_resolution.scale()) / (1.0f - RENDER_SCALE_MIN));
+
+			// Render scene to screen quad
+			renderQuad();
+		});
 
 		// -----------------------------------------------
-		// 5. render fbo color buffers
+		// 5. anti-aliasing
 		// -----------------------------------------------
 
-		// Unbind framebuffer
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		// Bind bloom framebuffer
-		bloomShader.use();
-		// Clear framebuffer color and depth
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		if (render_clouds) {
-			// Set texture 0 as scene from cloud colorbuffer.
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, cloudFBO.colorBuffer[0]);
-		} else {
-			// Set texture 0 as scene from scene colorbuffer.
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, sceneFBO.colorBuffer[0]);
+		RenderGraph::Resource aliased = tonemapped;
+		if (taa) {
+			RenderGraph::Resource taa_history = graph.createPersistentWindowTexture(taa_frame % 2 ? "taa history 1" : "taa history 0", GL_R11F_G11F_B10F);
+			RenderGraph::Resource taa_previous = graph.createPersistentWindowTexture(taa_frame % 2 ? "taa history 0" : "taa history 1", GL_R11F_G11F_B10F);
+
+			// Blend this frame into the history of the previous frames
+			graph.addPass("taa", { tonemapped, scene_depth, taa_previous }, { taa_history }, [&]() {
+				taaShader.use();
+				taaShader.setBool("history_valid", taa_history_valid && !graph.isNew(taa_previous));
+				taaShader.setMat4("inv_view", mat4::inverse(view));
+				taaShader.setMat4("inv_proj", mat4::inverse(projection));
+				taaShader.setMat4("previous_view", previous_view);
+				taaShader.setMat4("previous_proj", previous_projection);
+
+				GLState::activeTexture(GL_TEXTURE0);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(tonemapped));
+				GLState::activeTexture(GL_TEXTURE1);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(taa_previous));
+				GLState::activeTexture(GL_TEXTURE11);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(scene_depth));
+				renderQuad();
+
+				taa_history_valid = true;
+			});
+			aliased = taa_history;
 		}
 
-		// Set texture 5 as bloom from pingpong colorbuffer.
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_2D, pingpongFBO[!horizontal].colorBuffer[0]);
-
-		// Set bloom and expore uniforms
-		bloomShader.setInt("bloom", bloom);
-		bloomShader.setFloat("exposure", exposure);
+		// FXAA, or a copy of the TAA history, to the window
+		if (anti_aliasing) {
+			graph.addPass("fxaa", { aliased }, { backbuffer }, [&]() {
+				GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+				fxaaShader.use();
+				fxaaShader.setBool("fxaa", fxaa);
+				GLState::activeTexture(GL_TEXTURE0);
+				GLState::bindTexture(GL_TEXTURE_2D, graph.texture(aliased));
+				renderQuad();
+			});
+		}
 
-		// Render scene to screen quad
-		renderQuad();
+		// -----------------------------------------------
+		// 6. render text, at the window resolution
+		// -----------------------------------------------
+		graph.addPass("text", {}, { backbuffer }, [&]() {
+			if (playerConsole) {
+				text.RenderText(player.consolePlayerPosition(), 20.0f, 20.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
+				text.RenderText(player.consolePlayerCollision(), 20.0f, 60.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
+				text.RenderText(player.consoleOtherTings(), 20.0f, 100.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
+				char render_scale[64];
+				snprintf(render_scale, sizeof(render_scale), "Render scale: %d%% GPU: %.1f ms", (int)(dynamic_resolution.scale() * 100.0f + 0.5f), dynamic_resolution.gpuTime());
+				text.RenderText(render_scale, 20.0f, 140.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
+				// State changes of the previous frame that went to GL, and the ones the state cache skipped
+				const GLState::Counters & calls = GLState::lastFrame();
+				char state_calls[96];
+				snprintf(state_calls, sizeof(state_calls), "GL state calls: %u issued %u elided (textures %u/%u)", calls.totalIssued(), calls.totalElided(),
+					calls.issued[GLState::TEXTURE], calls.elided[GLState::TEXTURE]);
+				text.RenderText(state_calls, 20.0f, 180.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
+				char clustered_lights[64];
+				snprintf(clustered_lights, sizeof(clustered_lights), "Clustered lights: %d in %d cluster entries", light_clusters.lightCount(), light_clusters.indexCount());
+				text.RenderText(clustered_lights, 20.0f, 220.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
+			}
+
+			if (player.interactWithEntity)
+			{
+				text.RenderText("Press E", WINDOW_WIDTH / 2 - 20.0f, WINDOW_HEIGHT / 2, 0.7f, vec3(1.0f, 0.0f, 0.0f));
+			}
+			if(!holdTab)
+				text.RenderText("Hold TAB for key-menu", 20.0f, WINDOW_HEIGHT - 40.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));	
+			else {
+				text.RenderText(keyInputMenu, 20.0f, WINDOW_HEIGHT - 40.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
+				text.RenderText(keyInputMenu2, 20.0f, WINDOW_HEIGHT - 80.0f, 0.4f, vec3(1.0f, 0.0f, 0.0f));
+
+			}
+		});
+
+		graph.setOutput(backbuffer);
+		graph.execute();
+
+		if (!render_clouds) {
+			// The history is stale once clouds have been off for a frame
+			cloud_history_valid = false;
+		}
+		if (taa)
+			taa_frame++;
+		else
+			taa_history_valid = false;
+		previous_view = view;
+		previous_projection = projection;
+		previous_cloud_position = cloud_position;
+		cloud_frame++;
 
 		// -----------------------------------------------
 		// Swap buffers
 		// -----------------------------------------------
+		// Render the next frames at the scale the GPU time allows
+		if (dynamic_resolution.endFrame()) {
+			graph.setRenderScale(dynamic_resolution.scale());
+			depth_tiles.resize(graph.renderWidth(), graph.renderHeight());
+		}
+
+		GLState::endFrame();
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 
+	// Free all textures while the context still exists
+	TextureCache::shutdown();
+
 	glfwTerminate();
 }
 
@@ -565,63 +1036,98 @@ double getTimeSeconds(clock_t time_begin, clock_t time_end) {
 	return double(time_end - time_begin) / CLOCKS_PER_SEC;
 }
 
-/* DRAW OBJECTS - set up shaders and call vertex draw functions */
-void renderObjects(mat4 projection, mat4 view) {
-	// Activate shader when setting uniforms/drawing objects
-	objectShader.use();
-	objectShader.setMat4("projection", projection);
-	objectShader.setMat4("view", view); 
-	objectShader.setFloat("material.shininess", 64.0f);
-	objectShader.setVec3("viewPos", player.camera.Position);
-
-	// lights
-	objectShader.setInt("directionLightCount", Light::numDirectionalLights());
-	objectShader.setInt("pointLightCount", Light::numPointLights());
-	objectShader.setInt("spotLightCount", Light::numSpotLights());
-	objectShader.setInt("lightCount", lights.size());
+// Element of the Halton sequence, evenly spread points in [0, 1) that do not repeat
+float halton(int index, int base) {
+	float result = 0.0f, fraction = 1.0f;
+	while (index > 0) {
+		fraction /= base;
+		result += fraction * (index % base);
+		index /= base;
+	}
+	return result;
+}
+
+/* Returns the object shader variant for a material of the library with the lights of the frame, in use. The G-buffer
+variant when deferred, which has no lights */
+Shader * objectVariant(int material, ShaderVariants::Features lights) {
+	Shader * shader = deferred ? gbuffer_variants.get(material_library.features(material)) : object_variants.get(material_library.features(material) | lights);
+	shader->use();
+	shader->setInt("material_index", material);
+	return shader;
+}
 
+/* DRAW OBJECTS - set up shaders and call vertex draw functions. The lights are clustered for this view and projection
+(without jitter) */
+void renderObjects(const mat4 & view, const mat4 & projection) {
+	// lights, only the ones that changed are copied to the light buffer
 	for (int i = 0; i < lights.size(); i++) {
-		objectShader.setVec3("lightPositions[" + std::to_string(i) + "]", lights.at(i).position);
-		lights.at(i).drawLight(&objectShader);
+		light_buffer.setPosition(i, lights.at(i).position);
+		lights.at(i).drawLight(&light_buffer);
 	}
 
-	flashlight.drawLight(&objectShader);
+	flashlight.drawLight(&light_buffer);
+	light_buffer.setCounts(Light::numDirectionalLights(), Light::numPointLights(), Light::numSpotLights(), (int)lights.size());
+	light_buffer.upload();
+	// The shaders have the same directional count compiled in
+	ShaderVariants::Features light_counts = ShaderVariants::lightCounts(Light::numDirectionalLights(), 0, 0, 0);
+
+	// The point and spot lights are sorted into the clusters of the view again every frame
+	light_clusters.clear();
+	for (int i = 0; i < (int)lights.size(); i++)
+		lights.at(i).drawLight(&light_clusters);
+	flashlight.drawLight(&light_clusters);
+	if (render_light_field) {
+		for (int i = 0; i < (int)light_field.size(); i++)
+			light_field.at(i).drawLight(&light_clusters);
+	}
+	light_clusters.build(view, projection, graph.renderWidth(), graph.renderHeight());
+	// The maps of every material, for all the draws
+	material_library.bind();
 
-	cube.drawObject(&objectShader, vec3(0.0f, 5.0f, 0.0f), &metal);
-	cubehit.drawObject(&objectShader, boxEnt.position, &metal);
+	cube.drawObject(objectVariant(metal_material, light_counts), vec3(0.0f, 5.0f, 0.0f));
+	cubehit.drawObject(objectVariant(metal_material, light_counts), boxEnt.position);
 	//rect.setScale(gorundEntity.scale);
-	rect.drawObject(&objectShader, gorundEntity.position, gorundEntity.scale, &tile);
+	rect.drawObject(objectVariant(tile_material, light_counts), gorundEntity.position, gorundEntity.scale);
 
-	diamond.drawObject(&objectShader, vec3(0.0f, 3.0f, -3.0f), vec3(2.0f, 2.0f, 2.0f), &mixedstone);
+	diamond.drawObject(objectVariant(mixedstone_material, light_counts), vec3(0.0f, 3.0f, -3.0f), vec3(2.0f, 2.0f, 2.0f));
 
 	//PickUpItems
 	if (player.entities[2].exist) {
-		diamondPickUp.drawObject(&objectShader, dimodEnt.position, vec3(0.5f, 0.5f, 0.5f), rotatingDimond, vec3(0.0f, 1.0f, 0.0f), &metal);
+		diamondPickUp.drawObject(objectVariant(metal_material, light_counts), dimodEnt.position, vec3(0.5f, 0.5f, 0.5f), rotatingDimond, vec3(0.0f, 1.0f, 0.0f));
 		rotatingDimond += 0.8;
 	}
 
-	sphere_low.drawObject(&objectShader, vec3(20.0f, 2.0f, 0.0f), &tile);
-	sphere_medium.drawObject(&objectShader, vec3(20.0f, 2.0f, 2.0f), &tile);
-	sphere_high.drawObject(&objectShader, vec3(20.0f, 2.0f, 4.0f), &tile);
+	sphere_low.drawObject(objectVariant(tile_material, light_counts), vec3(20.0f, 2.0f, 0.0f));
+	sphere_medium.drawObject(objectVariant(tile_material, light_counts), vec3(20.0f, 2.0f, 2.0f));
+	sphere_high.drawObject(objectVariant(tile_material, light_counts), vec3(20.0f, 2.0f, 4.0f));
 
 }
 
+/* MOVE LIGHTS - animate the point lights and the light field for this frame */
+void updateLights() {
+	for (int i = 0; i < (int)lights.size(); i++) {
+		if (lights.at(i).is(Light::POINT)) {
+			lights.at(i).position = vec3(sin(increment_3) * 10 + i, 2.0f, cos(increment_3) * 10 + i);
+			lights.at(i).color = lightColor;
+		}
+	}
+	if (render_light_field) {
+		for (int i = 0; i < (int)light_field.size(); i++)
+			light_field.at(i).position.y = 0.5f + 0.4f * sin(increment_3 * 2.0f + i);
+	}
+}
+
 /* DRAW LIGHTS - set up light shader and call vertex draw functions */
-void renderLights(mat4 projection, mat4 view) {
+void renderLights() {
 	// Activate light shader and configure it
 	lightShader.use();
-	lightShader.setMat4("projection", projection);
-	lightShader.setMat4("view", view);
 	lightShader.setBool("hasLightColor", true);
 
 	// Draw light object
 	for (int i = 0; i < lights.size(); i++) {
 		lightShader.setVec3("lightColor", lightColor);
-		if (lights.at(i).is(Light::POINT)) {
-			lights.at(i).position = vec3(sin(increment_3) * 10 + i, 2.0f, cos(increment_3) * 10 + i), 90.0f, vec3(1.0f, 0.0f, 0.0f);
+		if (lights.at(i).is(Light::POINT))
 			light.drawObject(&lightShader, lights.at(i).position, nullptr);
-			lights.at(i).color = lightColor;
-		}
 	}
 
 }
@@ -718,12 +1224,36 @@ void key_callback(GLFWwindow * window, int key, int scancode, int action, int mo
 	if (key == GLFW_KEY_B && action == GLFW_PRESS)
 		bloom = !bloom;
 
+	if (key == GLFW_KEY_F2 && action == GLFW_PRESS)
+		fxaa = !fxaa;
+
+	if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+		taa = !taa;
+
+	if (key == GLFW_KEY_F4 && action == GLFW_PRESS)
+		deferred = !deferred;
+
+	if (key == GLFW_KEY_L && action == GLFW_PRESS)
+		render_light_field = !render_light_field;
+
 }
 
 /* GLFW: whenever the window size changes, this callback function executes */
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	GLState::viewport(0, 0, width, height);
+
+	// A minimized window has no size, the render targets are kept until it comes back
+	if (width == 0 || height == 0)
+		return;
+
+	// Everything that follows the window size is created again
+	WINDOW_WIDTH = width;
+	WINDOW_HEIGHT = height;
+	graph.resize(width, height);
+	bloom_chain.resize(width, height);
+	depth_tiles.resize(graph.renderWidth(), graph.renderHeight());
+	text.resize(height, width);
 }
 
 /* GLFW: whenever the mouse moves, this callback is called */
@@ -766,17 +1296,17 @@ void renderQuad()
 			1.0f, 1.0f, 0.0f, 1.0f, 1.0f,
 			1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
 		};
-		glGenVertexArrays(1, &quad_vao);
-		glGenBuffers(1, &quad_vbo);
-		glBindVertexArray(quad_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, quad_vbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-	}
-	glBindVertexArray(quad_vao);
+		glCreateVertexArrays(1, &quad_vao);
+		glCreateBuffers(1, &quad_vbo);
+		glNamedBufferStorage(quad_vbo, sizeof(quadVertices), &quadVertices, 0);
+		glVertexArrayVertexBuffer(quad_vao, 0, quad_vbo, 0, 5 * sizeof(GLfloat));
+		glEnableVertexArrayAttrib(quad_vao, 0);
+		glVertexArrayAttribFormat(quad_vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(quad_vao, 0, 0);
+		glEnableVertexArrayAttrib(quad_vao, 1);
+		glVertexArrayAttribFormat(quad_vao, 1, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat));
+		glVertexArrayAttribBinding(quad_vao, 1, 0);
+	}
+	GLState::bindVertexArray(quad_vao);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glBindVertexArray(0);
 }
\ No newline at end of file
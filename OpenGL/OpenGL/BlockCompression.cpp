@@ -0,0 +1,352 @@
+#include "BlockCompression.h"
+#include "ThreadPool.h"
+#include <emmintrin.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+// Channels of 16 pixels stored planar (all reds, all greens, ...) so SSE can work on four pixels at a time
+struct BlockPixels {
+	alignas(16) float channel[4][16];
+};
+
+static void toPlanar(const unsigned char pixels[64], BlockPixels & block)
+{
+	for (int i = 0; i < 16; i++) for (int c = 0; c < 4; c++)
+		block.channel[c][i] = pixels[i * 4 + c];
+}
+
+// Find the closest palette entry for each of the 16 pixels, comparing the first @channels channels
+static void fitIndices(const BlockPixels & block, int channels, const float palette[][4], int palette_size, unsigned char indices[16])
+{
+	for (int p = 0; p < 16; p += 4) {
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i best_index = _mm_setzero_si128();
+		for (int e = 0; e < palette_size; e++) {
+			__m128 distance = _mm_setzero_ps();
+			for (int c = 0; c < channels; c++) {
+				__m128 d = _mm_sub_ps(_mm_load_ps(&block.channel[c][p]), _mm_set1_ps(palette[e][c]));
+				distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+			}
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+			best = _mm_min_ps(distance, best);
+			best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(e)), _mm_andnot_si128(closer, best_index));
+		}
+		alignas(16) int result[4];
+		_mm_store_si128((__m128i*)result, best_index);
+		for (int i = 0; i < 4; i++)
+			indices[p + i] = (unsigned char)result[i];
+	}
+}
+
+// Fit a line through the block colors (principal axis, found by power iteration) and return its extremes
+static void principalEndpoints(const BlockPixels & block, int channels, float start[4], float end[4])
+{
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float low[4] = { 255.0f, 255.0f, 255.0f, 255.0f }, high[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int c = 0; c < channels; c++) {
+		for (int i = 0; i < 16; i++) {
+			mean[c] += block.channel[c][i];
+			low[c] = fminf(low[c], block.channel[c][i]);
+			high[c] = fmaxf(high[c], block.channel[c][i]);
+		}
+		mean[c] /= 16.0f;
+	}
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++) for (int a = 0; a < channels; a++) for (int b = 0; b < channels; b++)
+		covariance[a][b] += (block.channel[a][i] - mean[a]) * (block.channel[b][i] - mean[b]);
+
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int c = 0; c < channels; c++)
+		axis[c] = high[c] - low[c];
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float length = 0.0f;
+		for (int a = 0; a < channels; a++) {
+			for (int b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+			length = fmaxf(length, fabsf(next[a]));
+		}
+		if (length < 1e-6f) break;
+		for (int c = 0; c < channels; c++)
+			axis[c] = next[c] / length;
+	}
+
+	float length = 0.0f;
+	for (int c = 0; c < channels; c++)
+		length += axis[c] * axis[c];
+	if (length < 1e-12f) {
+		// Flat block, every pixel is the same color
+		for (int c = 0; c < 4; c++) start[c] = end[c] = mean[c];
+		return;
+	}
+	length = sqrtf(length);
+	for (int c = 0; c < channels; c++)
+		axis[c] /= length;
+
+	float t_min = FLT_MAX, t_max = -FLT_MAX;
+	for (int i = 0; i < 16; i++) {
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++)
+			t += (block.channel[c][i] - mean[c]) * axis[c];
+		t_min = fminf(t_min, t);
+		t_max = fmaxf(t_max, t);
+	}
+
+	for (int c = 0; c < 4; c++) {
+		start[c] = fminf(fmaxf(mean[c] + axis[c] * t_min, 0.0f), 255.0f);
+		end[c] = fminf(fmaxf(mean[c] + axis[c] * t_max, 0.0f), 255.0f);
+	}
+}
+
+static unsigned short packRGB565(const float color[4])
+{
+	unsigned int r = (unsigned int)(color[0] * 31.0f / 255.0f + 0.5f);
+	unsigned int g = (unsigned int)(color[1] * 63.0f / 255.0f + 0.5f);
+	unsigned int b = (unsigned int)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(unsigned short packed, float color[4])
+{
+	unsigned int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (float)((r << 3) | (r >> 2));
+	color[1] = (float)((g << 2) | (g >> 4));
+	color[2] = (float)((b << 3) | (b >> 2));
+	color[3] = 255.0f;
+}
+
+// Writes values of any bit width into a zeroed block, least significant bit first
+struct BitWriter {
+	unsigned char * out;
+	int position = 0;
+	BitWriter(unsigned char * out) : out(out) {}
+	void write(unsigned int value, int bits) {
+		for (int i = 0; i < bits; i++, position++)
+			if ((value >> i) & 1) out[position >> 3] |= (unsigned char)(1 << (position & 7));
+	}
+};
+
+GLenum BlockCompression::glFormat(Format format)
+{
+	switch (format)
+	{
+	case BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BC4: return GL_COMPRESSED_RED_RGTC1;
+	case BC5: return GL_COMPRESSED_RG_RGTC2;
+	case BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	default: return GL_RGBA8;
+	}
+}
+
+unsigned int BlockCompression::blockSize(Format format)
+{
+	return (format == BC1 || format == BC4) ? 8 : 16;
+}
+
+size_t BlockCompression::compressedSize(Format format, int width, int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
+bool BlockCompression::supported(Format format)
+{
+	switch (format)
+	{
+	case BC1:
+	case BC3: return GLEW_EXT_texture_compression_s3tc != 0;
+	case BC4:
+	case BC5: return GLEW_VERSION_3_0 || GLEW_ARB_texture_compression_rgtc;
+	case BC7: return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+	default: return false;
+	}
+}
+
+std::vector<unsigned char> BlockCompression::compress(const unsigned char * rgba, int width, int height, Format format)
+{
+	const int blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+	const unsigned int block_size = blockSize(format);
+	std::vector<unsigned char> out((size_t)blocks_x * blocks_y * block_size);
+
+	ThreadPool::instance().parallelFor(0, blocks_y, [&](int by) {
+		unsigned char pixels[64];
+		for (int bx = 0; bx < blocks_x; bx++) {
+			// Gather the 4x4 block, clamping at the right and bottom edge
+			for (int y = 0; y < 4; y++) for (int x = 0; x < 4; x++) {
+				int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+				int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+				memcpy(&pixels[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+			}
+
+			unsigned char * block = &out[((size_t)by * blocks_x + bx) * block_size];
+			switch (format)
+			{
+			case BC1: encodeBC1(pixels, block); break;
+			case BC3: encodeBC3(pixels, block); break;
+			case BC4: encodeBC4(pixels, 0, block); break;
+			case BC5: encodeBC5(pixels, block); break;
+			case BC7: encodeBC7(pixels, block); break;
+			default: break;
+			}
+		}
+	});
+
+	return out;
+}
+
+void BlockCompression::encodeBC1(const unsigned char pixels[64], unsigned char out[8])
+{
+	BlockPixels block;
+	toPlanar(pixels, block);
+
+	float start[4], end[4];
+	principalEndpoints(block, 3, start, end);
+	unsigned short color0 = packRGB565(end), color1 = packRGB565(start);
+
+	unsigned char indices[16] = {};
+	if (color0 != color1) {
+		// color0 > color1 selects the 4 color mode
+		if (color0 < color1) {
+			unsigned short swap = color0;
+			color0 = color1;
+			color1 = swap;
+		}
+		float palette[4][4];
+		unpackRGB565(color0, palette[0]);
+		unpackRGB565(color1, palette[1]);
+		for (int c = 0; c < 4; c++) {
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		fitIndices(block, 3, palette, 4, indices);
+	}
+
+	unsigned int bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (unsigned int)indices[i] << (2 * i);
+
+	out[0] = color0 & 0xFF;
+	out[1] = color0 >> 8;
+	out[2] = color1 & 0xFF;
+	out[3] = color1 >> 8;
+	for (int i = 0; i < 4; i++)
+		out[4 + i] = (bits >> (8 * i)) & 0xFF;
+}
+
+void BlockCompression::encodeBC3(const unsigned char pixels[64], unsigned char out[16])
+{
+	encodeBC4(pixels, 3, out);
+	encodeBC1(pixels, out + 8);
+}
+
+void BlockCompression::encodeBC4(const unsigned char pixels[64], int channel, unsigned char out[8])
+{
+	BlockPixels block;
+	for (int i = 0; i < 16; i++)
+		block.channel[0][i] = pixels[i * 4 + channel];
+
+	unsigned char low = 255, high = 0;
+	for (int i = 0; i < 16; i++) {
+		unsigned char value = pixels[i * 4 + channel];
+		if (value < low) low = value;
+		if (value > high) high = value;
+	}
+
+	unsigned char indices[16] = {};
+	if (high != low) {
+		// red0 > red1 selects the 8 value mode
+		float palette[8][4] = {};
+		palette[0][0] = high;
+		palette[1][0] = low;
+		for (int i = 2; i < 8; i++)
+			palette[i][0] = ((8 - i) * (float)high + (i - 1) * (float)low) / 7.0f;
+		fitIndices(block, 1, palette, 8, indices);
+	}
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (uint64_t)indices[i] << (3 * i);
+
+	out[0] = high;
+	out[1] = low;
+	for (int i = 0; i < 6; i++)
+		out[2 + i] = (bits >> (8 * i)) & 0xFF;
+}
+
+void BlockCompression::encodeBC5(const unsigned char pixels[64], unsigned char out[16])
+{
+	encodeBC4(pixels, 0, out);
+	encodeBC4(pixels, 1, out + 8);
+}
+
+void BlockCompression::encodeBC7(const unsigned char pixels[64], unsigned char out[16])
+{
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	BlockPixels block;
+	toPlanar(pixels, block);
+
+	float start[4], end[4];
+	principalEndpoints(block, 4, start, end);
+
+	// Mode 6 stores 7 bits per channel plus one shared low bit (p-bit) per endpoint. Pick the p-bit with least error.
+	unsigned int quantized[2][4], pbit[2];
+	float endpoint[2][4];
+	const float * source[2] = { start, end };
+	for (int e = 0; e < 2; e++) {
+		float best_error = FLT_MAX;
+		for (unsigned int p = 0; p < 2; p++) {
+			unsigned int q[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; c++) {
+				int value = (int)((source[e][c] - p) / 2.0f + 0.5f);
+				q[c] = value < 0 ? 0 : (value > 127 ? 127 : value);
+				float d = (float)((q[c] << 1) | p) - source[e][c];
+				error += d * d;
+			}
+			if (error < best_error) {
+				best_error = error;
+				pbit[e] = p;
+				for (int c = 0; c < 4; c++) quantized[e][c] = q[c];
+			}
+		}
+		for (int c = 0; c < 4; c++)
+			endpoint[e][c] = (float)((quantized[e][c] << 1) | pbit[e]);
+	}
+
+	float palette[16][4];
+	for (int i = 0; i < 16; i++) for (int c = 0; c < 4; c++)
+		palette[i][c] = (float)(((64 - weights[i]) * (int)endpoint[0][c] + weights[i] * (int)endpoint[1][c] + 32) >> 6);
+
+	unsigned char indices[16];
+	fitIndices(block, 4, palette, 16, indices);
+
+	// The first index is stored with 3 bits, so its top bit must be zero. Swap the endpoints if it is not.
+	if (indices[0] & 8) {
+		for (int c = 0; c < 4; c++) {
+			unsigned int swap = quantized[0][c];
+			quantized[0][c] = quantized[1][c];
+			quantized[1][c] = swap;
+		}
+		unsigned int swap = pbit[0];
+		pbit[0] = pbit[1];
+		pbit[1] = swap;
+		for (int i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	memset(out, 0, 16);
+	BitWriter writer(out);
+	writer.write(1 << 6, 7);
+	for (int c = 0; c < 4; c++) {
+		writer.write(quantized[0][c], 7);
+		writer.write(quantized[1][c], 7);
+	}
+	writer.write(pbit[0], 1);
+	writer.write(pbit[1], 1);
+	writer.write(indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		writer.write(indices[i], 4);
+}
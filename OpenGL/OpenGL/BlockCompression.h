@@ -0,0 +1,50 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+CPU encoder for the BCn block compressed texture formats. Each 4x4 pixel block is encoded on its own, so an image
+is split into rows of blocks that are spread over the ThreadPool. Endpoints are fitted along the principal axis
+of the block colors and the palette indices are picked with SSE, four pixels at a time.
+
+	BC1 - RGB, 4 bits per pixel (diffuse maps without alpha)
+	BC3 - RGBA, 8 bits per pixel (diffuse maps with alpha)
+	BC4 - one channel, 4 bits per pixel (specular, displacement and ambient occlusion maps)
+	BC5 - two channels, 8 bits per pixel (tangent space normal maps, z is rebuilt in the shader)
+	BC7 - RGBA, 8 bits per pixel, higher quality than BC1/BC3 (mode 6 only)
+*/
+class BlockCompression
+{
+public:
+	enum Format : short {
+		NONE = 0,
+		BC1 = 1,
+		BC3 = 3,
+		BC4 = 4,
+		BC5 = 5,
+		BC7 = 7
+	};
+	/* Returns the GL internal format of a compressed format */
+	static GLenum glFormat(Format format);
+	/* Returns the size in bytes of one 4x4 block */
+	static unsigned int blockSize(Format format);
+	/* Returns the size in bytes of a compressed image */
+	static size_t compressedSize(Format format, int width, int height);
+	/* Returns whether the current GL context can sample the format */
+	static bool supported(Format format);
+	/* Compress a tightly packed RGBA8 image. Images that are not a multiple of 4 are padded by repeating the edge */
+	static std::vector<unsigned char> compress(const unsigned char * rgba, int width, int height, Format format);
+
+	/* Encode 16 RGBA8 pixels as a BC1 block (8 bytes) */
+	static void encodeBC1(const unsigned char pixels[64], unsigned char out[8]);
+	/* Encode 16 RGBA8 pixels as a BC3 block (16 bytes) */
+	static void encodeBC3(const unsigned char pixels[64], unsigned char out[16]);
+	/* Encode one channel of 16 RGBA8 pixels as a BC4 block (8 bytes) */
+	static void encodeBC4(const unsigned char pixels[64], int channel, unsigned char out[8]);
+	/* Encode the red and green channel of 16 RGBA8 pixels as a BC5 block (16 bytes) */
+	static void encodeBC5(const unsigned char pixels[64], unsigned char out[16]);
+	/* Encode 16 RGBA8 pixels as a BC7 mode 6 block (16 bytes) */
+	static void encodeBC7(const unsigned char pixels[64], unsigned char out[16]);
+};
@@ -0,0 +1,127 @@
+#include "Bloom.h"
+#include "GLState.h"
+
+bool Bloom::init(int width, int height, int levels)
+{
+	if (downsample.init("shaders/blur_vert.shader", "shaders/bloom_down_frag.shader") != 0 ||
+		upsample.init("shaders/blur_vert.shader", "shaders/bloom_up_frag.shader") != 0) {
+		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
+		return false;
+	}
+	downsample.use();
+	downsample.setInt("source", 0);
+	upsample.use();
+	upsample.setInt("source", 0);
+
+	this->levels = levels;
+	return resize(width, height);
+}
+
+bool Bloom::resize(int width, int height)
+{
+	// The first level is half the size of the scene, the chain stops before a level would be empty
+	remove();
+	for (int level = 0; level < levels; level++) {
+		width /= 2;
+		height /= 2;
+		if (width < 1 || height < 1)
+			break;
+
+		unsigned int texture;
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, 1, GL_R11F_G11F_B10F, width, height);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		textures.push_back(texture);
+		widths.push_back(width);
+		heights.push_back(height);
+	}
+	if (textures.empty())
+		return false;
+
+	glCreateFramebuffers(1, &fbo);
+	glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, textures[0], 0);
+	if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Error: Bloom Framebuffer not created!" << std::endl;
+	return true;
+}
+
+void Bloom::target(int level)
+{
+	glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0, textures[level], 0);
+	GLState::viewport(0, 0, widths[level], heights[level]);
+}
+
+void Bloom::render(unsigned int bright_texture, float radius, void (*draw_quad)())
+{
+	if (fbo == 0)
+		return;
+
+	GLint viewport[4];
+	GLenum blend_src, blend_dst;
+	GLState::getViewport(viewport);
+	GLState::getBlendFunc(&blend_src, &blend_dst);
+	bool blend = GLState::isEnabled(GL_BLEND);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, fbo);
+	GLState::activeTexture(GL_TEXTURE0);
+
+	// Every level replaces its texels on the way down
+	GLState::disable(GL_BLEND);
+	downsample.use();
+	for (int level = 0; level < (int)textures.size(); level++) {
+		target(level);
+		GLState::bindTexture(GL_TEXTURE_2D, level == 0 ? bright_texture : textures[level - 1]);
+		// Average the brightest texels of the scene so single hot pixels do not flicker
+		downsample.setBool("karis_average", level == 0);
+		draw_quad();
+	}
+
+	// And adds the blurred smaller level on the way up
+	GLState::enable(GL_BLEND);
+	GLState::blendFunc(GL_ONE, GL_ONE);
+	upsample.use();
+	upsample.setFloat("radius", radius);
+	for (int level = (int)textures.size() - 1; level > 0; level--) {
+		target(level - 1);
+		GLState::bindTexture(GL_TEXTURE_2D, textures[level]);
+		draw_quad();
+	}
+
+	GLState::blendFunc(blend_src, blend_dst);
+	if (!blend)
+		GLState::disable(GL_BLEND);
+	GLState::viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+unsigned int Bloom::texture() const
+{
+	return textures.empty() ? 0 : textures[0];
+}
+
+void Bloom::bind(Shader & shader, unsigned int unit)
+{
+	if (textures.empty())
+		return;
+
+	shader.use();
+	shader.setInt("bloom_blur", unit);
+	// The first level holds the sum of all the levels
+	shader.setFloat("bloom_strength", 1.0f / textures.size());
+	GLState::activeTexture(GL_TEXTURE0 + unit);
+	GLState::bindTexture(GL_TEXTURE_2D, textures[0]);
+}
+
+void Bloom::remove()
+{
+	if (!textures.empty())
+		GLState::deleteTextures((GLsizei)textures.size(), textures.data());
+	if (fbo != 0)
+		GLState::deleteFramebuffers(1, &fbo);
+	textures.clear();
+	widths.clear();
+	heights.clear();
+	fbo = 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Shader.h"
+#include <vector>
+
+/*
+Bloom over a chain of textures that halve in size. The bright color of the scene is downsampled one level at a time
+with a 13 tap filter, then upsampled back with a 3x3 tent filter that is added onto every larger level. The result is
+a wide, smooth blur that costs less than one pass at full resolution.
+*/
+class Bloom
+{
+public:
+	/* Load the shaders and create the chain for a scene of the given size, with at most levels textures. Returns false on failure */
+	bool init(int width, int height, int levels);
+	/* Create the chain again for a new scene size */
+	bool resize(int width, int height);
+	/* Blur a bright color texture down and back up the chain. radius is the reach of the upsample filter in texels */
+	void render(unsigned int bright_texture, float radius, void (*draw_quad)());
+	/* Returns the texture that holds the bloom after render() */
+	unsigned int texture() const;
+	/* Bind the blurred bloom to a texture unit and set the bloom uniforms of the composite shader */
+	void bind(Shader & shader, unsigned int unit);
+	/* Delete the textures and the framebuffer */
+	void remove();
+private:
+	Shader downsample, upsample;
+	unsigned int fbo = 0;
+	int levels = 0;
+	std::vector<unsigned int> textures;
+	std::vector<int> widths, heights;
+	/* Render into one level of the chain */
+	void target(int level);
+};
@@ -0,0 +1,342 @@
+#include "CloudBricks.h"
+#include "CloudVolume.h"
+#include <math.h>
+#include <algorithm>
+
+// World units covered by one tile of the noise, and height where the clouds start, as in cloud_frag's cloud_sampling
+#define CLOUD_TILE_UNITS 800.0f
+#define CLOUD_BOTTOM 80.0f
+// Bricks along x and z of the cloudscape, the weather map repeats after this many
+#define TABLE_BRICKS 64
+// Smallest density that can show up as cloud, cloud_coverage is 0 below 0.35
+#define INSIDE_DENSITY 90
+// Most bricks uploaded by one update, so streaming never stalls a frame
+#define MAX_UPLOADS 8
+// Size and lowest frequency (cells per map) of the generated weather map
+#define WEATHER_SIZE 256
+#define WEATHER_FREQUENCY 4
+#define WEATHER_OCTAVES 4
+
+static int wrap(int i, int period)
+{
+	return ((i % period) + period) % period;
+}
+
+static uint32_t hashCell(int x, int y, uint32_t seed)
+{
+	uint32_t h = (uint32_t)x * 0x8da6b343U ^ (uint32_t)y * 0xd8163841U ^ seed * 0xcb1ab31fU;
+	h ^= h >> 16;
+	h *= 0x7feb352dU;
+	h ^= h >> 15;
+	h *= 0x846ca68bU;
+	h ^= h >> 16;
+	return h;
+}
+
+bool CloudBricks::init(const char * noise_path, const char * weather_path, int budget_mb)
+{
+	int width, height, depth;
+	if (!CloudVolume::readTexels(noise_path, width, height, depth, noise) || width != height || width != depth || width % BRICK_SIZE != 0) {
+		printf("Error: Could not read cloud noise %s for the cloud bricks\n", noise_path);
+		return false;
+	}
+	noise_size = width;
+	brick_units = BRICK_SIZE * CLOUD_TILE_UNITS / noise_size;
+	table_x = TABLE_BRICKS;
+	table_y = noise_size / BRICK_SIZE;
+	table_z = TABLE_BRICKS;
+
+	// Authored weather when there is an image, otherwise generated
+	int channels;
+	unsigned char * data = stbi_load(weather_path, &weather_width, &weather_height, &channels, 1);
+	if (data) {
+		weather.assign(data, data + (size_t)weather_width * weather_height);
+		stbi_image_free(data);
+	}
+	else {
+		generateWeather();
+	}
+	findEmptyBricks();
+
+	// As many slots as fit the budget, RGB8 counted as 4 bytes as drivers pad it
+	GLint max_size;
+	glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max_size);
+	size_t slot_bytes = (size_t)SLOT_SIZE * SLOT_SIZE * SLOT_SIZE * 4;
+	int slots = (int)(((size_t)budget_mb * 1024 * 1024) / slot_bytes);
+	int side = (int)floor(cbrt((double)slots));
+	side = std::min(std::max(side, 1), std::min((int)max_size / SLOT_SIZE, 255));
+	slots_x = slots_y = slots_z = side;
+
+	brick_slot.assign((size_t)table_x * table_y * table_z, -1);
+	slot_brick.assign((size_t)side * side * side, -1);
+	free_slots.clear();
+	for (int slot = (int)slot_brick.size() - 1; slot >= 0; slot--)
+		free_slots.push_back(slot);
+
+	// Nothing is resident at first
+	std::vector<unsigned char> zero((size_t)table_x * table_y * table_z * 4, 0);
+	glCreateTextures(GL_TEXTURE_3D, 1, &table.id);
+	activateTexture(&table);
+	glTextureStorage3D(table.id, 1, GL_RGBA8UI, table_x, table_y, table_z);
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage3D(table.id, 0, 0, 0, 0, table_x, table_y, table_z, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, zero.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glTextureParameteri(table.id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(table.id, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	table.width = table_x;
+	table.height = table_y;
+	table.depth = table_z;
+
+	glCreateTextures(GL_TEXTURE_3D, 1, &atlas.id);
+	activateTexture(&atlas);
+	glTextureStorage3D(atlas.id, 1, GL_RGB8, slots_x * SLOT_SIZE, slots_y * SLOT_SIZE, slots_z * SLOT_SIZE);
+	glTextureParameteri(atlas.id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(atlas.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(atlas.id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(atlas.id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(atlas.id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	atlas.width = slots_x * SLOT_SIZE;
+	atlas.height = slots_y * SLOT_SIZE;
+	atlas.depth = slots_z * SLOT_SIZE;
+
+	size_t empty_count = std::count(empty.begin(), empty.end(), 1);
+	printf("Cloud bricks: %d x %d x %d, %d empty, %d slots (%d MB)\n", table_x, table_y, table_z, (int)empty_count,
+		(int)slot_brick.size(), (int)(slot_brick.size() * slot_bytes / (1024 * 1024)));
+	pending = true;
+	return true;
+}
+
+void CloudBricks::generateWeather()
+{
+	// Value noise fBm where every octave has a whole number of cells per map, so it repeats with the table
+	weather_width = WEATHER_SIZE;
+	weather_height = WEATHER_SIZE;
+	std::vector<float> sum((size_t)WEATHER_SIZE * WEATHER_SIZE, 0.0f);
+	float amplitude = 1.0f, total = 0.0f;
+	for (int octave = 0; octave < WEATHER_OCTAVES; octave++) {
+		int cells = WEATHER_FREQUENCY << octave;
+		float cell_size = (float)WEATHER_SIZE / cells;
+		for (int y = 0; y < WEATHER_SIZE; y++) {
+			float fy = y / cell_size;
+			int y0 = (int)fy;
+			float ty = fy - y0;
+			ty = ty * ty * (3.0f - 2.0f * ty);
+			for (int x = 0; x < WEATHER_SIZE; x++) {
+				float fx = x / cell_size;
+				int x0 = (int)fx;
+				float tx = fx - x0;
+				tx = tx * tx * (3.0f - 2.0f * tx);
+				float v00 = (hashCell(wrap(x0, cells), wrap(y0, cells), octave) & 0xffff) / 65535.0f;
+				float v10 = (hashCell(wrap(x0 + 1, cells), wrap(y0, cells), octave) & 0xffff) / 65535.0f;
+				float v01 = (hashCell(wrap(x0, cells), wrap(y0 + 1, cells), octave) & 0xffff) / 65535.0f;
+				float v11 = (hashCell(wrap(x0 + 1, cells), wrap(y0 + 1, cells), octave) & 0xffff) / 65535.0f;
+				float v0 = v00 + (v10 - v00) * tx;
+				float v1 = v01 + (v11 - v01) * tx;
+				sum[(size_t)y * WEATHER_SIZE + x] += amplitude * (v0 + (v1 - v0) * ty);
+			}
+		}
+		total += amplitude;
+		amplitude *= 0.5f;
+	}
+
+	// Stretch so there are clear skies and fully covered areas, not only a grey average
+	weather.resize(sum.size());
+	for (size_t i = 0; i < sum.size(); i++) {
+		float t = std::min(std::max((sum[i] / total - 0.35f) / 0.3f, 0.0f), 1.0f);
+		weather[i] = (unsigned char)(t * t * (3.0f - 2.0f * t) * 255.0f + 0.5f);
+	}
+}
+
+float CloudBricks::weatherAt(float x, float z) const
+{
+	float u = x / (table_x * BRICK_SIZE) * weather_width - 0.5f;
+	float v = z / (table_z * BRICK_SIZE) * weather_height - 0.5f;
+	int u0 = (int)floor(u), v0 = (int)floor(v);
+	float tu = u - u0, tv = v - v0;
+	int u1 = wrap(u0 + 1, weather_width), v1 = wrap(v0 + 1, weather_height);
+	u0 = wrap(u0, weather_width);
+	v0 = wrap(v0, weather_height);
+	float w00 = weather[(size_t)v0 * weather_width + u0], w10 = weather[(size_t)v0 * weather_width + u1];
+	float w01 = weather[(size_t)v1 * weather_width + u0], w11 = weather[(size_t)v1 * weather_width + u1];
+	float w0 = w00 + (w10 - w00) * tu;
+	float w1 = w01 + (w11 - w01) * tu;
+	return w0 + (w1 - w0) * tv;
+}
+
+void CloudBricks::findEmptyBricks()
+{
+	// Densest noise texel of every brick of the tile, with the border the filtering reads
+	int tile_bricks = noise_size / BRICK_SIZE;
+	std::vector<int> noise_max((size_t)tile_bricks * tile_bricks * tile_bricks, 0);
+	for (int bz = 0; bz < tile_bricks; bz++) for (int by = 0; by < tile_bricks; by++) for (int bx = 0; bx < tile_bricks; bx++) {
+		int m = 0;
+		for (int k = -1; k <= BRICK_SIZE; k++) for (int j = -1; j <= BRICK_SIZE; j++) for (int i = -1; i <= BRICK_SIZE; i++) {
+			int x = wrap(bx * BRICK_SIZE + i, noise_size);
+			int y = wrap(by * BRICK_SIZE + j, noise_size);
+			int z = wrap(bz * BRICK_SIZE + k, noise_size);
+			m = std::max(m, (int)noise[(((size_t)z * noise_size + y) * noise_size + x) * 4]);
+		}
+		noise_max[((size_t)bz * tile_bricks + by) * tile_bricks + bx] = m;
+	}
+
+	// A brick is empty when the densest noise under the highest coverage still stays under the threshold
+	empty.assign((size_t)table_x * table_y * table_z, 0);
+	for (int bz = 0; bz < table_z; bz++) for (int bx = 0; bx < table_x; bx++) {
+		float weather_max = 0.0f;
+		for (int j = -1; j <= BRICK_SIZE; j++) for (int i = -1; i <= BRICK_SIZE; i++)
+			weather_max = std::max(weather_max, weatherAt(bx * BRICK_SIZE + i + 0.5f, bz * BRICK_SIZE + j + 0.5f));
+		for (int by = 0; by < table_y; by++) {
+			int m = noise_max[((size_t)(bz % tile_bricks) * tile_bricks + by % tile_bricks) * tile_bricks + bx % tile_bricks];
+			empty[((size_t)bz * table_y + by) * table_x + bx] = m * weather_max / 255.0f <= INSIDE_DENSITY ? 1 : 0;
+		}
+	}
+}
+
+float CloudBricks::brickDistance(int brick, const vec3 & camera_position) const
+{
+	int bx = brick % table_x, by = (brick / table_x) % table_y, bz = brick / (table_x * table_y);
+	float period_x = table_x * brick_units, period_z = table_z * brick_units;
+	float dx = fmodf((bx + 0.5f) * brick_units - camera_position.x, period_x);
+	float dz = fmodf((bz + 0.5f) * brick_units - camera_position.z, period_z);
+	if (dx < -period_x / 2) dx += period_x;
+	if (dx > period_x / 2) dx -= period_x;
+	if (dz < -period_z / 2) dz += period_z;
+	if (dz > period_z / 2) dz -= period_z;
+	float dy = CLOUD_BOTTOM + (by + 0.5f) * brick_units - camera_position.y;
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+void CloudBricks::update(const vec3 & camera_position, float radius)
+{
+	if (atlas.id == 0)
+		return;
+
+	// Only look again when the camera entered another brick or bricks are still missing
+	int cx = (int)floor(camera_position.x / brick_units);
+	int cy = (int)floor((camera_position.y - CLOUD_BOTTOM) / brick_units);
+	int cz = (int)floor(camera_position.z / brick_units);
+	if (!pending && cx == last_x && cy == last_y && cz == last_z)
+		return;
+	last_x = cx;
+	last_y = cy;
+	last_z = cz;
+
+	// Non-empty bricks in range, closest first. The range never wraps around onto itself
+	int r = std::min((int)ceil(radius / brick_units), (std::min(table_x, table_z) - 1) / 2);
+	candidates.clear();
+	for (int dz = -r; dz <= r; dz++) for (int dx = -r; dx <= r; dx++) {
+		if (dx * dx + dz * dz > (r + 1) * (r + 1)) continue;
+		int bx = wrap(cx + dx, table_x), bz = wrap(cz + dz, table_z);
+		for (int by = 0; by < table_y; by++) {
+			int brick = (bz * table_y + by) * table_x + bx;
+			if (empty[brick]) continue;
+			float distance = brickDistance(brick, camera_position);
+			if (distance > radius + brick_units) continue;
+			Candidate candidate = { distance, brick };
+			candidates.push_back(candidate);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate & a, const Candidate & b) { return a.distance < b.distance; });
+
+	int uploads = 0;
+	pending = false;
+	for (const Candidate & candidate : candidates) {
+		if (brick_slot[candidate.brick] >= 0) continue;
+		if (uploads == MAX_UPLOADS) {
+			pending = true;
+			break;
+		}
+
+		// Take a free slot, or the one of the farthest resident brick if that is farther than this one
+		int slot = -1;
+		if (!free_slots.empty()) {
+			slot = free_slots.back();
+			free_slots.pop_back();
+		}
+		else {
+			float farthest = candidate.distance;
+			for (int s = 0; s < (int)slot_brick.size(); s++) {
+				float distance = brickDistance(slot_brick[s], camera_position);
+				if (distance > farthest) {
+					farthest = distance;
+					slot = s;
+				}
+			}
+			// The atlas is full of closer bricks
+			if (slot < 0) break;
+			evict(slot);
+			free_slots.pop_back();
+		}
+		upload(candidate.brick, slot);
+		uploads++;
+	}
+}
+
+void CloudBricks::upload(int brick, int slot)
+{
+	int bx = brick % table_x, by = (brick / table_x) % table_y, bz = brick / (table_x * table_y);
+
+	// Weather of every column of the brick with its border
+	float columns[SLOT_SIZE][SLOT_SIZE];
+	for (int j = 0; j < SLOT_SIZE; j++) for (int i = 0; i < SLOT_SIZE; i++)
+		columns[j][i] = weatherAt(bx * BRICK_SIZE + i - 1 + 0.5f, bz * BRICK_SIZE + j - 1 + 0.5f) / 255.0f;
+
+	// Red is the density scaled by the weather, green and blue the noise blue and alpha the shader also reads
+	std::vector<unsigned char> texels((size_t)SLOT_SIZE * SLOT_SIZE * SLOT_SIZE * 3);
+	unsigned char * out = texels.data();
+	for (int k = 0; k < SLOT_SIZE; k++) {
+		int z = wrap(bz * BRICK_SIZE + k - 1, noise_size);
+		for (int j = 0; j < SLOT_SIZE; j++) {
+			int y = wrap(by * BRICK_SIZE + j - 1, noise_size);
+			for (int i = 0; i < SLOT_SIZE; i++, out += 3) {
+				int x = wrap(bx * BRICK_SIZE + i - 1, noise_size);
+				const unsigned char * texel = &noise[(((size_t)z * noise_size + y) * noise_size + x) * 4];
+				out[0] = (unsigned char)(texel[0] * columns[k][i] + 0.5f);
+				out[1] = texel[2];
+				out[2] = texel[3];
+			}
+		}
+	}
+
+	int sx = slot % slots_x, sy = (slot / slots_x) % slots_y, sz = slot / (slots_x * slots_y);
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage3D(atlas.id, 0, sx * SLOT_SIZE, sy * SLOT_SIZE, sz * SLOT_SIZE, SLOT_SIZE, SLOT_SIZE, SLOT_SIZE, GL_RGB, GL_UNSIGNED_BYTE, texels.data());
+
+	unsigned char entry[4] = { (unsigned char)sx, (unsigned char)sy, (unsigned char)sz, 1 };
+	glTextureSubImage3D(table.id, 0, bx, by, bz, 1, 1, 1, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entry);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+	brick_slot[brick] = slot;
+	slot_brick[slot] = brick;
+}
+
+void CloudBricks::evict(int slot)
+{
+	int brick = slot_brick[slot];
+	int bx = brick % table_x, by = (brick / table_x) % table_y, bz = brick / (table_x * table_y);
+
+	unsigned char entry[4] = { 0, 0, 0, 0 };
+	glTextureSubImage3D(table.id, 0, bx, by, bz, 1, 1, 1, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entry);
+
+	brick_slot[brick] = -1;
+	slot_brick[slot] = -1;
+	free_slots.push_back(slot);
+}
+
+void CloudBricks::bind(Shader & shader)
+{
+	shader.setTexture3D(table, "brick_table");
+	shader.setTexture3D(atlas, "brick_atlas");
+	shader.setBool("use_bricks", true);
+	shader.setFloat("brick_units", brick_units);
+	shader.setVec3("brick_atlas_size", vec3((float)atlas.width, (float)atlas.height, (float)atlas.depth));
+}
+
+bool CloudBricks::ready() const
+{
+	return atlas.id != 0;
+}
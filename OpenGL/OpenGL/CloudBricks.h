@@ -0,0 +1,60 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Shader.h"
+#include "texture.h"
+#include <vector>
+
+/*
+Sparse brick volume for a cloudscape much larger than the tiling noise, without the memory growing with its size.
+
+	table - one RGBA8UI texel per 16^3 brick of the cloudscape: the atlas slot of the brick (xyz), and 1 in w when resident
+	atlas - 3D texture of slots, every slot holds one brick with a one texel border so filtering does not show seams
+
+A brick is the tiling noise with its density scaled by a 2D weather map, which only repeats every table width bricks
+(6.4 km at medium quality). The weather map is an 8 bit image when there is one, otherwise it is generated. Bricks
+where the density never gets past the coverage threshold are empty and never stored. The streamer keeps the non-empty
+bricks closest to the camera resident in a fixed memory budget, and uploads a few per update.
+*/
+class CloudBricks
+{
+public:
+	static const int BRICK_SIZE = 16;
+	static const int SLOT_SIZE = BRICK_SIZE + 2;
+	Texture table, atlas;
+	/* Build the brick map from a noise volume file and a weather image (generated if missing), with budget_mb of atlas. Returns false on failure */
+	bool init(const char * noise_path, const char * weather_path, int budget_mb);
+	/* Page in the bricks within radius of the camera, closest first, evicting the farthest ones when the atlas is full */
+	void update(const vec3 & camera_position, float radius);
+	/* Set the brick textures and uniforms of a cloud shader */
+	void bind(Shader & shader);
+	/* Returns whether the bricks can be used */
+	bool ready() const;
+private:
+	struct Candidate {
+		float distance;
+		int brick;
+	};
+	int noise_size = 0, weather_width = 0, weather_height = 0;
+	std::vector<unsigned char> noise, weather;
+	int table_x = 0, table_y = 0, table_z = 0;
+	int slots_x = 0, slots_y = 0, slots_z = 0;
+	float brick_units = 0.0f;
+	std::vector<unsigned char> empty;
+	std::vector<int> brick_slot, slot_brick, free_slots;
+	std::vector<Candidate> candidates;
+	int last_x = 0, last_y = 0, last_z = 0;
+	bool pending = true;
+	/* Generate a tiling weather map when there is no image */
+	void generateWeather();
+	/* Weather coverage (0-255) at a texel column of the cloudscape, filtered and wrapped */
+	float weatherAt(float x, float z) const;
+	/* Find the bricks that can never hold clouds */
+	void findEmptyBricks();
+	/* Distance from the camera to the center of a brick, over the shortest way around the wrapped table */
+	float brickDistance(int brick, const vec3 & camera_position) const;
+	/* Fill a slot of the atlas with a brick and point the table at it */
+	void upload(int brick, int slot);
+	/* Mark a brick as not resident and free its slot */
+	void evict(int slot);
+};
@@ -0,0 +1,68 @@
+#include "CloudLighting.h"
+
+// Work group size of cloud_light_comp.shader along every axis
+#define LIGHT_GROUP_SIZE 4
+// Smallest change of the sun direction (1 - cos of the angle, about half a degree) that rebuilds the volume
+#define LIGHT_SUN_TOLERANCE 0.00004f
+
+bool CloudLighting::init(int size)
+{
+	if (!GLEW_VERSION_4_3 && !GLEW_ARB_compute_shader) {
+		printf("Compute shaders are not supported, cloud lighting is marched per sample\n");
+		return false;
+	}
+	if (shader.initCompute("shaders/cloud_light_comp.shader") != 0) {
+		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
+		return false;
+	}
+
+	volume.width = size;
+	volume.height = size;
+	volume.depth = size;
+	glCreateTextures(GL_TEXTURE_3D, 1, &volume.id);
+	activateTexture(&volume);
+	glTextureStorage3D(volume.id, 1, GL_R16F, size, size, size);
+	glTextureParameteri(volume.id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(volume.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(volume.id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(volume.id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(volume.id, GL_TEXTURE_WRAP_R, GL_REPEAT);
+
+	supported = true;
+	built = false;
+	return true;
+}
+
+bool CloudLighting::update(const Texture & cloud_texture, const vec3 & sun_direction, float coverage, float end)
+{
+	if (!supported)
+		return false;
+	if (built && coverage == last_coverage && end == last_end
+		&& vec3::dot(sun_direction, last_sun_direction) > 1.0f - LIGHT_SUN_TOLERANCE)
+		return false;
+
+	shader.use();
+	shader.setVec3("sun_direction", sun_direction);
+	shader.setFloat("coverage", coverage);
+	shader.setFloat("end", end);
+
+	shader.setTexture3D(cloud_texture, "cloud_texture");
+	glBindImageTexture(0, volume.id, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R16F);
+
+	GLuint groups_x = (volume.width + LIGHT_GROUP_SIZE - 1) / LIGHT_GROUP_SIZE;
+	GLuint groups_y = (volume.height + LIGHT_GROUP_SIZE - 1) / LIGHT_GROUP_SIZE;
+	GLuint groups_z = (volume.depth + LIGHT_GROUP_SIZE - 1) / LIGHT_GROUP_SIZE;
+	glDispatchCompute(groups_x, groups_y, groups_z);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	last_sun_direction = sun_direction;
+	last_coverage = coverage;
+	last_end = end;
+	built = true;
+	return true;
+}
+
+bool CloudLighting::ready() const
+{
+	return supported && built;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Shader.h"
+#include "texture.h"
+
+/*
+Volume with the optical depth from every point of the cloud domain toward the sun, so cloud_frag can light a sample
+with one texture fetch instead of marching a second ray through the noise for every sample.
+
+The volume covers one 800 unit tile of the cloud noise (repeating along x and z, like the noise) from the bottom of
+the clouds and up. It is built by a compute shader, and only rebuilt when the sun direction, the coverage or the
+render distance (which sets the length of the light rays) changed. The sun is treated as a directional light from
+the clouds' point of view. Without compute shaders it is never built and cloud_frag marches the light rays as before.
+*/
+class CloudLighting
+{
+public:
+	Texture volume;
+	/* Create the volume and load the compute shader. Returns false when compute shaders are not available */
+	bool init(int size);
+	/* Rebuild the volume if any of the inputs changed since the last build. Returns whether it was rebuilt */
+	bool update(const Texture & cloud_texture, const vec3 & sun_direction, float coverage, float end);
+	/* Returns whether the volume has been built and can be sampled */
+	bool ready() const;
+private:
+	Shader shader;
+	bool supported = false, built = false;
+	vec3 last_sun_direction;
+	float last_coverage = 0.0f, last_end = 0.0f;
+};
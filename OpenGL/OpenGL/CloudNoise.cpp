@@ -0,0 +1,294 @@
+#include "CloudNoise.h"
+#include "CloudVolume.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include <emmintrin.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+// Bump when the noise functions change, so cached volumes are generated again
+#define GENERATOR_VERSION 1
+// Worley octaves: 3 per channel, each channel one octave above the previous
+#define WORLEY_OCTAVES 6
+// Range of the raw Perlin-Worley values, mapped to [0, 1]
+#define PERLIN_WORLEY_LOW 0.45f
+#define PERLIN_WORLEY_HIGH 0.85f
+
+// Integer hash (lowbias32), the only source of randomness
+static uint32_t mix(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+static uint32_t hashCell(int x, int y, int z, uint32_t seed)
+{
+	return mix((uint32_t)x ^ mix((uint32_t)y ^ mix((uint32_t)z ^ mix(seed))));
+}
+
+static int wrap(int i, int period)
+{
+	return ((i % period) + period) % period;
+}
+
+// Gradients to the edge midpoints of a cube, as in improved Perlin noise
+static const float GRADIENTS[16][3] = {
+	{ 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+	{ 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+	{ 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 },
+	{ 1, 1, 0 }, { -1, 1, 0 }, { 0, -1, 1 }, { 0, -1, -1 }
+};
+
+static __m128 fade(__m128 t)
+{
+	// 6t^5 - 15t^4 + 10t^3
+	__m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+	return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+static __m128 lerp(__m128 a, __m128 b, __m128 t)
+{
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+// Gradient index of every lattice point around one row of texels, [dz][dy][x] with x in [0, period]
+struct PerlinRow {
+	std::vector<unsigned char> gradients;
+	int stride;
+	float fy, fz;
+};
+
+static void buildPerlinRow(PerlinRow & row, float py, float pz, int period, uint32_t seed)
+{
+	int iy = (int)floorf(py), iz = (int)floorf(pz);
+	row.fy = py - iy;
+	row.fz = pz - iz;
+	row.stride = period + 1;
+	row.gradients.resize(4 * row.stride);
+	for (int c = 0; c < 4; c++) for (int x = 0; x <= period; x++)
+		row.gradients[c * row.stride + x] = hashCell(wrap(x, period), wrap(iy + (c & 1), period), wrap(iz + (c >> 1), period), seed) & 15;
+}
+
+// Tileable Perlin noise for 4 texels next to each other in x (0 <= px <= period), returns [-1, 1]
+static __m128 perlin4(const float px[4], const PerlinRow & row)
+{
+	int ix[4];
+	float fx[4];
+	for (int l = 0; l < 4; l++) {
+		ix[l] = (int)floorf(px[l]);
+		fx[l] = px[l] - ix[l];
+	}
+
+	__m128 x = _mm_loadu_ps(fx);
+	__m128 corner[8];
+	for (int c = 0; c < 8; c++) {
+		int dx = c & 1, dy = (c >> 1) & 1, dz = c >> 2;
+		const unsigned char * gradients = &row.gradients[(dz * 2 + dy) * row.stride + dx];
+		alignas(16) float gx[4], gy[4], gz[4];
+		for (int l = 0; l < 4; l++) {
+			const float * g = GRADIENTS[gradients[ix[l]]];
+			gx[l] = g[0];
+			gy[l] = g[1];
+			gz[l] = g[2];
+		}
+		__m128 dot = _mm_mul_ps(_mm_load_ps(gx), _mm_sub_ps(x, _mm_set1_ps((float)dx)));
+		dot = _mm_add_ps(dot, _mm_mul_ps(_mm_load_ps(gy), _mm_set1_ps(row.fy - dy)));
+		dot = _mm_add_ps(dot, _mm_mul_ps(_mm_load_ps(gz), _mm_set1_ps(row.fz - dz)));
+		corner[c] = dot;
+	}
+
+	__m128 u = fade(x), v = fade(_mm_set1_ps(row.fy)), w = fade(_mm_set1_ps(row.fz));
+	__m128 x00 = lerp(corner[0], corner[1], u), x10 = lerp(corner[2], corner[3], u);
+	__m128 x01 = lerp(corner[4], corner[5], u), x11 = lerp(corner[6], corner[7], u);
+	return lerp(lerp(x00, x10, v), lerp(x01, x11, v), w);
+}
+
+// Feature points of the 27 cells around one cell, as SSE friendly arrays (one unused slot far away)
+struct WorleyCells {
+	alignas(16) float x[28], y[28], z[28];
+};
+
+// Feature points of the 3x3 cell columns around one row of texels, [dz][dy][x] with x in [-1, frequency]
+struct WorleyRow {
+	std::vector<float> x, y, z;
+	int stride;
+};
+
+static void buildWorleyRow(WorleyRow & row, int cy, int cz, int frequency, uint32_t seed)
+{
+	row.stride = frequency + 2;
+	row.x.resize(9 * row.stride);
+	row.y.resize(9 * row.stride);
+	row.z.resize(9 * row.stride);
+	for (int c = 0; c < 9; c++) for (int i = 0; i < row.stride; i++) {
+		int nx = i - 1, ny = cy + c % 3 - 1, nz = cz + c / 3 - 1;
+		uint32_t h = hashCell(wrap(nx, frequency), wrap(ny, frequency), wrap(nz, frequency), seed);
+		row.x[c * row.stride + i] = nx + (h & 0x3ff) / 1024.0f;
+		row.y[c * row.stride + i] = ny + ((h >> 10) & 0x3ff) / 1024.0f;
+		row.z[c * row.stride + i] = nz + ((h >> 20) & 0x3ff) / 1024.0f;
+	}
+}
+
+static void buildCells(WorleyCells & cells, const WorleyRow & row, int cx)
+{
+	int i = 0;
+	for (int c = 0; c < 9; c++) for (int ox = 0; ox < 3; ox++, i++) {
+		int index = c * row.stride + cx + ox;
+		cells.x[i] = row.x[index];
+		cells.y[i] = row.y[index];
+		cells.z[i] = row.z[index];
+	}
+	cells.x[27] = cells.y[27] = cells.z[27] = 1e6f;
+}
+
+// Inverted distance to the closest feature point, 1 on a point and 0 one cell away
+static float worley(const WorleyCells & cells, float px, float py, float pz)
+{
+	__m128 x = _mm_set1_ps(px), y = _mm_set1_ps(py), z = _mm_set1_ps(pz);
+	__m128 closest = _mm_set1_ps(1e30f);
+	for (int i = 0; i < 28; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_load_ps(cells.x + i), x);
+		__m128 dy = _mm_sub_ps(_mm_load_ps(cells.y + i), y);
+		__m128 dz = _mm_sub_ps(_mm_load_ps(cells.z + i), z);
+		closest = _mm_min_ps(closest, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+	}
+	closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(1, 0, 3, 2)));
+	closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(2, 3, 0, 1)));
+	float distance = sqrtf(_mm_cvtss_f32(closest));
+	return distance < 1.0f ? 1.0f - distance : 0.0f;
+}
+
+static unsigned char toByte(float v)
+{
+	v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+	return (unsigned char)(v * 255.0f + 0.5f);
+}
+
+CloudNoise::Settings CloudNoise::settings(Quality quality)
+{
+	Settings s;
+	s.size = quality;
+	s.seed = 1337;
+	s.perlin_frequency = 4;
+	s.perlin_octaves = (quality == LOW) ? 4 : (quality == MEDIUM ? 5 : 6);
+	s.worley_frequency = 2;
+	return s;
+}
+
+uint64_t CloudNoise::hash(const Settings & settings)
+{
+	uint32_t values[] = { GENERATOR_VERSION, (uint32_t)settings.size, settings.seed,
+		(uint32_t)settings.perlin_frequency, (uint32_t)settings.perlin_octaves, (uint32_t)settings.worley_frequency };
+	return TextureCache::hash(values, sizeof(values));
+}
+
+std::vector<unsigned char> CloudNoise::generate(const Settings & settings)
+{
+	const int size = settings.size;
+	std::vector<unsigned char> rgba((size_t)size * size * size * 4);
+	const float worley_weights[3] = { 0.625f, 0.25f, 0.125f };
+
+	float perlin_total = 0.0f;
+	for (int o = 0; o < settings.perlin_octaves; o++)
+		perlin_total += powf(0.5f, (float)o);
+
+	ThreadPool::instance().parallelFor(0, size, [&](int z) {
+		std::vector<float> perlin(size + 4), cells[WORLEY_OCTAVES];
+		for (int o = 0; o < WORLEY_OCTAVES; o++)
+			cells[o].resize(size);
+		PerlinRow lattice;
+		WorleyRow points;
+		WorleyCells neighbours;
+
+		for (int y = 0; y < size; y++) {
+			// Perlin fBm of the whole row, 4 texels at a time
+			std::fill(perlin.begin(), perlin.end(), 0.0f);
+			float amplitude = 1.0f / perlin_total;
+			for (int o = 0; o < settings.perlin_octaves; o++) {
+				int period = settings.perlin_frequency << o;
+				float scale = (float)period / size;
+				buildPerlinRow(lattice, (y + 0.5f) * scale, (z + 0.5f) * scale, period, settings.seed + o);
+				for (int x = 0; x < size; x += 4) {
+					float px[4] = { (x + 0.5f) * scale, (x + 1.5f) * scale, (x + 2.5f) * scale, (x + 3.5f) * scale };
+					__m128 sum = _mm_add_ps(_mm_loadu_ps(&perlin[x]), _mm_mul_ps(perlin4(px, lattice), _mm_set1_ps(amplitude)));
+					_mm_storeu_ps(&perlin[x], sum);
+				}
+				amplitude *= 0.5f;
+			}
+
+			// Worley octaves of the whole row, the neighbour cells are only rebuilt when x enters a new cell
+			for (int o = 0; o < WORLEY_OCTAVES; o++) {
+				int frequency = settings.worley_frequency << o;
+				float scale = (float)frequency / size;
+				float py = (y + 0.5f) * scale, pz = (z + 0.5f) * scale;
+				buildWorleyRow(points, (int)py, (int)pz, frequency, mix(settings.seed) + 0x9e3779b9U * (o + 1));
+				int current = -1;
+				for (int x = 0; x < size; x++) {
+					float px = (x + 0.5f) * scale;
+					if ((int)px != current) {
+						current = (int)px;
+						buildCells(neighbours, points, current);
+					}
+					cells[o][x] = worley(neighbours, px, py, pz);
+				}
+			}
+
+			unsigned char * out = &rgba[((size_t)z * size + y) * size * 4];
+			for (int x = 0; x < size; x++) {
+				float fbm[4];
+				for (int c = 0; c < 4; c++)
+					fbm[c] = cells[c][x] * worley_weights[0] + cells[c + 1][x] * worley_weights[1] + cells[c + 2][x] * worley_weights[2];
+
+				// Dilate the Perlin noise with the Worley noise, remap(perlin, worley - 1, 1, 0, 1)
+				float p = perlin[x] * 0.5f + 0.5f;
+				float perlin_worley = (p - (fbm[0] - 1.0f)) / (2.0f - fbm[0]);
+
+				// The result sits in about [0.45, 0.85], stretch it so the coverage threshold in cloud_frag (0.35) leaves gaps
+				perlin_worley = (perlin_worley - PERLIN_WORLEY_LOW) / (PERLIN_WORLEY_HIGH - PERLIN_WORLEY_LOW);
+
+				out[x * 4 + 0] = toByte(perlin_worley);
+				out[x * 4 + 1] = toByte(fbm[1]);
+				out[x * 4 + 2] = toByte(fbm[2]);
+				out[x * 4 + 3] = toByte(fbm[3]);
+			}
+		}
+	});
+	return rgba;
+}
+
+std::string CloudNoise::cachePath(const Settings & settings, const char * cache_directory)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "/cloud_noise_%d_%016llx.vol", settings.size, (unsigned long long)hash(settings));
+	return std::string(cache_directory) + name;
+}
+
+std::string CloudNoise::cache(const Settings & settings, const char * cache_directory)
+{
+	uint64_t key = hash(settings);
+	std::string path = cachePath(settings, cache_directory);
+
+	CloudVolume::Header header;
+	if (!CloudVolume::readHeader(path.c_str(), header) || header.generator_hash != key) {
+		printf("Generating %d^3 cloud noise...\n", settings.size);
+		std::vector<unsigned char> rgba = generate(settings);
+
+		memset(&header, 0, sizeof(header));
+		header.generator_hash = key;
+		if (!CloudVolume::write(path.c_str(), rgba.data(), settings.size, settings.size, settings.size, header))
+			printf("Warning: Could not write cloud noise cache %s\n", path.c_str());
+	}
+	return path;
+}
+
+bool CloudNoise::create(Texture * t, const Settings & settings, const char * cache_directory, std::vector<unsigned char> * density)
+{
+	std::string path = cache(settings, cache_directory);
+	return CloudVolume::load(t, path.c_str(), density);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "Texture.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+Generator for the tileable 3D cloud noise sampled by cloud_frag.shader, so no external noise files are needed.
+
+	R - Perlin-Worley: Perlin fBm dilated by a Worley fBm, the base cloud shape
+	G - Worley fBm at 2x the base frequency
+	B - Worley fBm at 4x the base frequency
+	A - Worley fBm at 8x the base frequency
+
+Every frequency is a whole number of cells or lattice points per volume, so the volume repeats seamlessly.
+Z slices are generated in parallel on the ThreadPool and the Worley distance search runs on SSE. Everything is
+derived from the seed with integer hashing, so the same settings always give the same volume. Generated volumes
+are cached on disk as CloudVolume files named after a hash of the settings.
+*/
+class CloudNoise
+{
+public:
+	enum Quality : short {
+		LOW = 64,
+		MEDIUM = 128,
+		HIGH = 256
+	};
+	struct Settings {
+		int size;				// Texels along every axis
+		uint32_t seed;
+		int perlin_frequency;	// Lattice points per volume of the first Perlin octave
+		int perlin_octaves;
+		int worley_frequency;	// Cells per volume of the first Worley octave
+	};
+	/* Returns the default settings of a quality tier */
+	static Settings settings(Quality quality);
+	/* Returns a hash of the settings, used to name and validate the cache file */
+	static uint64_t hash(const Settings & settings);
+	/* Returns the path of the cache file for the settings in cache_directory */
+	static std::string cachePath(const Settings & settings, const char * cache_directory);
+	/* Generate a size^3 RGBA8 volume */
+	static std::vector<unsigned char> generate(const Settings & settings);
+	/* Generate the noise volume into its cache file in cache_directory unless the file is there and up to date. Returns the path of the file */
+	static std::string cache(const Settings & settings, const char * cache_directory);
+	/* Load a noise volume into a 3D texture, generating and caching it in cache_directory if needed. Optionally copies the red channel to density */
+	static bool create(Texture * t, const Settings & settings, const char * cache_directory, std::vector<unsigned char> * density = nullptr);
+};
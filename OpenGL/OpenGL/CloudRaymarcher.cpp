@@ -0,0 +1,464 @@
+#include "CloudRaymarcher.h"
+#include "CloudTexture.h"
+#include "CloudVolume.h"
+#include "ThreadPool.h"
+#include <emmintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+// Pixels along a side of the tiles the image is split into
+#define TILE_SIZE 16
+// Rays marched together, one per SSE lane
+#define LANES 4
+// Constants of cloud_frag.shader
+#define CLOUD_TILE_UNITS 800.0f
+#define CLOUD_BASE 80.0f
+#define RECHECK_DISTANCE 3.0f
+#define LIGHT_STEP 10.0f
+#define PI_R 0.3183098f
+static const float SKY_COLOR[3] = { 0.416f, 0.518f, 0.694f };
+static const float CLOUD_BRIGHT = 4.0f;
+// Size of the view rendered by check() and the largest differences it accepts, in color and in units of depth
+#define REFERENCE_WIDTH 96
+#define REFERENCE_HEIGHT 54
+#define REFERENCE_COLOR_TOLERANCE (1.0f / 255.0f)
+#define REFERENCE_DEPTH_TOLERANCE 0.5f
+
+struct CloudRaymarcher::Ray {
+	vec3 origin, dir;
+	float t, delta, last, jitter;
+	bool inside, done;
+	int points_inside;
+	float color[4];
+	float depth_sum, alpha_sum;
+	vec3 point;
+};
+
+static vec4 transform(const mat4 & m, const vec4 & v)
+{
+	// Column major, as uploaded to the shaders
+	return vec4(
+		m.matrix[0] * v.x + m.matrix[4] * v.y + m.matrix[8] * v.z + m.matrix[12] * v.w,
+		m.matrix[1] * v.x + m.matrix[5] * v.y + m.matrix[9] * v.z + m.matrix[13] * v.w,
+		m.matrix[2] * v.x + m.matrix[6] * v.y + m.matrix[10] * v.z + m.matrix[14] * v.w,
+		m.matrix[3] * v.x + m.matrix[7] * v.y + m.matrix[11] * v.z + m.matrix[15] * v.w);
+}
+
+static int wrap(int i, int period)
+{
+	return ((i % period) + period) % period;
+}
+
+static float fract(float x)
+{
+	return x - floorf(x);
+}
+
+// floor() for 4 floats on SSE2, which only truncates
+static __m128 floor4(__m128 x)
+{
+	__m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+	return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+}
+
+static __m128 clamp01(__m128 x)
+{
+	return _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+// GLSL smoothstep(0, 1, t) of an already scaled t
+static __m128 smooth4(__m128 t)
+{
+	t = clamp01(t);
+	return _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_add_ps(t, t)));
+}
+
+static float HG(float costheta)
+{
+	float g = 0.4f;
+	return 1.25f * PI_R * (1 - g * g) / powf(1 + g * g - 2 * g * costheta, 1.5f) + 0.5f;
+}
+
+bool CloudRaymarcher::init(const char * noise_path)
+{
+	int width, height, depth;
+	std::vector<unsigned char> rgba;
+	if (!CloudVolume::readTexels(noise_path, width, height, depth, rgba) || width != height || width != depth) {
+		printf("Error: Could not read cloud noise %s\n", noise_path);
+		return false;
+	}
+	noise_size = width;
+
+	size_t count = (size_t)width * height * depth;
+	noise.resize(count * 3);
+	std::vector<unsigned char> density(count);
+	for (size_t i = 0; i < count; i++) {
+		noise[i * 3 + 0] = rgba[i * 4 + 0] / 255.0f;
+		noise[i * 3 + 1] = rgba[i * 4 + 2] / 255.0f;
+		noise[i * 3 + 2] = rgba[i * 4 + 3] / 255.0f;
+		density[i] = rgba[i * 4];
+	}
+	return CloudTexture::build(density, width, height, depth, structure) == 0;
+}
+
+void CloudRaymarcher::sample4(const float x[4], const float y[4], const float z[4], float delta, float coverage, float alpha[4]) const
+{
+	// v.y -= 80, then texel space of the noise with texel centers at .5 like GL_LINEAR
+	const __m128 scale = _mm_set1_ps(noise_size / CLOUD_TILE_UNITS), half = _mm_set1_ps(0.5f);
+	__m128 height = _mm_sub_ps(_mm_loadu_ps(y), _mm_set1_ps(CLOUD_BASE));
+	__m128 fx = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(x), scale), half);
+	__m128 fy = _mm_sub_ps(_mm_mul_ps(height, scale), half);
+	__m128 fz = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(z), scale), half);
+	__m128 bx = floor4(fx), by = floor4(fy), bz = floor4(fz);
+	__m128 tx = _mm_sub_ps(fx, bx), ty = _mm_sub_ps(fy, by), tz = _mm_sub_ps(fz, bz);
+
+	// Gather the 8 texels around every point, the texture repeats
+	int ix[4], iy[4], iz[4];
+	_mm_storeu_si128((__m128i *)ix, _mm_cvtps_epi32(bx));
+	_mm_storeu_si128((__m128i *)iy, _mm_cvtps_epi32(by));
+	_mm_storeu_si128((__m128i *)iz, _mm_cvtps_epi32(bz));
+	alignas(16) float corners[3][8][4];
+	for (int lane = 0; lane < LANES; lane++) {
+		int x0 = wrap(ix[lane], noise_size), x1 = wrap(ix[lane] + 1, noise_size);
+		int y0 = wrap(iy[lane], noise_size), y1 = wrap(iy[lane] + 1, noise_size);
+		int z0 = wrap(iz[lane], noise_size), z1 = wrap(iz[lane] + 1, noise_size);
+		for (int c = 0; c < 8; c++) {
+			size_t texel = ((size_t)((c & 4) ? z1 : z0) * noise_size + ((c & 2) ? y1 : y0)) * noise_size + ((c & 1) ? x1 : x0);
+			for (int channel = 0; channel < 3; channel++)
+				corners[channel][c][lane] = noise[texel * 3 + channel];
+		}
+	}
+
+	// Trilinear filtering of red, blue and alpha
+	__m128 value[3];
+	for (int channel = 0; channel < 3; channel++) {
+		__m128 c[8];
+		for (int i = 0; i < 8; i++)
+			c[i] = _mm_load_ps(corners[channel][i]);
+		__m128 x00 = _mm_add_ps(c[0], _mm_mul_ps(_mm_sub_ps(c[1], c[0]), tx));
+		__m128 x10 = _mm_add_ps(c[2], _mm_mul_ps(_mm_sub_ps(c[3], c[2]), tx));
+		__m128 x01 = _mm_add_ps(c[4], _mm_mul_ps(_mm_sub_ps(c[5], c[4]), tx));
+		__m128 x11 = _mm_add_ps(c[6], _mm_mul_ps(_mm_sub_ps(c[7], c[6]), tx));
+		__m128 y0 = _mm_add_ps(x00, _mm_mul_ps(_mm_sub_ps(x10, x00), ty));
+		__m128 y1 = _mm_add_ps(x01, _mm_mul_ps(_mm_sub_ps(x11, x01), ty));
+		value[channel] = _mm_add_ps(y0, _mm_mul_ps(_mm_sub_ps(y1, y0), tz));
+	}
+
+	// cloud_coverage(r) * bottom * r * delta, with smoothstep(0.35, coverage, r) and smoothstep(0, 80, v.y)
+	__m128 r = value[0];
+	float range = coverage - 0.35f;
+	__m128 cover = range != 0.0f
+		? smooth4(_mm_mul_ps(_mm_sub_ps(r, _mm_set1_ps(0.35f)), _mm_set1_ps(1.0f / range)))
+		: _mm_and_ps(_mm_cmpge_ps(r, _mm_set1_ps(0.35f)), _mm_set1_ps(1.0f));
+	__m128 bottom = smooth4(_mm_mul_ps(height, _mm_set1_ps(1.0f / CLOUD_BASE)));
+	__m128 base = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(r, _mm_mul_ps(cover, r)), bottom), _mm_set1_ps(delta));
+
+	alignas(16) float b[4], blue[4], a[4];
+	_mm_store_ps(b, base);
+	_mm_store_ps(blue, value[1]);
+	_mm_store_ps(a, value[2]);
+	for (int lane = 0; lane < LANES; lane++)
+		alpha[lane] = b[lane] * powf(blue[lane], 0.3f) * powf(a[lane], 0.4f);
+}
+
+float CloudRaymarcher::emptySpace(const vec3 & point, const vec3 & dir) const
+{
+	vec3 uvw = vec3(point.x / CLOUD_TILE_UNITS, (point.y - CLOUD_BASE) / CLOUD_TILE_UNITS, point.z / CLOUD_TILE_UNITS);
+	for (int level = (int)structure.size() - 1; level >= 0; level--) {
+		int n = (int)round(cbrt((double)structure[level].size()));
+		float position[3] = { uvw.x * n, uvw.y * n, uvw.z * n };
+
+		// GL_NEAREST, repeating along x and z and the border (empty) above and below
+		int x = wrap((int)floorf(position[0]), n), y = (int)floorf(position[1]), z = wrap((int)floorf(position[2]), n);
+		if (y >= 0 && y < n && structure[level][((size_t)z * n + y) * n + x] > 0) continue;
+
+		// Leave the cell through the nearest face in the direction of the ray
+		float direction[3] = { dir.x, dir.y, dir.z };
+		float nearest = 1e6f;
+		for (int axis = 0; axis < 3; axis++) {
+			float speed = direction[axis] * n / CLOUD_TILE_UNITS;
+			if (fabsf(speed) <= 1e-6f) continue;
+			float face = floorf(position[axis]) + (direction[axis] >= 0.0f ? 1.0f : 0.0f);
+			nearest = std::min(nearest, (face - position[axis]) / speed);
+		}
+		return nearest + 0.01f;
+	}
+	return 0.0f;
+}
+
+void CloudRaymarcher::castRays(const Params & params, Ray * rays, int count) const
+{
+	const float delta_small = params.step_size;
+
+	// The light rays have the same steps for every ray
+	std::vector<float> light_steps;
+	for (float t = 0.0f; t < params.end / 10; t += LIGHT_STEP)
+		light_steps.push_back(t);
+
+	for (;;) {
+		// Step every ray on its own until it needs a sample, as the loop head of cast_ray
+		int sampling[LANES], sampled = 0;
+		for (int lane = 0; lane < count; lane++) {
+			Ray & ray = rays[lane];
+			while (!ray.done) {
+				if (!(ray.t < ray.last) || ray.color[3] >= 1.0f) {
+					ray.done = true;
+					break;
+				}
+				ray.point = ray.origin + ray.dir * ray.t;
+				if (!ray.inside) {
+					float skip = emptySpace(ray.point, ray.dir);
+					if (skip > 0.0f) {
+						ray.delta = skip;
+						ray.t += ray.delta;
+						continue;
+					}
+					ray.inside = true;
+					ray.points_inside = 0;
+					ray.delta = delta_small;
+					ray.t += ray.jitter * delta_small;
+					ray.point = ray.origin + ray.dir * ray.t;
+				}
+				sampling[sampled++] = lane;
+				break;
+			}
+		}
+		if (sampled == 0)
+			break;
+
+		// Density at the rays, unused lanes repeat the first ray
+		float x[LANES], y[LANES], z[LANES], alpha[LANES];
+		for (int i = 0; i < LANES; i++) {
+			const Ray & ray = rays[sampling[i < sampled ? i : 0]];
+			x[i] = ray.point.x;
+			y[i] = ray.point.y;
+			z[i] = ray.point.z;
+		}
+
+		// Light rays toward the sun, cast_scatter_ray
+		float sun[LANES][3], inside[LANES] = { 0.0f, 0.0f, 0.0f, 0.0f }, phase[LANES];
+		for (int i = 0; i < LANES; i++) {
+			const Ray & ray = rays[sampling[i < sampled ? i : 0]];
+			vec3 dir = vec3::normalize(params.sun_position - ray.point);
+			vec3 to_camera = params.camera_position - ray.point;
+			float costheta = vec3::dot(dir, to_camera) / vec3::length(dir) / vec3::length(to_camera);
+			phase[i] = HG(-costheta);
+			sun[i][0] = dir.x;
+			sun[i][1] = dir.y;
+			sun[i][2] = dir.z;
+		}
+		sample4(x, y, z, delta_small, params.coverage, alpha);
+		for (float t : light_steps) {
+			float lx[LANES], ly[LANES], lz[LANES], light[LANES];
+			for (int i = 0; i < LANES; i++) {
+				lx[i] = x[i] + sun[i][0] * t;
+				ly[i] = y[i] + sun[i][1] * t;
+				lz[i] = z[i] + sun[i][2] * t;
+			}
+			sample4(lx, ly, lz, LIGHT_STEP, params.coverage, light);
+			for (int i = 0; i < LANES; i++)
+				inside[i] += light[i];
+		}
+
+		// Rest of the loop body of cast_ray
+		for (int i = 0; i < sampled; i++) {
+			Ray & ray = rays[sampling[i]];
+			float a = alpha[i];
+			ray.color[3] = std::min(std::max(ray.color[3] + a, 0.0f), 1.0f);
+			ray.points_inside += 1;
+			ray.depth_sum += ray.t * a;
+			ray.alpha_sum += a;
+
+			float scatter = 3 * expf(-0.7f * inside[i]) * (1.0f - expf(-0.8f * inside[i]));
+			float energy = scatter * phase[i];
+			for (int c = 0; c < 3; c++)
+				ray.color[c] += CLOUD_BRIGHT * energy * a;
+
+			if (ray.points_inside * delta_small > RECHECK_DISTANCE) {
+				if (emptySpace(ray.point, ray.dir) > 0.0f) ray.inside = false;
+				ray.points_inside = 0;
+			}
+			ray.t += ray.delta;
+		}
+	}
+}
+
+void CloudRaymarcher::render(const Params & params, std::vector<float> & color, std::vector<float> * depth) const
+{
+	color.assign((size_t)params.width * params.height * 4, 0.0f);
+	if (depth)
+		depth->assign((size_t)params.width * params.height, 0.0f);
+
+	int tiles_x = (params.width + TILE_SIZE - 1) / TILE_SIZE;
+	int tiles_y = (params.height + TILE_SIZE - 1) / TILE_SIZE;
+	ThreadPool::instance().parallelFor(0, tiles_x * tiles_y, [&](int tile) {
+		int x0 = (tile % tiles_x) * TILE_SIZE, y0 = (tile / tiles_x) * TILE_SIZE;
+		int x1 = std::min(x0 + TILE_SIZE, params.width), y1 = std::min(y0 + TILE_SIZE, params.height);
+		for (int py = y0; py < y1; py++) {
+			for (int px = x0; px < x1; px += LANES) {
+				Ray rays[LANES];
+				int count = std::min(LANES, x1 - px);
+				for (int lane = 0; lane < count; lane++) {
+					Ray & ray = rays[lane];
+					float pixel_x = px + lane + 0.5f, pixel_y = py + 0.5f;
+
+					// Same ray as main() of the shader
+					float x = 2.0f * pixel_x / params.width - 1.0f;
+					float y = 2.0f * pixel_y / params.height - 1.0f;
+					vec4 ray_eye = transform(params.inv_proj, vec4(x, y, -1.0f, 1.0f));
+					vec4 ray_world = transform(params.inv_view, vec4(ray_eye.x, ray_eye.y, -1.0f, 0.0f));
+					ray.origin = params.camera_position;
+					ray.dir = vec3::normalize(vec3(ray_world.x, ray_world.y, ray_world.z));
+
+					ray.jitter = 0.0f;
+					if (params.jitter) {
+						float nx = pixel_x + 5.588238f * (float)(params.frame % 64), ny = pixel_y + 5.588238f * (float)(params.frame % 64);
+						ray.jitter = fract(52.9829189f * fract(nx * 0.06711056f + ny * 0.00583715f));
+					}
+
+					ray.last = std::min(params.end, params.stop);
+					ray.t = params.start;
+					ray.delta = params.step_size;
+					ray.inside = false;
+					ray.points_inside = 0;
+					ray.color[0] = SKY_COLOR[0];
+					ray.color[1] = SKY_COLOR[1];
+					ray.color[2] = SKY_COLOR[2];
+					ray.color[3] = 0.0f;
+					ray.depth_sum = 0.0f;
+					ray.alpha_sum = 0.0f;
+					// Rays that can not climb to the clouds are not marched
+					ray.done = !(ray.last > params.start && ray.origin.y + std::max(ray.dir.y, 0.0f) * ray.last > CLOUD_BASE);
+				}
+
+				castRays(params, rays, count);
+
+				for (int lane = 0; lane < count; lane++) {
+					const Ray & ray = rays[lane];
+					size_t pixel = (size_t)py * params.width + px + lane;
+					for (int c = 0; c < 4; c++)
+						color[pixel * 4 + c] = ray.color[c];
+					if (depth)
+						(*depth)[pixel] = ray.alpha_sum > 0.0f ? ray.depth_sum / ray.alpha_sum : ray.last;
+				}
+			}
+		}
+	});
+}
+
+void CloudRaymarcher::renderReference(std::vector<float> & color, std::vector<float> & depth) const
+{
+	// Looking north and a little up from below the clouds, the sun placed as by the application
+	Params params;
+	params.width = REFERENCE_WIDTH;
+	params.height = REFERENCE_HEIGHT;
+	params.camera_position = vec3(0.0f, 30.0f, 0.0f);
+	params.sun_position = params.camera_position + vec3(1337.0f, 1337.0f, 1337.0f);
+	params.inv_view = mat4::makeRotate(15.0f, vec3(1.0f, 0.0f, 0.0f));
+	params.inv_proj = mat4::inverse(mat4::makePerspective(45.0f, (float)REFERENCE_WIDTH / (float)REFERENCE_HEIGHT, 0.1f, 100.0f));
+	render(params, color, &depth);
+}
+
+bool CloudRaymarcher::writeReference(const char * reference_path) const
+{
+	std::vector<float> color, depth;
+	renderReference(color, depth);
+
+	// The file holds the size, then the RGBA floats and the depth floats of render()
+	FILE * file = fopen(reference_path, "wb");
+	if (file == NULL) {
+		printf("Error: Unable to open file: %s\n", reference_path);
+		return false;
+	}
+	int size[2] = { REFERENCE_WIDTH, REFERENCE_HEIGHT };
+	bool written = fwrite(size, sizeof(size), 1, file) == 1
+		&& fwrite(color.data(), sizeof(float), color.size(), file) == color.size()
+		&& fwrite(depth.data(), sizeof(float), depth.size(), file) == depth.size();
+	fclose(file);
+	if (written)
+		printf("Cloud reference: stored this render as %s\n", reference_path);
+	else
+		printf("Error: Could not write cloud reference %s\n", reference_path);
+	return written;
+}
+
+bool CloudRaymarcher::check(const char * reference_path, const char * diff_path) const
+{
+	std::vector<float> color, depth;
+	renderReference(color, depth);
+
+	FILE * file = fopen(reference_path, "rb");
+	if (file == NULL) {
+		printf("Error: No cloud reference %s\n", reference_path);
+		return false;
+	}
+	int size[2] = {};
+	std::vector<float> reference_color(color.size()), reference_depth(depth.size());
+	bool read = fread(size, sizeof(size), 1, file) == 1 && size[0] == REFERENCE_WIDTH && size[1] == REFERENCE_HEIGHT
+		&& fread(reference_color.data(), sizeof(float), reference_color.size(), file) == reference_color.size()
+		&& fread(reference_depth.data(), sizeof(float), reference_depth.size(), file) == reference_depth.size();
+	fclose(file);
+	if (!read) {
+		printf("Error: %s is not a %dx%d cloud reference\n", reference_path, REFERENCE_WIDTH, REFERENCE_HEIGHT);
+		return false;
+	}
+
+	// The differences as an image, red for color and green for depth, full at 16 times the tolerance
+	std::vector<float> diff(color.size(), 0.0f);
+	float max_color = 0.0f, max_depth = 0.0f;
+	int mismatches = 0;
+	for (size_t pixel = 0; pixel < depth.size(); pixel++) {
+		// Written so that a NaN on either side counts as a difference
+		bool same = true;
+		float pixel_color = 0.0f;
+		for (int c = 0; c < 4; c++) {
+			float difference = fabsf(color[pixel * 4 + c] - reference_color[pixel * 4 + c]);
+			max_color = std::max(max_color, difference);
+			pixel_color = std::max(pixel_color, difference);
+			same = same && difference <= REFERENCE_COLOR_TOLERANCE;
+		}
+		float difference = fabsf(depth[pixel] - reference_depth[pixel]);
+		max_depth = std::max(max_depth, difference);
+		same = same && difference <= REFERENCE_DEPTH_TOLERANCE;
+		if (!same)
+			mismatches++;
+
+		diff[pixel * 4 + 0] = same ? std::min(pixel_color / (16.0f * REFERENCE_COLOR_TOLERANCE), 1.0f) : 1.0f;
+		diff[pixel * 4 + 1] = difference < 16.0f * REFERENCE_DEPTH_TOLERANCE ? difference / (16.0f * REFERENCE_DEPTH_TOLERANCE) : 1.0f;
+		diff[pixel * 4 + 3] = 1.0f;
+	}
+	printf("Cloud reference: %d of %d pixels differ, largest difference %f in color and %f in depth\n",
+		mismatches, (int)depth.size(), max_color, max_depth);
+	if (mismatches > 0 && writePPM(diff_path, diff, REFERENCE_WIDTH, REFERENCE_HEIGHT))
+		printf("Cloud reference: differences written to %s\n", diff_path);
+	return mismatches == 0;
+}
+
+bool CloudRaymarcher::writePPM(const char * path, const std::vector<float> & color, int width, int height)
+{
+	if (color.size() != (size_t)width * height * 4)
+		return false;
+	FILE * file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Error: Unable to open file: %s\n", path);
+		return false;
+	}
+
+	// Over the sky as in the shader, then gamma corrected like the sRGB framebuffer. Rows go top down in the file
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	std::vector<unsigned char> row((size_t)width * 3);
+	for (int y = height - 1; y >= 0; y--) {
+		for (int x = 0; x < width; x++) {
+			const float * pixel = &color[((size_t)y * width + x) * 4];
+			for (int c = 0; c < 3; c++) {
+				float value = SKY_COLOR[c] + (pixel[c] - SKY_COLOR[c]) * pixel[3];
+				value = std::min(std::max(value, 0.0f), 1.0f);
+				row[x * 3 + c] = (unsigned char)(powf(value, 1.0f / 2.2f) * 255.0f + 0.5f);
+			}
+		}
+		fwrite(row.data(), 1, row.size(), file);
+	}
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "maths.h"
+#include <vector>
+
+/*
+CPU version of the cloud raymarcher in cloud_frag.shader (cast_ray, cast_scatter_ray, cloud_sampling, empty_space and
+the HG phase function), for rendering clouds without a GPU: reference images, headless renders and offline bakes.
+
+It reads the same noise volume file and builds the same structure pyramid as the GPU path, and Params has the names
+and defaults of the shader uniforms, so a frame can be rendered with the values the shader was given. It follows the
+shader path without the light volume, bricks or scene depth. Textures are sampled at level 0, so it differs from the
+GPU where the GPU picks smaller mipmaps.
+
+check() renders a fixed view and compares it with the reference committed next to the noise, so changes to the port
+can be tested headless. The application runs it instead of opening a window when started with --cloud-reference-check,
+and --update-cloud-reference stores a new reference after an intended change.
+
+The image is split into 16x16 tiles over the ThreadPool. The rays of a tile are marched 4 at a time: every ray steps
+on its own, and the noise samples of the 4 rays (and their light rays) are filtered and shaded together on SSE.
+*/
+class CloudRaymarcher
+{
+public:
+	struct Params {
+		int width = 0, height = 0;	// window_size
+		vec3 camera_position;
+		vec3 sun_position;
+		mat4 inv_view, inv_proj;
+		float end = 500.0f;
+		float coverage = 0.4f;
+		float start = 0.0f;
+		float stop = 1e6f;
+		float step_size = 1.0f;
+		bool jitter = false;	// Jitter the start of the samples as in temporal mode, with frame
+		int frame = 0;
+	};
+	/* Load a cloud noise volume file and build its structure. Returns false on failure */
+	bool init(const char * noise_path);
+	/* March every pixel. color gets the cloud color and alpha as RGBA floats, rows bottom up like gl_FragCoord. depth gets the cloud distance */
+	void render(const Params & params, std::vector<float> & color, std::vector<float> * depth = nullptr) const;
+	/* Render a small fixed view and compare it with the reference file, color and depth within a small tolerance. When
+	they differ an image of the differences is written to diff_path. Returns false when they differ or there is no reference */
+	bool check(const char * reference_path, const char * diff_path) const;
+	/* Render the view of check() and store it as the new reference. Returns false on failure */
+	bool writeReference(const char * reference_path) const;
+	/* Write the clouds from render() over the sky color as a binary PPM. Returns false on failure */
+	static bool writePPM(const char * path, const std::vector<float> & color, int width, int height);
+private:
+	struct Ray;
+	int noise_size = 0;
+	std::vector<float> noise;	// Red, blue and alpha of the noise as 0-1 floats, the channels the shader reads
+	std::vector<std::vector<unsigned char>> structure;
+	/* cloud_sampling for 4 points */
+	void sample4(const float x[4], const float y[4], const float z[4], float delta, float coverage, float alpha[4]) const;
+	/* empty_space of the shader */
+	float emptySpace(const vec3 & v, const vec3 & dir) const;
+	/* Render the fixed view of check() */
+	void renderReference(std::vector<float> & color, std::vector<float> & depth) const;
+	/* March 4 rays together */
+	void castRays(const Params & params, Ray * rays, int count) const;
+};
@@ -0,0 +1,144 @@
+#include "CloudSky.h"
+#include "GLState.h"
+
+// Field of view of one cubemap face
+#define FACE_FOV 90.0f
+
+// View matrix looking along forward, the rotation part of Camera::GetViewMatrix
+static mat4 faceView(const vec3 & forward, const vec3 & up)
+{
+	vec3 f(vec3::normalize(forward));
+	vec3 s(vec3::normalize(vec3::cross(f, up)));
+	vec3 u(vec3::cross(s, f));
+
+	mat4 result;
+	result.matrix[0] = s.x;
+	result.matrix[4] = s.y;
+	result.matrix[8] = s.z;
+	result.matrix[1] = u.x;
+	result.matrix[5] = u.y;
+	result.matrix[9] = u.z;
+	result.matrix[2] = -f.x;
+	result.matrix[6] = -f.y;
+	result.matrix[10] = -f.z;
+	result.matrix[15] = 1.0f;
+	return result;
+}
+
+void CloudSky::init(int size, int tiles)
+{
+	this->size = size;
+	this->tiles = tiles > 0 ? tiles : 1;
+
+	glCreateTextures(GL_TEXTURE_CUBE_MAP, 3, cubemap);
+	for (int i = 0; i < 3; i++) {
+		glTextureStorage2D(cubemap[i], 1, GL_RGBA16F, size, size);
+		glTextureParameteri(cubemap[i], GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(cubemap[i], GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(cubemap[i], GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(cubemap[i], GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(cubemap[i], GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+	// Filter across the edges of the faces, the tiles are rendered separately
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	// The faces of a cube map are its layers
+	glCreateFramebuffers(1, &fbo);
+	glNamedFramebufferTextureLayer(fbo, GL_COLOR_ATTACHMENT0, cubemap[0], 0, 0);
+	// Only the cloud color is kept, the distance the cloud shader writes to location 1 is dropped
+	GLenum attachments[1] = { GL_COLOR_ATTACHMENT0 };
+	glNamedFramebufferDrawBuffers(fbo, 1, attachments);
+	if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Error: Cloud sky Framebuffer not created!" << std::endl;
+}
+
+bool CloudSky::bakeNextTile(Shader & shader, const vec3 & camera_position, void (*draw_quad)())
+{
+	if (fbo == 0)
+		return false;
+
+	// Every tile of a bake is seen from the same place
+	if (tile == 0)
+		bake_position = camera_position;
+
+	GLint viewport[4];
+	GLState::getViewport(viewport);
+	bool blend = GLState::isEnabled(GL_BLEND);
+	GLState::disable(GL_BLEND);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, fbo);
+	GLState::viewport(0, 0, size, size);
+	GLState::enable(GL_SCISSOR_TEST);
+
+	shader.use();
+	shader.setVec2("window_size", vec2((float)size, (float)size));
+	shader.setVec3("camera_position", bake_position);
+	shader.setInt("frame", (int)bakes);
+
+	// The first bake is needed right away, later ones are spread over the frames
+	int total = 6 * tiles * tiles;
+	do {
+		renderTile(shader, tile, draw_quad);
+		tile++;
+	} while (current < 0 && tile < total);
+
+	GLState::disable(GL_SCISSOR_TEST);
+	GLState::viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	if (blend)
+		GLState::enable(GL_BLEND);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (tile < total)
+		return false;
+
+	// The finished bake becomes the current one, and the oldest cubemap is baked next
+	previous = current < 0 ? baking : current;
+	current = baking;
+	baking = previous == current ? (current + 1) % 3 : 3 - previous - current;
+	tile = 0;
+	bakes++;
+	return true;
+}
+
+void CloudSky::renderTile(Shader & shader, int index, void (*draw_quad)())
+{
+	// Same orientation of the faces as a cubemap sampled with the direction
+	static const vec3 FORWARD[6] = { vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1) };
+	static const vec3 UP[6] = { vec3(0, -1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1), vec3(0, -1, 0), vec3(0, -1, 0) };
+
+	int face = index / (tiles * tiles);
+	int x = index % tiles;
+	int y = (index / tiles) % tiles;
+	int tile_size = (size + tiles - 1) / tiles;
+
+	glNamedFramebufferTextureLayer(fbo, GL_COLOR_ATTACHMENT0, cubemap[baking], 0, face);
+	glScissor(x * tile_size, y * tile_size, tile_size, tile_size);
+
+	mat4 view = faceView(FORWARD[face], UP[face]);
+	mat4 projection = mat4::makePerspective(FACE_FOV, 1.0f, 0.1f, 100.0f);
+	shader.setMat4("view", view);
+	shader.setMat4("proj", projection);
+	shader.setMat4("inv_view", mat4::inverse(view));
+	shader.setMat4("inv_proj", mat4::inverse(projection));
+
+	draw_quad();
+}
+
+void CloudSky::bind(Shader & shader, unsigned int unit)
+{
+	if (current < 0)
+		return;
+
+	shader.use();
+	shader.setInt("previous_clouds", unit);
+	shader.setInt("clouds", unit + 1);
+	shader.setFloat("clouds_blend", (float)tile / (6 * tiles * tiles));
+	GLState::activeTexture(GL_TEXTURE0 + unit);
+	GLState::bindTexture(GL_TEXTURE_CUBE_MAP, cubemap[previous]);
+	GLState::activeTexture(GL_TEXTURE0 + unit + 1);
+	GLState::bindTexture(GL_TEXTURE_CUBE_MAP, cubemap[current]);
+}
+
+bool CloudSky::ready() const
+{
+	return current >= 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Shader.h"
+
+/*
+Distant clouds baked into a cubemap that the skybox draws, so only the clouds close to the camera are marched per pixel.
+
+The bake is spread over many frames: every frame renders one tile of one face with the cloud shader, so a full bake
+takes 6 * tiles^2 frames. Three cubemaps take turns. The skybox blends from the previous bake to the current one
+while the next bake is rendered, so a finished bake fades in instead of popping. The first bake is rendered in one go.
+*/
+class CloudSky
+{
+public:
+	/* Create the cubemaps and the framebuffer the tiles are rendered with. tiles is the number of tiles along a side of a face */
+	void init(int size, int tiles);
+	/* Render the next tile with a cloud shader (cloud_frag in temporal mode) from the position the bake started at. Returns whether a bake was finished */
+	bool bakeNextTile(Shader & shader, const vec3 & camera_position, void (*draw_quad)());
+	/* Bind the previous and current bakes to the units unit and unit + 1 for the cubemap shader, and set their blend */
+	void bind(Shader & shader, unsigned int unit);
+	/* Returns whether a bake has been finished and can be drawn */
+	bool ready() const;
+private:
+	unsigned int fbo = 0, cubemap[3] = { 0, 0, 0 };
+	int size = 0, tiles = 1, tile = 0;
+	int previous = -1, current = -1, baking = 0;
+	unsigned int bakes = 0;
+	vec3 bake_position;
+	/* Render one tile of the cubemap being baked */
+	void renderTile(Shader & shader, int index, void (*draw_quad)());
+};
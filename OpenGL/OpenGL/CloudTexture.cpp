@@ -1,105 +1,129 @@
 #include "CloudTexture.h"
+#include "ThreadPool.h"
+#include <emmintrin.h>
 
 /* Based on the cloud processing method by Rikard Olajos,
 in his master's thesis: Real-Time Rendering of Volumetric Clouds
 http://lup.lub.lu.se/luur/download?func=downloadFile&recordOId=8893256&fileOId=8893258
 https://github.com/rikardolajos/clouds */
 
+// Structure cells along every axis of the finest level
+#define STRUCTURE_SIZE 32
+// Smallest density that counts as inside, same as structure(): pixel / 255.0 > 0.35
+#define INSIDE_DENSITY 90
+
 GLubyte CloudTexture::structure(GLubyte pixel)
 {
 	return (pixel / 255.0 > 0.35) ? 1: 0;
 }
 
-int CloudTexture::process(Texture * cloud_structure, Texture cloud_texture)
+int CloudTexture::build(const std::vector<GLubyte> & density, int width, int height, int depth, std::vector<std::vector<GLubyte>> & levels)
 {
-	// Read the source texture
-	std::vector<GLubyte> cloud_pixels;
-	cloud_pixels.resize(cloud_texture.width * cloud_texture.height * cloud_texture.depth * 4);
-	
-	glBindTexture(GL_TEXTURE_3D, cloud_texture.id);
-	glGetTexImage(GL_TEXTURE_3D, 0, GL_RGBA, GL_UNSIGNED_BYTE, cloud_pixels.data());
-
-	// Set size of structure texture, Creates 4x4x4 cubes of original 128x128x128 texture
-	cloud_structure->width = 32;
-	cloud_structure->height = 32;
-	cloud_structure->depth = 32;
-
-	// Pick the red channel of the texture and procces it
-	std::vector<GLubyte> red_channel;
-	red_channel.resize(cloud_texture.width * cloud_texture.height * cloud_texture.depth);
-	for (int i = 0; i < red_channel.size(); i++) {
-		red_channel.at(i) = structure(cloud_pixels.at(i * 4));
-	}
-
-	std::vector<GLubyte> new_cloud_structure;
-	new_cloud_structure.resize(cloud_structure->width * cloud_structure->height * cloud_structure->depth);
-
-	// Analyze every 4x4x4 block of the cloud texture
-	int inside = 0;
-	for (int i = 0; i < cloud_structure->width; i++) for (int j = 0; j < cloud_structure->height; j++) for (int k = 0; k < cloud_structure->depth; k++) {
-
-		inside = 0;
-
-		for (int u = 0; u < 4; u++) for (int v = 0; v < 4; v++) for (int w = 0; w < 4; w++) {
-
-			int x = i * 4 + u;
-			int y = j * 4 + v;
-			int z = k * 4 + w;
-
-			inside += red_channel.at(x + y * cloud_texture.height + z * cloud_texture.height * cloud_texture.depth);
+	if (width < 1 || height < 1 || depth < 1 || density.size() != (size_t)width * height * depth)
+		return -1;
+
+	ThreadPool & pool = ThreadPool::instance();
+
+	// Size of structure texture, Creates 4x4x4 cubes of original 128x128x128 texture (2x2x2 of 64^3, 8x8x8 of 256^3)
+	const int size = STRUCTURE_SIZE;
+	int block_x = width / size > 0 ? width / size : 1;
+	int block_y = height / size > 0 ? height / size : 1;
+	int block_z = depth / size > 0 ? depth / size : 1;
+
+	// Threshold the density, 16 texels at a time
+	std::vector<GLubyte> inside(density.size());
+	pool.parallelFor(0, depth, [&](int z) {
+		size_t i = (size_t)z * width * height, end = i + (size_t)width * height;
+		const __m128i threshold = _mm_set1_epi8((char)INSIDE_DENSITY), one = _mm_set1_epi8(1);
+		for (; i + 16 <= end; i += 16) {
+			__m128i pixels = _mm_loadu_si128((const __m128i *)&density[i]);
+			__m128i above = _mm_cmpeq_epi8(_mm_max_epu8(pixels, threshold), pixels);
+			_mm_storeu_si128((__m128i *)&inside[i], _mm_and_si128(above, one));
 		}
-
-		if (inside < 8)
-			new_cloud_structure.at(i + j * cloud_structure->height + k * cloud_structure->height * cloud_structure->depth) = 0;
-		else
-			new_cloud_structure.at(i + j * cloud_structure->height + k * cloud_structure->height * cloud_structure->depth) = 255;
-	}
-
-	// Post processing to reduce artifacts
-	std::vector<GLubyte> post_pixels;
-	post_pixels.resize(cloud_structure->width * cloud_structure->height * cloud_structure->depth);
-
-	for (int i = 0; i < cloud_structure->width; i++) for (int j = 0; j < cloud_structure->height; j++) for (int k = 0; k < cloud_structure->depth; k++) {
-
-		if (new_cloud_structure.at(k + j * cloud_structure->height + i * cloud_structure->height * cloud_structure->depth) == 0) {
-			continue;
+		for (; i < end; i++)
+			inside[i] = structure(density[i]);
+	});
+
+	// A cell is part of a cloud when at least 1/8 of its block is inside (8 of 64 texels)
+	std::vector<GLubyte> cells((size_t)size * size * size);
+	int block_volume = block_x * block_y * block_z;
+	pool.parallelFor(0, size, [&](int k) {
+		for (int j = 0; j < size; j++) for (int i = 0; i < size; i++) {
+			int count = 0;
+			for (int w = 0; w < block_z; w++) for (int v = 0; v < block_y; v++) {
+				int z = (k * block_z + w) % depth, y = (j * block_y + v) % height;
+				const GLubyte * row = &inside[((size_t)z * height + y) * width];
+				for (int u = 0; u < block_x; u++)
+					count += row[(i * block_x + u) % width];
+			}
+			cells[((size_t)k * size + j) * size + i] = (count * 8 >= block_volume) ? 255 : 0;
 		}
-
-		for (int ii = -1; ii < 2; ii++) {
-			if (i + ii < 0 || i + ii >= cloud_structure->width) continue;
-			for (int jj = -1; jj < 2; jj++) {
-				if (j + jj < 0 || j + jj >= cloud_structure->height) continue;
-				for (int kk = -1; kk < 2; kk++) {
-					if (k + kk < 0 || k + kk >= cloud_structure->depth) continue;
-					post_pixels.at((k + kk) + (j + jj) * cloud_structure->height + (i + ii) * cloud_structure->height * cloud_structure->depth) = 255;
+	});
+
+	// Post processing to reduce artifacts, grow every cloud cell into its 26 neighbours
+	std::vector<GLubyte> dilated(cells.size());
+	pool.parallelFor(0, size, [&](int k) {
+		for (int j = 0; j < size; j++) for (int i = 0; i < size; i++) {
+			GLubyte value = 0;
+			for (int kk = -1; kk < 2 && !value; kk++) {
+				if (k + kk < 0 || k + kk >= size) continue;
+				for (int jj = -1; jj < 2 && !value; jj++) {
+					if (j + jj < 0 || j + jj >= size) continue;
+					for (int ii = -1; ii < 2 && !value; ii++) {
+						if (i + ii < 0 || i + ii >= size) continue;
+						value = cells[((size_t)(k + kk) * size + (j + jj)) * size + (i + ii)];
+					}
 				}
 			}
+			dilated[((size_t)k * size + j) * size + i] = value;
+		}
+	});
+
+	// Max pyramid, a cell is empty on a level only when all 8 cells below it are
+	levels.clear();
+	levels.push_back(std::move(dilated));
+	for (int n = size / 2; n >= 1; n /= 2) {
+		const std::vector<GLubyte> & below = levels.back();
+		std::vector<GLubyte> level((size_t)n * n * n);
+		for (int k = 0; k < n; k++) for (int j = 0; j < n; j++) for (int i = 0; i < n; i++) {
+			GLubyte value = 0;
+			for (int c = 0; c < 8; c++) {
+				int x = i * 2 + (c & 1), y = j * 2 + ((c >> 1) & 1), z = k * 2 + (c >> 2);
+				value |= below[((size_t)z * n * 2 + y) * n * 2 + x];
+			}
+			level[((size_t)k * n + j) * n + i] = value;
 		}
+		levels.push_back(std::move(level));
 	}
+	return 0;
+}
+
+int CloudTexture::process(Texture * cloud_structure, const std::vector<GLubyte> & density, int width, int height, int depth)
+{
+	std::vector<std::vector<GLubyte>> levels;
+	if (build(density, width, height, depth, levels) != 0)
+		return -1;
 
-	// Bind the new cloud structure texture to an unique ID
-	glGenTextures(1, &cloud_structure->id);
-	glBindTexture(GL_TEXTURE_3D, cloud_structure->id);
+	const int size = STRUCTURE_SIZE;
+	cloud_structure->width = size;
+	cloud_structure->height = size;
+	cloud_structure->depth = size;
 
-	// Assign new cloud structure texture to it's ID
+	// The pyramid is the whole mip chain of the texture
+	glCreateTextures(GL_TEXTURE_3D, 1, &cloud_structure->id);
 	activateTexture(cloud_structure);
-	glTexImage3D(GL_TEXTURE_3D, 0, GL_RED, cloud_structure->width, cloud_structure->height, cloud_structure->depth, 0, GL_RED, GL_UNSIGNED_BYTE, post_pixels.data());
-	glGenerateMipmap(GL_TEXTURE_3D);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
-
-	// Free memory
-	cloud_pixels.clear();
-	cloud_pixels.shrink_to_fit();
-	red_channel.clear();
-	red_channel.shrink_to_fit();
-	new_cloud_structure.clear();
-	new_cloud_structure.shrink_to_fit();
-	post_pixels.clear();
-	post_pixels.shrink_to_fit();
+	glTextureStorage3D(cloud_structure->id, (GLsizei)levels.size(), GL_R8, size, size, size);
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t level = 0, n = size; level < levels.size(); level++, n /= 2)
+		glTextureSubImage3D(cloud_structure->id, (GLint)level, 0, 0, 0, (GLsizei)n, (GLsizei)n, (GLsizei)n, GL_RED, GL_UNSIGNED_BYTE, levels[level].data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glTextureParameteri(cloud_structure->id, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(cloud_structure->id, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(cloud_structure->id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(cloud_structure->id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTextureParameteri(cloud_structure->id, GL_TEXTURE_WRAP_R, GL_REPEAT);
 
 	return 0;
-}
\ No newline at end of file
+}
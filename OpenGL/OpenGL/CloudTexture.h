@@ -16,6 +16,9 @@ class CloudTexture {
 public:
 	// Return 1 if inside cloud, 0 if not.
 	static GLubyte structure(GLubyte pixel);
-	// Process the 3D noise texture.
-	static int process(Texture* cloud_structure, Texture cloud_texture);
+	// Build the occupancy pyramid of process() on the CPU, level 0 is 32^3 and every next level half the size.
+	static int build(const std::vector<GLubyte>& density, int width, int height, int depth, std::vector<std::vector<GLubyte>>& levels);
+	// Process the density (red channel) of the 3D noise texture into a 32^3 occupancy texture, with a mip pyramid
+	// where every level is the max of the level below, so empty space can be skipped hierarchically.
+	static int process(Texture* cloud_structure, const std::vector<GLubyte>& density, int width, int height, int depth);
 };
\ No newline at end of file
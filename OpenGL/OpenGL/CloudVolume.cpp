@@ -0,0 +1,344 @@
+#include "CloudVolume.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// cloud_frag.shader samples red, blue and alpha of the noise, green is never read
+static const unsigned char CLOUD_CHANNELS[] = { 0, 2, 3 };
+
+static_assert(sizeof(CloudVolume::Header) == 64, "Volume header must stay 64 bytes so the texels stay aligned");
+
+// Read only view of a whole file, mapped into memory
+class MappedFile
+{
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE, mapping = NULL;
+#endif
+public:
+	const unsigned char * data = nullptr;
+	size_t size = 0;
+
+	MappedFile(const char * path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) return;
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) return;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) return;
+		data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data) size = (size_t)file_size.QuadPart;
+#else
+		int fd = open(path, O_RDONLY);
+		if (fd < 0) return;
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0) {
+			void * view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (view != MAP_FAILED) {
+				data = (const unsigned char *)view;
+				size = (size_t)info.st_size;
+			}
+		}
+		close(fd);
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (mapping != NULL) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+		if (data) munmap((void *)data, size);
+#endif
+	}
+};
+
+static bool fileInfo(const char * path, uint64_t & size, uint64_t & time)
+{
+	struct stat info;
+	if (stat(path, &info) != 0)
+		return false;
+	size = (uint64_t)info.st_size;
+	time = (uint64_t)info.st_mtime;
+	return true;
+}
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Parse one integer like %d into an unsigned 32-bit value, returns false at the end of the range
+static bool parseNumber(const char *& p, const char * end, uint32_t & value)
+{
+	while (p < end && isSpace(*p)) p++;
+	if (p == end) return false;
+
+	bool negative = (*p == '-');
+	if (*p == '-' || *p == '+') p++;
+	if (p == end || *p < '0' || *p > '9') {
+		p = end;
+		return false;
+	}
+	uint32_t v = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+		v = v * 10 + (uint32_t)(*p++ - '0');
+	value = negative ? (uint32_t)(0u - v) : v;
+	return true;
+}
+
+bool CloudVolume::parseEX5(const char * path, int & width, int & height, int & depth, std::vector<unsigned char> & rgba)
+{
+	FILE * fp = fopen(path, "rb");
+	if (fp == NULL)
+		return false;
+
+	std::vector<char> text;
+	fseek(fp, 0, SEEK_END);
+	long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	if (length > 0) {
+		text.resize((size_t)length);
+		text.resize(fread(text.data(), 1, text.size(), fp));
+	}
+	fclose(fp);
+
+	/* Read header */
+	const char * p = text.data(), * end = text.data() + text.size();
+	uint32_t size[3];
+	for (int i = 0; i < 3; i++) {
+		if (!parseNumber(p, end, size[i]) || size[i] == 0 || size[i] > 4096)
+			return false;
+	}
+	width = (int)size[0];
+	height = (int)size[1];
+	depth = (int)size[2];
+
+	// Split the numbers into chunks that start and end on whitespace, every chunk is parsed on its own
+	int chunks = (int)ThreadPool::instance().size() * 4;
+	std::vector<const char *> bounds(chunks + 1);
+	bounds[0] = p;
+	bounds[chunks] = end;
+	for (int i = 1; i < chunks; i++) {
+		const char * b = p + (end - p) * i / chunks;
+		if (b < bounds[i - 1]) b = bounds[i - 1];
+		while (b < end && !isSpace(*b)) b++;
+		bounds[i] = b;
+	}
+
+	std::vector<std::vector<uint32_t>> values(chunks);
+	ThreadPool::instance().parallelFor(0, chunks, [&](int i) {
+		const char * c = bounds[i];
+		values[i].reserve((bounds[i + 1] - c) / 8 + 1);
+		uint32_t pixel;
+		while (parseNumber(c, bounds[i + 1], pixel))
+			values[i].push_back(pixel);
+	});
+
+	/* Create image, a short file is padded with zeros */
+	size_t count = (size_t)width * height * depth, texel = 0;
+	rgba.assign(count * 4, 0);
+	for (int i = 0; i < chunks; i++) for (size_t j = 0; j < values[i].size() && texel < count; j++, texel++) {
+		uint32_t pixel = values[i][j];
+		rgba[texel * 4 + 0] = (unsigned char)(pixel >> 24);
+		rgba[texel * 4 + 1] = (unsigned char)(pixel >> 16);
+		rgba[texel * 4 + 2] = (unsigned char)(pixel >> 8);
+		rgba[texel * 4 + 3] = (unsigned char)(pixel >> 0);
+	}
+	return true;
+}
+
+bool CloudVolume::write(const char * volume_path, const unsigned char * rgba, int width, int height, int depth, const Header & source)
+{
+	// Keep only the channels that are sampled
+	const int channels = sizeof(CLOUD_CHANNELS);
+	size_t count = (size_t)width * height * depth;
+	std::vector<unsigned char> compact(count * channels);
+	ThreadPool::instance().parallelFor(0, depth, [&](int z) {
+		for (size_t i = (size_t)z * width * height; i < (size_t)(z + 1) * width * height; i++) for (int c = 0; c < channels; c++)
+			compact[i * channels + c] = rgba[i * 4 + CLOUD_CHANNELS[c]];
+	});
+
+	// Noise is linear data, averaged over 2x2x2 texels per level
+	std::vector<MipGenerator::Level> levels = MipGenerator::generate3D(compact.data(), width, height, depth, channels, MipGenerator::BOX, MipGenerator::LINEAR);
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "CVL1", 4);
+	header.width = width;
+	header.height = height;
+	header.depth = depth;
+	header.channels = channels;
+	header.levels = (uint32_t)levels.size();
+	for (int c = 0; c < 4; c++)
+		header.channel_map[c] = (c < channels) ? CLOUD_CHANNELS[c] : 0;
+	header.source_size = source.source_size;
+	header.source_time = source.source_time;
+	header.generator_hash = source.generator_hash;
+
+	FILE * fp = fopen(volume_path, "wb");
+	if (fp == NULL)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	for (const MipGenerator::Level & level : levels)
+		ok = ok && fwrite(level.data.data(), 1, level.data.size(), fp) == level.data.size();
+	fclose(fp);
+
+	if (!ok) remove(volume_path);
+	return ok;
+}
+
+bool CloudVolume::readHeader(const char * volume_path, Header & header)
+{
+	FILE * fp = fopen(volume_path, "rb");
+	if (fp == NULL)
+		return false;
+	bool read = fread(&header, sizeof(header), 1, fp) == 1;
+	fclose(fp);
+	return read && memcmp(header.magic, "CVL1", 4) == 0;
+}
+
+bool CloudVolume::convert(const char * ex5_path, const char * volume_path)
+{
+	int width, height, depth;
+	std::vector<unsigned char> rgba;
+	if (!parseEX5(ex5_path, width, height, depth, rgba))
+		return false;
+
+	Header source;
+	memset(&source, 0, sizeof(source));
+	fileInfo(ex5_path, source.source_size, source.source_time);
+	return write(volume_path, rgba.data(), width, height, depth, source);
+}
+
+bool CloudVolume::upToDate(const char * ex5_path, const char * volume_path)
+{
+	Header header;
+	uint64_t size, time;
+	if (!readHeader(volume_path, header) || !fileInfo(ex5_path, size, time))
+		return false;
+	return header.source_size == size && header.source_time == time;
+}
+
+bool CloudVolume::readTexels(const char * volume_path, int & width, int & height, int & depth, std::vector<unsigned char> & rgba)
+{
+	MappedFile file(volume_path);
+	if (file.data == nullptr || file.size < sizeof(Header))
+		return false;
+
+	Header header;
+	memcpy(&header, file.data, sizeof(header));
+	if (memcmp(header.magic, "CVL1", 4) != 0 || header.channels < 1 || header.channels > 4 || header.levels == 0)
+		return false;
+
+	size_t count = (size_t)header.width * header.height * header.depth;
+	if (sizeof(Header) + count * header.channels > file.size)
+		return false;
+
+	width = header.width;
+	height = header.height;
+	depth = header.depth;
+	rgba.assign(count * 4, 0);
+	const unsigned char * texels = file.data + sizeof(Header);
+	for (uint32_t c = 0; c < header.channels; c++) {
+		unsigned char target = header.channel_map[c];
+		if (target > 3) continue;
+		for (size_t i = 0; i < count; i++)
+			rgba[i * 4 + target] = texels[i * header.channels + c];
+	}
+	return true;
+}
+
+bool CloudVolume::load(Texture * t, const char * volume_path, std::vector<unsigned char> * density)
+{
+	MappedFile file(volume_path);
+	if (file.data == nullptr || file.size < sizeof(Header))
+		return false;
+
+	Header header;
+	memcpy(&header, file.data, sizeof(header));
+	if (memcmp(header.magic, "CVL1", 4) != 0 || header.channels < 1 || header.channels > 4 || header.levels == 0)
+		return false;
+
+	// Check that every level is in the file before handing pointers to GL
+	size_t offset = sizeof(Header);
+	int w = header.width, h = header.height, d = header.depth;
+	for (uint32_t level = 0; level < header.levels; level++) {
+		offset += (size_t)w * h * d * header.channels;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+		d = d > 1 ? d / 2 : 1;
+	}
+	if (offset > file.size)
+		return false;
+
+	// CPU copy of the density for the structure preprocessing, so it does not have to be read back from the GPU
+	if (density) {
+		size_t count = (size_t)header.width * header.height * header.depth;
+		density->assign(count, 0);
+		for (uint32_t c = 0; c < header.channels; c++) {
+			if (header.channel_map[c] != 0) continue;
+			const unsigned char * texels = file.data + sizeof(Header) + c;
+			for (size_t i = 0; i < count; i++)
+				(*density)[i] = texels[i * header.channels];
+		}
+	}
+
+	activateTexture(t);
+	t->width = header.width;
+	t->height = header.height;
+	t->depth = header.depth;
+
+	const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	const GLenum internal_formats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	GLenum format = formats[header.channels - 1];
+
+	glCreateTextures(GL_TEXTURE_3D, 1, &t->id);
+	glTextureStorage3D(t->id, (GLsizei)header.levels, internal_formats[header.channels - 1], header.width, header.height, header.depth);
+
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	offset = sizeof(Header);
+	w = header.width, h = header.height, d = header.depth;
+	for (uint32_t level = 0; level < header.levels; level++) {
+		glTextureSubImage3D(t->id, level, 0, 0, 0, w, h, d, format, GL_UNSIGNED_BYTE, file.data + offset);
+		offset += (size_t)w * h * d * header.channels;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+		d = d > 1 ? d / 2 : 1;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+	// Put the stored channels back where the shaders expect them, channels that were dropped read as 0
+	const GLenum sources[] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+	GLint swizzle[4] = { GL_ZERO, GL_ZERO, GL_ZERO, GL_ONE };
+	for (uint32_t c = 0; c < header.channels; c++) {
+		if (header.channel_map[c] < 4)
+			swizzle[header.channel_map[c]] = sources[c];
+	}
+	glTextureParameteriv(t->id, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+	glTextureParameteri(t->id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(t->id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(t->id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(t->id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(t->id, GL_TEXTURE_WRAP_R, GL_REPEAT);
+
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#define _CRT_SECURE_NO_DEPRECATE
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Texture.h"
+#include <stdint.h>
+#include <vector>
+
+/*
+Binary file format for the 3D cloud noise, written once from the EX5 text files and memory mapped on load, so the
+volume and its whole mip chain go straight from the file to glTexImage3D.
+
+	header (64 bytes) | level 0 | level 1 | ... | 1x1x1 level
+
+Only the channels the cloud shader samples are stored (red, blue and alpha of the noise). The header keeps which
+source channel each stored channel came from, and the texture swizzle puts them back in place, so the shaders
+sample the volume exactly as they did the RGBA version.
+*/
+class CloudVolume
+{
+public:
+	struct Header {
+		char magic[4];
+		uint32_t width, height, depth;
+		uint32_t channels, levels;
+		unsigned char channel_map[4];	// Source channel (0-3) of every stored channel
+		uint32_t padding;
+		uint64_t source_size, source_time;	// Size and modification time of the EX5 file it was converted from
+		uint64_t generator_hash;	// Hash of the CloudNoise settings it was generated with
+		uint64_t reserved;
+	};
+	/* Parse an EX5 text file into RGBA8 texels. The numbers are parsed in parallel */
+	static bool parseEX5(const char * path, int & width, int & height, int & depth, std::vector<unsigned char> & rgba);
+	/* Write an RGBA8 volume with its mip chain. The source fields of the header are taken from the given one */
+	static bool write(const char * volume_path, const unsigned char * rgba, int width, int height, int depth, const Header & source);
+	/* Read the header of a volume file. Returns false if it is missing or not a volume file */
+	static bool readHeader(const char * volume_path, Header & header);
+	/* Convert an EX5 text file to a binary volume file. Returns false on failure */
+	static bool convert(const char * ex5_path, const char * volume_path);
+	/* Returns whether a volume file exists and was converted from the current version of an EX5 file */
+	static bool upToDate(const char * ex5_path, const char * volume_path);
+	/* Read level 0 of a volume file back into RGBA8 texels, channels that were not stored are 0. Returns false on failure */
+	static bool readTexels(const char * volume_path, int & width, int & height, int & depth, std::vector<unsigned char> & rgba);
+	/* Load a binary volume file into a 3D texture with all mipmaps. Optionally copies the red channel of level 0 to density. Returns false on failure */
+	static bool load(Texture * t, const char * volume_path, std::vector<unsigned char> * density = nullptr);
+};
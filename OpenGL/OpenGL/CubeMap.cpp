@@ -1,4 +1,5 @@
 #include "CubeMap.h"
+#include "GLState.h"
 
 CubeMap::CubeMap()
 {
@@ -6,45 +7,52 @@ CubeMap::CubeMap()
 
 CubeMap::~CubeMap()
 {
-	glDeleteVertexArrays(1, &VAO);
+	GLState::deleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
 }
 
 void CubeMap::storeOnGPU() {
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(VERTICES), &VERTICES, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glCreateVertexArrays(1, &VAO);
+	glCreateBuffers(1, &VBO);
+	glNamedBufferStorage(VBO, sizeof(VERTICES), &VERTICES, 0);
+	glVertexArrayVertexBuffer(VAO, 0, VBO, 0, 3 * sizeof(float));
+	glEnableVertexArrayAttrib(VAO, 0);
+	glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, 0);
+	glVertexArrayAttribBinding(VAO, 0, 0);
 }
 
 void CubeMap::loadCubemapTexture(std::vector<std::string> faces)
 {
-	glGenTextures(1, &texture_id);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
+	glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &texture_id);
 
+	// The storage is made for the size of the first face, the faces are its layers
 	int width, height, nrChannels;
+	int face_width = 0, face_height = 0;
 	for (unsigned int i = 0; i < faces.size(); i++)
 	{
-		unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-		if (data)
+		unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 3);
+		if (data && face_width == 0)
 		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+			face_width = width;
+			face_height = height;
+			glTextureStorage2D(texture_id, 1, GL_RGB8, width, height);
+		}
+		if (data && width == face_width && height == face_height)
+		{
+			glTextureSubImage3D(texture_id, 0, 0, 0, i, width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, data);
 			stbi_image_free(data);
 		}
 		else
 		{
-			printf("Cubemap texture failed to load at path: %s", faces[i]);
+			printf("Cubemap texture failed to load at path: %s\n", faces[i].c_str());
 			stbi_image_free(data);
 		}
 	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture_id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(texture_id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(texture_id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture_id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture_id, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 }
 
 void CubeMap::loadCubemapTexture(const std::string right, const std::string left, const std::string top, const std::string bottom, const std::string front, const std::string back)
@@ -53,23 +61,20 @@ void CubeMap::loadCubemapTexture(const std::string right, const std::string left
 	loadCubemapTexture(faces);
 }
 
-void CubeMap::drawCubemap(Shader * shader, Camera * camera, mat4 projection) {
+void CubeMap::drawCubemap(Shader * shader) {
 	// Change depth function so depth test passes when values are equal to depth buffer's content
-	glDepthFunc(GL_LEQUAL);  
+	GLState::depthFunc(GL_LEQUAL);  
 	
+	// The view without translation comes from the camera block
 	shader->use();
-
-	// Remove translation from the view matrix
-	shader->setMat4("view", mat4::removeTranslation(camera->GetViewMatrix()));
-	shader->setMat4("projection", projection);
 	
 	// Render skybox cube
-	glBindVertexArray(VAO);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
+	GLState::bindVertexArray(VAO);
+	GLState::activeTexture(GL_TEXTURE0);
+	GLState::bindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
 	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 
 	// Set depth function back to default
-	glDepthFunc(GL_LESS); 
+	GLState::depthFunc(GL_LESS); 
 }
@@ -68,5 +68,5 @@ public:
 	/* Load cubemap texture and attach it. You must provide 6 filepaths as Strings */
 	void loadCubemapTexture(const std::string right, const std::string left, const std::string top, const std::string bottom, const std::string front, const std::string back);
 	/* Draws the cubemap from vertex data stored on the GPU */
-	void drawCubemap(Shader * shader, Camera * camera, mat4 projection);
+	void drawCubemap(Shader * shader);
 };
\ No newline at end of file
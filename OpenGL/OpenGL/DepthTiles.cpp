@@ -0,0 +1,59 @@
+#include "DepthTiles.h"
+#include "GLState.h"
+
+// Work group size of depth_tiles_comp.shader along x and y, one tile per invocation
+#define TILES_GROUP_SIZE 8
+
+bool DepthTiles::init(int depth_width, int depth_height)
+{
+	if (!GLEW_VERSION_4_3 && !GLEW_ARB_compute_shader)
+		return false;
+	if (shader.initCompute("shaders/depth_tiles_comp.shader") != 0) {
+		printf("Error: Failed to initialize shader in %s at line %d.\n\n", __FILE__, __LINE__);
+		return false;
+	}
+
+	shader.use();
+	shader.setInt("depth_buffer", 0);
+	shader.setInt("tile_size", TILE_SIZE);
+
+	supported = true;
+	resize(depth_width, depth_height);
+	return true;
+}
+
+void DepthTiles::resize(int depth_width, int depth_height)
+{
+	if (!supported)
+		return;
+
+	// The texture has immutable storage, so a new size needs a new texture
+	if (texture != 0)
+		GLState::deleteTextures(1, &texture);
+	width = (depth_width + TILE_SIZE - 1) / TILE_SIZE;
+	height = (depth_height + TILE_SIZE - 1) / TILE_SIZE;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, 1, GL_RG32F, width, height);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void DepthTiles::reduce(unsigned int depth_texture)
+{
+	if (!supported)
+		return;
+
+	shader.use();
+	GLState::activeTexture(GL_TEXTURE0);
+	GLState::bindTexture(GL_TEXTURE_2D, depth_texture);
+	glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+	glDispatchCompute((width + TILES_GROUP_SIZE - 1) / TILES_GROUP_SIZE, (height + TILES_GROUP_SIZE - 1) / TILES_GROUP_SIZE, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+bool DepthTiles::ready() const
+{
+	return supported;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Shader.h"
+
+/*
+Smallest and largest scene depth of every 16x16 pixel tile of a depth buffer, built by a compute shader. The clouds
+use it to skip tiles that only have sky (no depth to read) or only near geometry (no clouds to march) as a whole.
+*/
+class DepthTiles
+{
+public:
+	static const int TILE_SIZE = 16;
+	unsigned int texture = 0;
+	int width = 0, height = 0;
+	/* Create the tile texture for a depth buffer of the given size. Returns false when compute shaders are not available */
+	bool init(int depth_width, int depth_height);
+	/* Create the tile texture again for a new depth buffer size */
+	void resize(int depth_width, int depth_height);
+	/* Reduce a depth texture into the tiles */
+	void reduce(unsigned int depth_texture);
+	/* Returns whether the tiles can be used */
+	bool ready() const;
+private:
+	Shader shader;
+	bool supported = false;
+};
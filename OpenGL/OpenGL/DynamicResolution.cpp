@@ -0,0 +1,117 @@
+#include "DynamicResolution.h"
+#include <math.h>
+#include <algorithm>
+
+// Frames to wait after a change before the average is trusted again
+#define COOLDOWN_FRAMES 30
+// Frames measured before the scale may change
+#define MIN_SAMPLES 8
+// Weight of a new frame in the average time
+#define AVERAGE_WEIGHT 0.1f
+// Part of the target the next step up has to stay under
+#define HEADROOM 0.9f
+
+bool DynamicResolution::init(float target_ms, float min_scale, float max_scale, float step)
+{
+	target = target_ms;
+	this->min_scale = min_scale;
+	this->max_scale = max_scale;
+	this->step = step;
+	render_scale = max_scale;
+
+	if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query)
+		return false;
+	glGenQueries(QUERIES, queries);
+	supported = true;
+	return true;
+}
+
+void DynamicResolution::beginFrame()
+{
+	if (!supported)
+		return;
+
+	// The oldest query is reused, it is read before if the GPU got to it
+	if (pending[current]) {
+		GLint available = 0;
+		glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			// Should not happen with a few frames in flight, skip measuring this frame instead of waiting
+			measuring = false;
+			return;
+		}
+	}
+	glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+	measuring = true;
+}
+
+bool DynamicResolution::endFrame()
+{
+	if (!supported)
+		return false;
+
+	if (measuring) {
+		glEndQuery(GL_TIME_ELAPSED);
+		pending[current] = true;
+		current = (current + 1) % QUERIES;
+		measuring = false;
+	}
+
+	// Average every frame the GPU has finished
+	bool changed = false;
+	for (int i = 0; i < QUERIES; i++) {
+		if (!pending[i]) continue;
+		GLint available = 0;
+		glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) continue;
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+		pending[i] = false;
+
+		// Frames still in flight when the scale changed are left out
+		if (cooldown > 0) {
+			cooldown--;
+			continue;
+		}
+		float milliseconds = nanoseconds / 1e6f;
+		average = samples == 0 ? milliseconds : average + (milliseconds - average) * AVERAGE_WEIGHT;
+		if (++samples >= MIN_SAMPLES)
+			changed |= adjust();
+	}
+
+	return changed;
+}
+
+bool DynamicResolution::adjust()
+{
+	// The GPU time mostly follows the pixel count, the square of the scale
+	float scale = render_scale;
+	if (average > target) {
+		float wanted = render_scale * sqrtf(target / average);
+		scale = render_scale - std::max(ceilf((render_scale - wanted) / step), 1.0f) * step;
+	}
+	else {
+		float next = render_scale + step;
+		if (average * (next * next) / (render_scale * render_scale) < target * HEADROOM)
+			scale = next;
+	}
+	scale = std::min(std::max(scale, min_scale), max_scale);
+	if (scale == render_scale)
+		return false;
+
+	render_scale = scale;
+	samples = 0;
+	cooldown = COOLDOWN_FRAMES;
+	return true;
+}
+
+float DynamicResolution::scale() const
+{
+	return render_scale;
+}
+
+float DynamicResolution::gpuTime() const
+{
+	return average;
+}
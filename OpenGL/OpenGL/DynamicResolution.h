@@ -0,0 +1,36 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+/*
+Render scale that follows the GPU time of the frames, to hold a target frame time on a fixed GPU.
+
+The GPU time of every frame is measured with a timer query. The results are read a few frames later so the CPU never
+waits for the GPU. When the average time goes over the target the scale drops, by as many steps as the pixel count
+says are needed. It goes up one step at a time, only when the next step is expected to stay under the target. After a
+change it waits a while, so the frames still in flight at the old scale are not counted.
+*/
+class DynamicResolution
+{
+public:
+	/* Create the timer queries. The scale moves in steps between min_scale and max_scale. Returns false without timer queries */
+	bool init(float target_ms, float min_scale, float max_scale, float step);
+	/* Start measuring the GPU work of a frame */
+	void beginFrame();
+	/* Stop measuring, read the finished frames and adjust the scale. Returns whether the scale changed */
+	bool endFrame();
+	/* Returns the render scale of the next frame */
+	float scale() const;
+	/* Returns the average GPU time of a frame in milliseconds */
+	float gpuTime() const;
+private:
+	static const int QUERIES = 4;
+	unsigned int queries[QUERIES] = { 0, 0, 0, 0 };
+	bool pending[QUERIES] = { false, false, false, false };
+	int current = 0, cooldown = 0, samples = 0;
+	float target = 16.0f, min_scale = 1.0f, max_scale = 1.0f, step = 0.125f;
+	float render_scale = 1.0f, average = 0.0f;
+	bool supported = false, measuring = false;
+	/* Move the scale with the average time. Returns whether it changed */
+	bool adjust();
+};
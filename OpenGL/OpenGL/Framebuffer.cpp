@@ -1,4 +1,5 @@
 #include "Framebuffer.h"
+#include "GLState.h"
 
 Framebuffer::Framebuffer()
 {
@@ -6,90 +7,39 @@ Framebuffer::Framebuffer()
 
 Framebuffer::~Framebuffer()
 {
-	glDeleteFramebuffers(1, &fbo);
-}
-
-// This method will create a framebuffer for the scene to be rendered in. Will use 2 colorbuffers, one for the normal scene
-// and one for the extracted brightness scene
-void Framebuffer::createSceneFramebuffer(unsigned int &width, unsigned int &height) {
-	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-	glGenTextures(2, colorBuffer);
-
-	for (unsigned int i = 0; i < 2; i++)
-	{
-		glBindTexture(GL_TEXTURE_2D, colorBuffer[i]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffer[i], 0);
+	GLState::deleteFramebuffers(1, &fbo);
+}
+
+// Framebuffer over textures owned by someone else (the render graph), so it does not delete them
+void Framebuffer::createFromTextures(const std::vector<unsigned int> & colors, unsigned int depth) {
+	glCreateFramebuffers(1, &fbo);
+
+	std::vector<GLenum> attachments;
+	for (GLuint i = 0; i < colors.size(); i++) {
+		if (colors[i] != 0) {
+			glNamedFramebufferTexture(fbo, GL_COLOR_ATTACHMENT0 + i, colors[i], 0);
+			attachments.push_back(GL_COLOR_ATTACHMENT0 + i);
+		}
+		else {
+			attachments.push_back(GL_NONE);
+		}
 	}
+	if (depth != 0)
+		glNamedFramebufferTexture(fbo, GL_DEPTH_ATTACHMENT, depth, 0);
 
-	// Creating and attaching the depth buffer (render buffer)
-	glGenRenderbuffers(1, &rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-	// Telling OpenGL which color attachments we'll use for rendering 
-	unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-	glDrawBuffers(2, attachments);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		std::cout << "Error: Scene Framebuffer not created!" << std::endl;
-	}
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
-
-void Framebuffer::createCloudFramebuffer(unsigned int &width, unsigned int &height) {
-	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-	glGenTextures(2, colorBuffer);
-	for (GLuint i = 0; i < 2; i++) {
-		glBindTexture(GL_TEXTURE_2D, colorBuffer[i]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffer[i], 0);
-	}
-
-	// tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
-	GLuint cloud_attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-	glDrawBuffers(2, cloud_attachments);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		std::cout << "Error: Cloud Framebuffer not created!" << std::endl;
-	}
-}
+	// Telling OpenGL which color attachments we'll use for rendering
+	if (attachments.empty())
+		glNamedFramebufferDrawBuffer(fbo, GL_NONE);
+	else
+		glNamedFramebufferDrawBuffers(fbo, (GLsizei)attachments.size(), attachments.data());
 
-void Framebuffer::createPingPongFramebuffer(Framebuffer framebuffer[2], unsigned int &width, unsigned int &height) {
-	for (unsigned int i = 0; i < 2; i++)
-	{
-		glGenFramebuffers(2, &framebuffer[i].fbo);
-		glGenTextures(1, &framebuffer[i].colorBuffer[0]);
-		framebuffer[i].bind();
-		glBindTexture(GL_TEXTURE_2D, framebuffer[i].colorBuffer[0]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, framebuffer[i].colorBuffer[0], 0);
-		// also check if framebuffers are complete (no need for depth buffer)
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-			std::cout << "Error: Cloud Framebuffer not created!" << std::endl;
+	if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "Error: Framebuffer not created!" << std::endl;
 	}
 }
 
 void Framebuffer::bind() {
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, fbo);
 }
 
 void Framebuffer::bindRBO() {
@@ -97,9 +47,9 @@ void Framebuffer::bindRBO() {
 }
 
 void Framebuffer::unbind() {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Framebuffer::remove() {
-	glDeleteFramebuffers(1, &fbo);
+	GLState::deleteFramebuffers(1, &fbo);
 }
\ No newline at end of file
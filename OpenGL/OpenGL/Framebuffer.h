@@ -7,17 +7,13 @@
 class Framebuffer
 {
 public:
-	unsigned int fbo, rbo, colorBuffer[2];
+	unsigned int fbo = 0, rbo;
 	/* Default constructor */
 	Framebuffer();
 	/* De-constructor */
 	~Framebuffer();
-	/* Create 2 floating point color buffers (1 for normal rendering, other for brightness treshold values) */
-	void createSceneFramebuffer(unsigned int & width, unsigned int & height);
-	/* Create cloud framebuffer with 2 color buffers */
-	void createCloudFramebuffer(unsigned int & width, unsigned int & height);
-	/* Create two ping-pong-framebuffers for blurring */
-	static void createPingPongFramebuffer(Framebuffer framebuffer[2], unsigned int & width, unsigned int & height);
+	/* Create a framebuffer from existing textures. Color buffer i goes to attachment i (left out when 0), and depth to the depth attachment when it is not 0 */
+	void createFromTextures(const std::vector<unsigned int> & colors, unsigned int depth);
 	/* Bind this framebuffer */
 	void bind();
 	void bindRBO();
@@ -0,0 +1,280 @@
+#include "GLState.h"
+#include <string.h>
+
+// Texture units and targets that are cached, binds outside of them always go to GL
+#define CACHED_UNITS 32
+static const GLenum CACHED_TARGETS[] = { GL_TEXTURE_1D, GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY };
+#define TARGETS (sizeof(CACHED_TARGETS) / sizeof(CACHED_TARGETS[0]))
+static const GLenum CACHED_CAPABILITIES[] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST, GL_FRAMEBUFFER_SRGB };
+#define CAPABILITIES (sizeof(CACHED_CAPABILITIES) / sizeof(CACHED_CAPABILITIES[0]))
+// Names are never ~0, so it stands for a binding that is not known
+#define UNKNOWN 0xFFFFFFFFu
+
+struct State {
+	GLuint program, vertex_array, draw_framebuffer, read_framebuffer;
+	GLenum active_unit;
+	GLuint textures[CACHED_UNITS][TARGETS];
+	int capabilities[CAPABILITIES];	// -1 when not known
+	GLenum blend_source, blend_destination, depth_function;
+	GLint viewport[4];
+	bool viewport_known;
+};
+
+static State state;
+static GLState::Counters counters, last_counters;
+static bool initialized = false;
+
+static State & current()
+{
+	if (!initialized) {
+		GLState::invalidate();
+		initialized = true;
+	}
+	return state;
+}
+
+static int targetIndex(GLenum target)
+{
+	for (int i = 0; i < (int)TARGETS; i++)
+		if (CACHED_TARGETS[i] == target) return i;
+	return -1;
+}
+
+static int capabilityIndex(GLenum capability)
+{
+	for (int i = 0; i < (int)CAPABILITIES; i++)
+		if (CACHED_CAPABILITIES[i] == capability) return i;
+	return -1;
+}
+
+/* Count a call, returns whether it has to go to GL */
+static bool issue(GLState::Kind kind, bool changed)
+{
+	if (changed)
+		counters.issued[kind]++;
+	else
+		counters.elided[kind]++;
+	return changed;
+}
+
+unsigned int GLState::Counters::totalIssued() const
+{
+	unsigned int total = 0;
+	for (int i = 0; i < KINDS; i++) total += issued[i];
+	return total;
+}
+
+unsigned int GLState::Counters::totalElided() const
+{
+	unsigned int total = 0;
+	for (int i = 0; i < KINDS; i++) total += elided[i];
+	return total;
+}
+
+void GLState::useProgram(GLuint program)
+{
+	State & s = current();
+	if (issue(PROGRAM, s.program != program)) {
+		glUseProgram(program);
+		s.program = program;
+	}
+}
+
+void GLState::bindVertexArray(GLuint vertex_array)
+{
+	State & s = current();
+	if (issue(VERTEX_ARRAY, s.vertex_array != vertex_array)) {
+		glBindVertexArray(vertex_array);
+		s.vertex_array = vertex_array;
+	}
+}
+
+void GLState::activeTexture(GLenum unit)
+{
+	State & s = current();
+	if (issue(TEXTURE, s.active_unit != unit)) {
+		glActiveTexture(unit);
+		s.active_unit = unit;
+	}
+}
+
+void GLState::bindTexture(GLenum target, GLuint texture)
+{
+	State & s = current();
+	int unit = s.active_unit == UNKNOWN ? -1 : (int)(s.active_unit - GL_TEXTURE0);
+	int index = targetIndex(target);
+	if (unit < 0 || unit >= CACHED_UNITS || index < 0) {
+		issue(TEXTURE, true);
+		glBindTexture(target, texture);
+		return;
+	}
+	if (issue(TEXTURE, s.textures[unit][index] != texture)) {
+		glBindTexture(target, texture);
+		s.textures[unit][index] = texture;
+	}
+}
+
+void GLState::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	State & s = current();
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	bool changed = (draw && s.draw_framebuffer != framebuffer) || (read && s.read_framebuffer != framebuffer);
+	if (issue(FRAMEBUFFER, changed)) {
+		glBindFramebuffer(target, framebuffer);
+		if (draw) s.draw_framebuffer = framebuffer;
+		if (read) s.read_framebuffer = framebuffer;
+	}
+}
+
+static void setCapability(GLenum capability, bool enabled)
+{
+	State & s = current();
+	int index = capabilityIndex(capability);
+	if (issue(GLState::CAPABILITY, index < 0 || s.capabilities[index] != (int)enabled)) {
+		if (enabled)
+			glEnable(capability);
+		else
+			glDisable(capability);
+		if (index >= 0) s.capabilities[index] = enabled;
+	}
+}
+
+void GLState::enable(GLenum capability)
+{
+	setCapability(capability, true);
+}
+
+void GLState::disable(GLenum capability)
+{
+	setCapability(capability, false);
+}
+
+void GLState::blendFunc(GLenum source, GLenum destination)
+{
+	State & s = current();
+	if (issue(CAPABILITY, s.blend_source != source || s.blend_destination != destination)) {
+		glBlendFunc(source, destination);
+		s.blend_source = source;
+		s.blend_destination = destination;
+	}
+}
+
+void GLState::depthFunc(GLenum function)
+{
+	State & s = current();
+	if (issue(CAPABILITY, s.depth_function != function)) {
+		glDepthFunc(function);
+		s.depth_function = function;
+	}
+}
+
+void GLState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	State & s = current();
+	bool changed = !s.viewport_known || s.viewport[0] != x || s.viewport[1] != y || s.viewport[2] != width || s.viewport[3] != height;
+	if (issue(VIEWPORT, changed)) {
+		glViewport(x, y, width, height);
+		s.viewport[0] = x;
+		s.viewport[1] = y;
+		s.viewport[2] = width;
+		s.viewport[3] = height;
+		s.viewport_known = true;
+	}
+}
+
+bool GLState::isEnabled(GLenum capability)
+{
+	State & s = current();
+	int index = capabilityIndex(capability);
+	if (index < 0)
+		return glIsEnabled(capability) == GL_TRUE;
+	if (s.capabilities[index] < 0)
+		s.capabilities[index] = glIsEnabled(capability) == GL_TRUE;
+	return s.capabilities[index] != 0;
+}
+
+void GLState::getBlendFunc(GLenum * source, GLenum * destination)
+{
+	State & s = current();
+	if (s.blend_source == UNKNOWN || s.blend_destination == UNKNOWN) {
+		GLint value;
+		glGetIntegerv(GL_BLEND_SRC_RGB, &value);
+		s.blend_source = (GLenum)value;
+		glGetIntegerv(GL_BLEND_DST_RGB, &value);
+		s.blend_destination = (GLenum)value;
+	}
+	*source = s.blend_source;
+	*destination = s.blend_destination;
+}
+
+void GLState::getViewport(GLint * viewport)
+{
+	State & s = current();
+	if (!s.viewport_known) {
+		glGetIntegerv(GL_VIEWPORT, s.viewport);
+		s.viewport_known = true;
+	}
+	memcpy(viewport, s.viewport, sizeof(s.viewport));
+}
+
+void GLState::deleteProgram(GLuint program)
+{
+	State & s = current();
+	// The program in use lives on until another one is used, the next use always goes to GL
+	glDeleteProgram(program);
+	if (s.program == program) s.program = UNKNOWN;
+}
+
+void GLState::deleteVertexArrays(GLsizei count, const GLuint * vertex_arrays)
+{
+	State & s = current();
+	glDeleteVertexArrays(count, vertex_arrays);
+	for (GLsizei i = 0; i < count; i++)
+		if (s.vertex_array == vertex_arrays[i]) s.vertex_array = 0;
+}
+
+void GLState::deleteTextures(GLsizei count, const GLuint * textures)
+{
+	State & s = current();
+	glDeleteTextures(count, textures);
+	for (GLsizei i = 0; i < count; i++)
+		for (int unit = 0; unit < CACHED_UNITS; unit++)
+			for (int target = 0; target < (int)TARGETS; target++)
+				if (s.textures[unit][target] == textures[i]) s.textures[unit][target] = 0;
+}
+
+void GLState::deleteFramebuffers(GLsizei count, const GLuint * framebuffers)
+{
+	State & s = current();
+	glDeleteFramebuffers(count, framebuffers);
+	for (GLsizei i = 0; i < count; i++) {
+		if (s.draw_framebuffer == framebuffers[i]) s.draw_framebuffer = 0;
+		if (s.read_framebuffer == framebuffers[i]) s.read_framebuffer = 0;
+	}
+}
+
+void GLState::invalidate()
+{
+	state.program = state.vertex_array = state.draw_framebuffer = state.read_framebuffer = UNKNOWN;
+	state.active_unit = UNKNOWN;
+	for (int unit = 0; unit < CACHED_UNITS; unit++)
+		for (int target = 0; target < (int)TARGETS; target++)
+			state.textures[unit][target] = UNKNOWN;
+	for (int i = 0; i < (int)CAPABILITIES; i++)
+		state.capabilities[i] = -1;
+	state.blend_source = state.blend_destination = state.depth_function = UNKNOWN;
+	state.viewport_known = false;
+	initialized = true;
+}
+
+void GLState::endFrame()
+{
+	last_counters = counters;
+	memset(&counters, 0, sizeof(counters));
+}
+
+const GLState::Counters & GLState::lastFrame()
+{
+	return last_counters;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+/*
+Cache of the GL state that is changed the most, in front of the GL calls that change it: the program, the vertex
+array, the textures bound to every unit, the framebuffers, the blend and depth state and the viewport. A call that sets
+what is already set is skipped. All code changes this state through here, so the cache stays right, and objects are
+deleted through here so a name that GL gives out again is not taken as still bound.
+
+Every frame counts the calls that went to GL and the ones that were skipped, by kind.
+*/
+class GLState
+{
+public:
+	enum Kind { PROGRAM, VERTEX_ARRAY, TEXTURE, FRAMEBUFFER, CAPABILITY, VIEWPORT, KINDS };
+	struct Counters {
+		unsigned int issued[KINDS];
+		unsigned int elided[KINDS];
+		/* Returns the calls of all kinds */
+		unsigned int totalIssued() const;
+		unsigned int totalElided() const;
+	};
+	static void useProgram(GLuint program);
+	static void bindVertexArray(GLuint vertex_array);
+	static void activeTexture(GLenum unit);
+	/* Bind a texture to the active unit */
+	static void bindTexture(GLenum target, GLuint texture);
+	static void bindFramebuffer(GLenum target, GLuint framebuffer);
+	static void enable(GLenum capability);
+	static void disable(GLenum capability);
+	static void blendFunc(GLenum source, GLenum destination);
+	static void depthFunc(GLenum function);
+	static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	/* Returns the cached state, asking GL only the first time */
+	static bool isEnabled(GLenum capability);
+	static void getBlendFunc(GLenum * source, GLenum * destination);
+	static void getViewport(GLint * viewport);
+	/* Delete objects and forget where they were bound */
+	static void deleteProgram(GLuint program);
+	static void deleteVertexArrays(GLsizei count, const GLuint * vertex_arrays);
+	static void deleteTextures(GLsizei count, const GLuint * textures);
+	static void deleteFramebuffers(GLsizei count, const GLuint * framebuffers);
+	/* Forget everything, for when GL state was changed behind the cache */
+	static void invalidate();
+	/* Start counting a new frame. The counts of the frame that ended are kept in lastFrame() */
+	static void endFrame();
+	static const Counters & lastFrame();
+};
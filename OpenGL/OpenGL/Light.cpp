@@ -55,72 +55,58 @@ bool Light::isEnabled() {
 	return enabled;
 }
 
-bool Light::drawLight(const Shader * shader)
+bool Light::drawLight(LightBuffer * buffer)
 {
-	if (shader == nullptr)
+	if (buffer == nullptr)
 		return false;
 
-	if (is(DIRECTIONAL) && enabled)
+	// A disabled light keeps its place in the arrays, without color
+	if (is(DIRECTIONAL))
 	{
-		shader->setVec3("directionalLights[" + std::to_string(id) + "].direction", direction);
-		shader->setVec3("directionalLights[" + std::to_string(id) + "].ambient", vec3::scale(color, ambient));
-		shader->setVec3("directionalLights[" + std::to_string(id) + "].diffuse", vec3::scale(color, diffuse));
-		shader->setVec3("directionalLights[" + std::to_string(id) + "].specular", vec3::scale(color, specular));
-		return true;
-	}
-	else if (is(DIRECTIONAL) && !enabled)
-	{
-		shader->setVec3("directionalLights[" + std::to_string(id) + "].ambient", DISABLED);
-		shader->setVec3("directionalLights[" + std::to_string(id) + "].diffuse", DISABLED);
-		shader->setVec3("directionalLights[" + std::to_string(id) + "].specular", DISABLED);
-		return true;
-	}
-	else if (is(POINT) && enabled)
-	{
-		shader->setVec3("pointLights[" + std::to_string(id) + "].position", position);
-		shader->setVec3("pointLights[" + std::to_string(id) + "].ambient", vec3::scale(color, ambient));
-		shader->setVec3("pointLights[" + std::to_string(id) + "].diffuse", vec3::scale(color, diffuse));
-		shader->setVec3("pointLights[" + std::to_string(id) + "].specular", vec3::scale(color, specular));
-		shader->setFloat("pointLights[" + std::to_string(id) + "].constant", constant);
-		shader->setFloat("pointLights[" + std::to_string(id) + "].linear", linear);
-		shader->setFloat("pointLights[" + std::to_string(id) + "].quadratic", quadratic);
+		if (enabled)
+			buffer->setDirectional(id, direction, vec3::scale(color, ambient), vec3::scale(color, diffuse), vec3::scale(color, specular));
+		else
+			buffer->setDirectional(id, direction, DISABLED, DISABLED, DISABLED);
 		return true;
 	}
-	else if (is(POINT) && !enabled)
+	else if (is(POINT))
 	{
-		shader->setVec3("pointLights[" + std::to_string(id) + "].ambient", DISABLED);
-		shader->setVec3("pointLights[" + std::to_string(id) + "].diffuse", DISABLED);
-		shader->setVec3("pointLights[" + std::to_string(id) + "].specular", DISABLED);
+		if (enabled)
+			buffer->setPoint(id, position, vec3::scale(color, ambient), vec3::scale(color, diffuse), vec3::scale(color, specular), constant, linear, quadratic);
+		else
+			buffer->setPoint(id, position, DISABLED, DISABLED, DISABLED, constant, linear, quadratic);
 		return true;
 	}
-	else if (is(SPOT) && enabled)
+	else if (is(SPOT))
 	{
-		if (camera != nullptr)
-		{
-			shader->setVec3("spotLights[" + std::to_string(id) + "].position", camera->Position);
-			shader->setVec3("spotLights[" + std::to_string(id) + "].direction", camera->Front);
-		}
+		vec3 spot_position = camera != nullptr ? camera->Position : position;
+		vec3 spot_direction = camera != nullptr ? camera->Front : direction;
+		float cos_cut_off = glm::cos(glm::radians(cutOff));
+		float cos_outer_cut_off = glm::cos(glm::radians(outerCutOff));
+		if (enabled)
+			buffer->setSpot(id, spot_position, spot_direction, vec3(ambient), vec3(diffuse), vec3(specular), constant, linear, quadratic, cos_cut_off, cos_outer_cut_off);
 		else
-		{
-			shader->setVec3("spotLights[" + std::to_string(id) + "].position", position);
-			shader->setVec3("spotLights[" + std::to_string(id) + "].direction", direction);
-		}
-		shader->setVec3("spotLights[" + std::to_string(id) + "].ambient", ambient);
-		shader->setVec3("spotLights[" + std::to_string(id) + "].diffuse", diffuse);
-		shader->setVec3("spotLights[" + std::to_string(id) + "].specular", specular);
-		shader->setFloat("spotLights[" + std::to_string(id) + "].constant", constant);
-		shader->setFloat("spotLights[" + std::to_string(id) + "].linear", linear);
-		shader->setFloat("spotLights[" + std::to_string(id) + "].quadratic", quadratic);
-		shader->setFloat("spotLights[" + std::to_string(id) + "].cutOff", glm::cos(glm::radians(cutOff)));
-		shader->setFloat("spotLights[" + std::to_string(id) + "].outerCutOff", glm::cos(glm::radians(outerCutOff)));
+			buffer->setSpot(id, spot_position, spot_direction, DISABLED, DISABLED, DISABLED, constant, linear, quadratic, cos_cut_off, cos_outer_cut_off);
 		return true;
 	}
-	else if (is(SPOT) && !enabled)
+	return false;
+}
+
+bool Light::drawLight(LightClusters * clusters)
+{
+	// Directional lights reach every cluster, they are only in the light buffer
+	if (clusters == nullptr || !enabled)
+		return false;
+
+	if (is(POINT))
+		return clusters->addPoint(position, vec3::scale(color, ambient), vec3::scale(color, diffuse), vec3::scale(color, specular), constant, linear, quadratic);
+	else if (is(SPOT))
 	{
-		shader->setVec3("spotLights[" + std::to_string(id) + "].ambient", DISABLED);
-		shader->setVec3("spotLights[" + std::to_string(id) + "].diffuse", DISABLED);
-		shader->setVec3("spotLights[" + std::to_string(id) + "].specular", DISABLED);
-		return true;
+		vec3 spot_position = camera != nullptr ? camera->Position : position;
+		vec3 spot_direction = camera != nullptr ? camera->Front : direction;
+		float cos_cut_off = glm::cos(glm::radians(cutOff));
+		float cos_outer_cut_off = glm::cos(glm::radians(outerCutOff));
+		return clusters->addSpot(spot_position, spot_direction, vec3(ambient), vec3(diffuse), vec3(specular), constant, linear, quadratic, cos_cut_off, cos_outer_cut_off);
 	}
 	return false;
 }
@@ -1,6 +1,8 @@
 #pragma once
 #include "maths.h"
 #include "Shader.h"
+#include "LightBuffer.h"
+#include "LightClusters.h"
 #include "Camera.h"
 #include "glm.hpp"
 #include <string>
@@ -38,8 +40,10 @@ public:
 	void disable();
 	/* Check if light is ON/enabled. */
 	bool isEnabled();
-	/* Draw light with shader (light shader) */
-	bool drawLight(const Shader * shader);
+	/* Store the light in the light buffer that every shader reads */
+	bool drawLight(LightBuffer * buffer);
+	/* Add a point or spot light to the clusters of this frame, directional and disabled lights are left out */
+	bool drawLight(LightClusters * clusters);
 	/* Get light type */
 	Type getType();
 	bool operator ==(const Light& right) const;
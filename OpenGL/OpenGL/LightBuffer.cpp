@@ -0,0 +1,130 @@
+#include "LightBuffer.h"
+#include <string.h>
+
+// Copy one element of a property array of the block
+#define COPY(property) memcpy(region->property[i], block.property[i], sizeof(block.property[i]))
+
+bool LightBuffer::init()
+{
+	// Every region starts out without any light
+	for (int region = 0; region < UniformBuffer::REGIONS; region++)
+		for (int array = 0; array < ARRAYS; array++)
+			dirty[region][array] = 0xFFFFFFFF;
+	return buffer.init(UniformBuffer::LIGHT_BINDING, sizeof(Block));
+}
+
+bool LightBuffer::store(float * property, float x, float y, float z, float w)
+{
+	float value[4] = { x, y, z, w };
+	if (memcmp(property, value, sizeof(value)) == 0)
+		return false;
+	memcpy(property, value, sizeof(value));
+	return true;
+}
+
+void LightBuffer::markDirty(Array array, unsigned int id)
+{
+	for (int region = 0; region < UniformBuffer::REGIONS; region++)
+		dirty[region][array] |= 1u << id;
+}
+
+void LightBuffer::setDirectional(unsigned int id, const vec3 & direction, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular)
+{
+	if (id >= MAX_LIGHTS)
+		return;
+	bool changed = store(block.directional_direction[id], direction.x, direction.y, direction.z);
+	changed |= store(block.directional_ambient[id], ambient.x, ambient.y, ambient.z);
+	changed |= store(block.directional_diffuse[id], diffuse.x, diffuse.y, diffuse.z);
+	changed |= store(block.directional_specular[id], specular.x, specular.y, specular.z);
+	if (changed)
+		markDirty(DIRECTIONAL, id);
+}
+
+void LightBuffer::setPoint(unsigned int id, const vec3 & position, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular, float constant, float linear, float quadratic)
+{
+	if (id >= MAX_LIGHTS)
+		return;
+	bool changed = store(block.point_position[id], position.x, position.y, position.z);
+	changed |= store(block.point_ambient[id], ambient.x, ambient.y, ambient.z);
+	changed |= store(block.point_diffuse[id], diffuse.x, diffuse.y, diffuse.z);
+	changed |= store(block.point_specular[id], specular.x, specular.y, specular.z);
+	changed |= store(block.point_attenuation[id], constant, linear, quadratic);
+	if (changed)
+		markDirty(POINT, id);
+}
+
+void LightBuffer::setSpot(unsigned int id, const vec3 & position, const vec3 & direction, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular, float constant, float linear, float quadratic, float cut_off, float outer_cut_off)
+{
+	if (id >= MAX_LIGHTS)
+		return;
+	bool changed = store(block.spot_position[id], position.x, position.y, position.z);
+	changed |= store(block.spot_direction[id], direction.x, direction.y, direction.z);
+	changed |= store(block.spot_ambient[id], ambient.x, ambient.y, ambient.z);
+	changed |= store(block.spot_diffuse[id], diffuse.x, diffuse.y, diffuse.z);
+	changed |= store(block.spot_specular[id], specular.x, specular.y, specular.z);
+	changed |= store(block.spot_attenuation[id], constant, linear, quadratic);
+	changed |= store(block.spot_cone[id], cut_off, outer_cut_off, 0.0f);
+	if (changed)
+		markDirty(SPOT, id);
+}
+
+void LightBuffer::setPosition(unsigned int index, const vec3 & position)
+{
+	if (index >= MAX_LIGHTS)
+		return;
+	if (store(block.light_positions[index], position.x, position.y, position.z))
+		markDirty(POSITION, index);
+}
+
+void LightBuffer::setCounts(int directional, int point, int spot, int positions)
+{
+	int counts[4] = { directional, point, spot, positions };
+	for (int i = 0; i < 4; i++)
+		counts[i] = counts[i] < 0 ? 0 : counts[i] > MAX_LIGHTS ? MAX_LIGHTS : counts[i];
+	if (memcmp(block.light_counts, counts, sizeof(counts)) == 0)
+		return;
+	memcpy(block.light_counts, counts, sizeof(counts));
+	markDirty(COUNTS, 0);
+}
+
+void LightBuffer::upload()
+{
+	Block * region = (Block *)buffer.beginWrite();
+	if (region == nullptr)
+		return;
+
+	uint32_t * changed = dirty[buffer.region()];
+	for (int i = 0; i < MAX_LIGHTS; i++) {
+		uint32_t bit = 1u << i;
+		if (changed[DIRECTIONAL] & bit) {
+			COPY(directional_direction);
+			COPY(directional_ambient);
+			COPY(directional_diffuse);
+			COPY(directional_specular);
+		}
+		if (changed[POINT] & bit) {
+			COPY(point_position);
+			COPY(point_ambient);
+			COPY(point_diffuse);
+			COPY(point_specular);
+			COPY(point_attenuation);
+		}
+		if (changed[SPOT] & bit) {
+			COPY(spot_position);
+			COPY(spot_direction);
+			COPY(spot_ambient);
+			COPY(spot_diffuse);
+			COPY(spot_specular);
+			COPY(spot_attenuation);
+			COPY(spot_cone);
+		}
+		if (changed[POSITION] & bit)
+			COPY(light_positions);
+	}
+	if (changed[COUNTS])
+		memcpy(region->light_counts, block.light_counts, sizeof(block.light_counts));
+
+	for (int array = 0; array < ARRAYS; array++)
+		changed[array] = 0;
+	buffer.endWrite();
+}
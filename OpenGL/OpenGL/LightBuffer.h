@@ -0,0 +1,59 @@
+#pragma once
+#include "UniformBuffer.h"
+#include <stdint.h>
+
+/*
+The lights of the scene in the Lights block that every program shares. The block is a structure of arrays, every
+property of a light type is its own array indexed by the id of the light.
+
+The properties are kept on the CPU. A light that changed is marked dirty for every region of the buffer, and upload()
+only copies the lights that the region it writes does not have yet.
+*/
+class LightBuffer
+{
+public:
+	static const int MAX_LIGHTS = 20;
+	/* Create the buffer. Returns false when it can not be mapped */
+	bool init();
+	/* Store the properties of a light of each type */
+	void setDirectional(unsigned int id, const vec3 & direction, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular);
+	void setPoint(unsigned int id, const vec3 & position, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular, float constant, float linear, float quadratic);
+	void setSpot(unsigned int id, const vec3 & position, const vec3 & direction, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular, float constant, float linear, float quadratic, float cut_off, float outer_cut_off);
+	/* Store the position of a light for normal mapping, index into all lights */
+	void setPosition(unsigned int index, const vec3 & position);
+	/* Store how many lights of every type the shaders loop over */
+	void setCounts(int directional, int point, int spot, int positions);
+	/* Copy what changed into the next region of the buffer and bind it */
+	void upload();
+private:
+	enum Array { DIRECTIONAL, POINT, SPOT, POSITION, COUNTS, ARRAYS };
+	/* Same layout as the Lights block, std140 */
+	struct Block {
+		float directional_direction[MAX_LIGHTS][4];
+		float directional_ambient[MAX_LIGHTS][4];
+		float directional_diffuse[MAX_LIGHTS][4];
+		float directional_specular[MAX_LIGHTS][4];
+		float point_position[MAX_LIGHTS][4];
+		float point_ambient[MAX_LIGHTS][4];
+		float point_diffuse[MAX_LIGHTS][4];
+		float point_specular[MAX_LIGHTS][4];
+		float point_attenuation[MAX_LIGHTS][4];	// Constant, linear, quadratic
+		float spot_position[MAX_LIGHTS][4];
+		float spot_direction[MAX_LIGHTS][4];
+		float spot_ambient[MAX_LIGHTS][4];
+		float spot_diffuse[MAX_LIGHTS][4];
+		float spot_specular[MAX_LIGHTS][4];
+		float spot_attenuation[MAX_LIGHTS][4];	// Constant, linear, quadratic
+		float spot_cone[MAX_LIGHTS][4];	// Cosines of the inner and outer cut off
+		float light_positions[MAX_LIGHTS][4];
+		int light_counts[4];	// Directional, point, spot and all lights
+	};
+	Block block = {};
+	/* For every region, a bit per light of every array that changed since the region was written */
+	uint32_t dirty[UniformBuffer::REGIONS][ARRAYS] = {};
+	UniformBuffer buffer;
+	/* Store a property, returns whether it changed */
+	static bool store(float * property, float x, float y, float z, float w = 0.0f);
+	/* Mark a light dirty in every region */
+	void markDirty(Array array, unsigned int id);
+};
@@ -0,0 +1,258 @@
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// Light that falls below this is left out of the clusters, about one step of an 8 bit color
+#define LIGHT_THRESHOLD (1.0f / 256.0f)
+
+#define STORE(property, v, w) property[0] = (v).x; property[1] = (v).y; property[2] = (v).z; property[3] = (w)
+
+bool LightClusters::init()
+{
+	remove();
+	if (!light_buffer.init(LIGHT_BINDING, sizeof(Record) * MAX_LIGHTS, GL_SHADER_STORAGE_BUFFER) ||
+		!cluster_buffer.init(CLUSTER_BINDING, sizeof(Header) + sizeof(uint32_t) * 2 * CLUSTERS, GL_SHADER_STORAGE_BUFFER) ||
+		!index_buffer.init(INDEX_BINDING, sizeof(uint32_t) * MAX_INDICES, GL_SHADER_STORAGE_BUFFER)) {
+		printf("Error: Failed to create the light cluster buffers\n");
+		remove();
+		return false;
+	}
+	records.reserve(MAX_LIGHTS);
+	cluster_lights.resize((size_t)CLUSTERS * MAX_CLUSTER_LIGHTS);
+	return true;
+}
+
+void LightClusters::clear()
+{
+	records.clear();
+	sphere_x.clear();
+	sphere_y.clear();
+	sphere_z.clear();
+	sphere_radius.clear();
+}
+
+bool LightClusters::addPoint(const vec3 & position, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular, float constant, float linear, float quadratic)
+{
+	if ((int)records.size() >= MAX_LIGHTS)
+		return false;
+
+	Record record = {};
+	STORE(record.position, position, 0.0f);
+	STORE(record.ambient, ambient, 0.0f);
+	STORE(record.diffuse, diffuse, 0.0f);
+	STORE(record.specular, specular, 0.0f);
+	STORE(record.attenuation, vec3(constant, linear, quadratic), 0.0f);
+	records.push_back(record);
+
+	addSphere(position, range(ambient, diffuse, specular, constant, linear, quadratic));
+	return true;
+}
+
+bool LightClusters::addSpot(const vec3 & position, const vec3 & direction, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular, float constant, float linear, float quadratic, float cos_cut_off, float cos_outer_cut_off)
+{
+	if ((int)records.size() >= MAX_LIGHTS)
+		return false;
+
+	Record record = {};
+	STORE(record.position, position, 1.0f);
+	STORE(record.direction, direction, 0.0f);
+	STORE(record.ambient, ambient, 0.0f);
+	STORE(record.diffuse, diffuse, 0.0f);
+	STORE(record.specular, specular, 0.0f);
+	STORE(record.attenuation, vec3(constant, linear, quadratic), 0.0f);
+	record.cone[0] = cos_cut_off;
+	record.cone[1] = cos_outer_cut_off;
+	records.push_back(record);
+
+	// The smallest sphere around the cone. A wide cone is held by the circle at its end, a narrow one by the sphere
+	// through its tip and the circle at its end. Wider than a half sphere it is a point light
+	float reach = range(ambient, diffuse, specular, constant, linear, quadratic);
+	vec3 axis = vec3::normalize(direction);
+	if (cos_outer_cut_off <= 0.0f)
+		addSphere(position, reach);
+	else if (cos_outer_cut_off < 0.70710678f)
+		addSphere(position + axis * (reach * cos_outer_cut_off), reach * sqrtf(1.0f - cos_outer_cut_off * cos_outer_cut_off));
+	else
+		addSphere(position + axis * (reach * 0.5f / cos_outer_cut_off), reach * 0.5f / cos_outer_cut_off);
+	return true;
+}
+
+void LightClusters::addSphere(const vec3 & center, float radius)
+{
+	sphere_x.push_back(center.x);
+	sphere_y.push_back(center.y);
+	sphere_z.push_back(center.z);
+	sphere_radius.push_back(radius);
+}
+
+float LightClusters::range(const vec3 & ambient, const vec3 & diffuse, const vec3 & specular, float constant, float linear, float quadratic)
+{
+	float brightest = std::max({ ambient.x, ambient.y, ambient.z, diffuse.x, diffuse.y, diffuse.z, specular.x, specular.y, specular.z });
+	if (brightest <= 0.0f)
+		return 0.0f;
+
+	// Where brightest / (constant + linear * d + quadratic * d^2) is the threshold
+	float c = constant - brightest / LIGHT_THRESHOLD;
+	if (quadratic > 0.0f)
+		return std::max((-linear + sqrtf(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic), 0.0f);
+	if (linear > 0.0f)
+		return std::max(-c / linear, 0.0f);
+	return 1e30f;
+}
+
+void LightClusters::build(const mat4 & view, const mat4 & projection, int width, int height)
+{
+	const float * v = view.matrix;
+	const float * p = projection.matrix;
+	int lights = (int)records.size();
+	int padded = (lights + 3) & ~3;
+
+	// The spheres are tested in view space, where the camera looks down -z
+	sphere_x.resize(padded, 0.0f);
+	sphere_y.resize(padded, 0.0f);
+	sphere_z.resize(padded, 0.0f);
+	sphere_radius.resize(padded, 0.0f);
+	for (int i = 0; i < lights; i++) {
+		float x = sphere_x[i], y = sphere_y[i], z = sphere_z[i];
+		sphere_x[i] = v[0] * x + v[4] * y + v[8] * z + v[12];
+		sphere_y[i] = v[1] * x + v[5] * y + v[9] * z + v[13];
+		sphere_z[i] = v[2] * x + v[6] * y + v[10] * z + v[14];
+	}
+
+	// The slices are spaced evenly in the log of the depth, between the near and far plane of the projection
+	float near_plane = p[14] / (p[10] - 1.0f);
+	float far_plane = p[14] / (p[10] + 1.0f);
+	float slice_scale = CLUSTERS_Z / logf(far_plane / near_plane);
+	float slice_depth[CLUSTERS_Z + 1];
+	for (int z = 0; z <= CLUSTERS_Z; z++)
+		slice_depth[z] = near_plane * powf(far_plane / near_plane, (float)z / CLUSTERS_Z);
+
+	// The planes between the tiles go through the camera. A point is right of the plane at x in NDC when
+	// p[0] * x_view + x * z_view >= 0, the same for y. Normalized, so the distance to a sphere center is its dot product
+	float plane_x[CLUSTERS_X + 1][2], plane_y[CLUSTERS_Y + 1][2];
+	for (int i = 0; i <= CLUSTERS_X; i++) {
+		float ndc = -1.0f + 2.0f * i / CLUSTERS_X;
+		float length = sqrtf(p[0] * p[0] + ndc * ndc);
+		plane_x[i][0] = p[0] / length;
+		plane_x[i][1] = ndc / length;
+	}
+	for (int i = 0; i <= CLUSTERS_Y; i++) {
+		float ndc = -1.0f + 2.0f * i / CLUSTERS_Y;
+		float length = sqrtf(p[5] * p[5] + ndc * ndc);
+		plane_y[i][0] = p[5] / length;
+		plane_y[i][1] = ndc / length;
+	}
+
+	// A row of tiles in a slice per task. The lights of the row are found first, then every tile of the row tests
+	// only those
+	if (lights > 0) {
+		ThreadPool::instance().parallelFor(0, CLUSTERS_Y * CLUSTERS_Z, [&](int row) {
+			int y = row % CLUSTERS_Y, z = row / CLUSTERS_Y;
+			alignas(16) float row_x[MAX_LIGHTS], row_z[MAX_LIGHTS], row_radius[MAX_LIGHTS];
+			uint16_t row_lights[MAX_LIGHTS];
+			int candidates = 0;
+
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 slice_near = _mm_set1_ps(slice_depth[z]), slice_far = _mm_set1_ps(slice_depth[z + 1]);
+			const __m128 bottom_y = _mm_set1_ps(plane_y[y][0]), bottom_z = _mm_set1_ps(plane_y[y][1]);
+			const __m128 top_y = _mm_set1_ps(plane_y[y + 1][0]), top_z = _mm_set1_ps(plane_y[y + 1][1]);
+			for (int i = 0; i < padded; i += 4) {
+				__m128 sy = _mm_loadu_ps(&sphere_y[i]), sz = _mm_loadu_ps(&sphere_z[i]);
+				__m128 radius = _mm_loadu_ps(&sphere_radius[i]);
+				__m128 depth = _mm_sub_ps(zero, sz);
+				// Between the near and far plane of the slice, and between the bottom and top plane of the row
+				__m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(depth, radius), slice_near), _mm_cmple_ps(_mm_sub_ps(depth, radius), slice_far));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(bottom_y, sy), _mm_mul_ps(bottom_z, sz)), _mm_sub_ps(zero, radius)));
+				inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_add_ps(_mm_mul_ps(top_y, sy), _mm_mul_ps(top_z, sz)), radius));
+				int mask = _mm_movemask_ps(inside);
+				if (i + 4 > lights)
+					mask &= (1 << (lights - i)) - 1;
+				for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+					if (!(mask & 1)) continue;
+					row_x[candidates] = sphere_x[i + lane];
+					row_z[candidates] = sphere_z[i + lane];
+					row_radius[candidates] = sphere_radius[i + lane];
+					row_lights[candidates] = (uint16_t)(i + lane);
+					candidates++;
+				}
+			}
+
+			for (int x = 0; x < CLUSTERS_X; x++) {
+				int cluster = x + CLUSTERS_X * (y + CLUSTERS_Y * z);
+				uint16_t * list = &cluster_lights[(size_t)cluster * MAX_CLUSTER_LIGHTS];
+				int count = 0;
+
+				const __m128 left_x = _mm_set1_ps(plane_x[x][0]), left_z = _mm_set1_ps(plane_x[x][1]);
+				const __m128 right_x = _mm_set1_ps(plane_x[x + 1][0]), right_z = _mm_set1_ps(plane_x[x + 1][1]);
+				for (int i = 0; i < candidates; i += 4) {
+					__m128 sx = _mm_load_ps(&row_x[i]), sz = _mm_load_ps(&row_z[i]), radius = _mm_load_ps(&row_radius[i]);
+					// Right of the left plane and left of the right plane of the tile
+					__m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(left_x, sx), _mm_mul_ps(left_z, sz)), _mm_sub_ps(zero, radius)),
+						_mm_cmple_ps(_mm_add_ps(_mm_mul_ps(right_x, sx), _mm_mul_ps(right_z, sz)), radius));
+					int mask = _mm_movemask_ps(inside);
+					if (i + 4 > candidates)
+						mask &= (1 << (candidates - i)) - 1;
+					for (int lane = 0; mask != 0 && count < MAX_CLUSTER_LIGHTS; lane++, mask >>= 1)
+						if (mask & 1) list[count++] = row_lights[i + lane];
+				}
+				cluster_counts[cluster] = count;
+			}
+		});
+	}
+	else {
+		memset(cluster_counts, 0, sizeof(cluster_counts));
+	}
+
+	Record * light_region = (Record *)light_buffer.beginWrite();
+	unsigned char * cluster_region = (unsigned char *)cluster_buffer.beginWrite();
+	uint32_t * index_region = (uint32_t *)index_buffer.beginWrite();
+	if (light_region == nullptr || cluster_region == nullptr || index_region == nullptr)
+		return;
+
+	if (lights > 0)
+		memcpy(light_region, records.data(), sizeof(Record) * lights);
+
+	Header header = { { (float)CLUSTERS_X / width, (float)CLUSTERS_Y / height, slice_scale, logf(near_plane) * slice_scale } };
+	memcpy(cluster_region, &header, sizeof(header));
+
+	// The lists of the clusters one after the other
+	uint32_t * grid = (uint32_t *)(cluster_region + sizeof(Header));
+	indices = 0;
+	for (int cluster = 0; cluster < CLUSTERS; cluster++) {
+		int count = std::min(cluster_counts[cluster], MAX_INDICES - indices);
+		const uint16_t * list = &cluster_lights[(size_t)cluster * MAX_CLUSTER_LIGHTS];
+		grid[cluster * 2] = indices;
+		grid[cluster * 2 + 1] = count;
+		for (int i = 0; i < count; i++)
+			index_region[indices + i] = list[i];
+		indices += count;
+	}
+
+	light_buffer.endWrite();
+	cluster_buffer.endWrite();
+	index_buffer.endWrite();
+}
+
+int LightClusters::lightCount() const
+{
+	return (int)records.size();
+}
+
+int LightClusters::indexCount() const
+{
+	return indices;
+}
+
+void LightClusters::remove()
+{
+	light_buffer.remove();
+	cluster_buffer.remove();
+	index_buffer.remove();
+	cluster_lights.clear();
+	records.clear();
+	indices = 0;
+}
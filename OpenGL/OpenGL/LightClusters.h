@@ -0,0 +1,82 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "maths.h"
+#include "UniformBuffer.h"
+#include <stdint.h>
+#include <vector>
+
+/*
+Clustered forward lighting. The view frustum is split into a grid of CLUSTERS_X x CLUSTERS_Y tiles on the screen and
+CLUSTERS_Z slices in depth, the slices grow exponentially with the distance. Every frame the point and spot lights
+are assigned to the clusters their sphere of influence touches, so a fragment only loops over the lights of its own
+cluster and the cost per pixel stays flat with hundreds of lights in the scene.
+
+The assignment runs on the CPU over the worker threads, a row of clusters per task, and tests the spheres against
+the planes of the clusters four lights at a time with SSE. A spot light is tested with the smallest sphere around its
+cone. Three shader storage buffers are written, shaders/clusters.glsl reads them:
+
+	lights   - every point and spot light of the frame
+	clusters - the render size and depth slicing, then the offset and count of the light indices of every cluster
+	indices  - the indices of the lights of all clusters, one list after the other
+
+Directional lights reach everything and stay in the light block.
+*/
+class LightClusters
+{
+public:
+	static const int CLUSTERS_X = 16, CLUSTERS_Y = 9, CLUSTERS_Z = 24;
+	static const int CLUSTERS = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+	static const int MAX_LIGHTS = 1024;
+	/* Lights of one cluster, the rest are left out */
+	static const int MAX_CLUSTER_LIGHTS = 256;
+	/* Size of the index list, clusters that no longer fit get no lights */
+	static const int MAX_INDICES = CLUSTERS * 32;
+	/* Binding points of the buffers, layout(std430, binding = ...) in the shaders */
+	static const unsigned int LIGHT_BINDING = 3;
+	static const unsigned int CLUSTER_BINDING = 4;
+	static const unsigned int INDEX_BINDING = 5;
+	/* Create the buffers. Returns false when they can not be mapped */
+	bool init();
+	/* Remove the lights of the previous frame */
+	void clear();
+	/* Add a light for this frame. Returns false when there are MAX_LIGHTS already */
+	bool addPoint(const vec3 & position, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular, float constant, float linear, float quadratic);
+	bool addSpot(const vec3 & position, const vec3 & direction, const vec3 & ambient, const vec3 & diffuse, const vec3 & specular, float constant, float linear, float quadratic, float cos_cut_off, float cos_outer_cut_off);
+	/* Assign the lights to the clusters of the camera and write the buffers, for the draws that follow. Once a frame,
+	after the lights are added. The projection is the one without jitter, width and height the size drawn to */
+	void build(const mat4 & view, const mat4 & projection, int width, int height);
+	/* Returns the number of lights added this frame */
+	int lightCount() const;
+	/* Returns the number of light indices written by the last build */
+	int indexCount() const;
+	/* Delete the buffers */
+	void remove();
+private:
+	/* Same layout as the lights of the ClusterLights buffer, std430 */
+	struct Record {
+		float position[4];	// w is 0 for a point light, 1 for a spot light
+		float direction[4];
+		float ambient[4];
+		float diffuse[4];
+		float specular[4];
+		float attenuation[4];	// Constant, linear, quadratic
+		float cone[4];	// Cosines of the inner and outer cut off
+	};
+	/* Same layout as the start of the LightClusters buffer, std430 */
+	struct Header {
+		float scale[4];	// Clusters per pixel in x and y, slices per log of the depth and the log of the near plane in slices
+	};
+	std::vector<Record> records;
+	/* The bounding spheres of the lights, one array per coordinate. In view space and padded to a multiple of 4 by build() */
+	std::vector<float> sphere_x, sphere_y, sphere_z, sphere_radius;
+	/* Lights of every cluster, MAX_CLUSTER_LIGHTS per cluster, and their count */
+	std::vector<uint16_t> cluster_lights;
+	int cluster_counts[CLUSTERS] = {};
+	int indices = 0;
+	UniformBuffer light_buffer, cluster_buffer, index_buffer;
+	/* Returns how far a light reaches before its brightest color falls below what can be seen */
+	static float range(const vec3 & ambient, const vec3 & diffuse, const vec3 & specular, float constant, float linear, float quadratic);
+	/* Add the bounding sphere of a light in world space */
+	void addSphere(const vec3 & center, float radius);
+};
@@ -1,4 +1,5 @@
 #include "Material.h"
+#include "GLState.h"
 
 Material::Material()
 {
@@ -38,6 +39,31 @@ void Material::addAmbientOcclusion(const Texture & texture)
 	this->AOBound = true;
 }
 
+void Material::addDiffuse(const char * path)
+{
+	addDiffuse(Texture(path, DIFFUSE_FORMAT));
+}
+
+void Material::addSpecular(const char * path)
+{
+	addSpecular(Texture(path, SPECULAR_FORMAT));
+}
+
+void Material::addNormal(const char * path)
+{
+	addNormal(Texture(path, NORMAL_FORMAT));
+}
+
+void Material::addDisplacement(const char * path)
+{
+	addDisplacement(Texture(path, DISPLACEMENT_FORMAT));
+}
+
+void Material::addAmbientOcclusion(const char * path)
+{
+	addAmbientOcclusion(Texture(path, AO_FORMAT));
+}
+
 const bool Material::hasDiffuse() {
 	return diffuseBound;
 }
@@ -65,47 +91,47 @@ const bool Material::hasAO()
 void Material::bind()
 {
 	if (diffuseBound) {
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, diffuse.id);
+		GLState::activeTexture(GL_TEXTURE0);
+		GLState::bindTexture(GL_TEXTURE_2D, diffuse.id);
 	}
 	if (specularBound) {
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, specular.id);
+		GLState::activeTexture(GL_TEXTURE1);
+		GLState::bindTexture(GL_TEXTURE_2D, specular.id);
 	}
 	if (normalBound) {
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, normal.id);
+		GLState::activeTexture(GL_TEXTURE2);
+		GLState::bindTexture(GL_TEXTURE_2D, normal.id);
 	}
 	if (displacementBound) {
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, displacement.id);
+		GLState::activeTexture(GL_TEXTURE3);
+		GLState::bindTexture(GL_TEXTURE_2D, displacement.id);
 	}
 	if (AOBound) {
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, ambient_occlusion.id);
+		GLState::activeTexture(GL_TEXTURE4);
+		GLState::bindTexture(GL_TEXTURE_2D, ambient_occlusion.id);
 	}
 }
 
 void Material::unbind()
 {
 	if (diffuseBound) {
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::activeTexture(GL_TEXTURE0);
+		GLState::bindTexture(GL_TEXTURE_2D, 0);
 	}
 	if (specularBound) {
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::activeTexture(GL_TEXTURE1);
+		GLState::bindTexture(GL_TEXTURE_2D, 0);
 	}
 	if (normalBound) {
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::activeTexture(GL_TEXTURE2);
+		GLState::bindTexture(GL_TEXTURE_2D, 0);
 	}
 	if (displacementBound) {
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::activeTexture(GL_TEXTURE3);
+		GLState::bindTexture(GL_TEXTURE_2D, 0);
 	}
 	if (AOBound) {
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		GLState::activeTexture(GL_TEXTURE4);
+		GLState::bindTexture(GL_TEXTURE_2D, 0);
 	}
 }
\ No newline at end of file
@@ -5,6 +5,9 @@ class Material
 {
 private:
 	bool diffuseBound = false, specularBound = false, normalBound = false, displacementBound = false, AOBound = false;
+	// Block compression used when a map is added by filepath
+	static constexpr BlockCompression::Format DIFFUSE_FORMAT = BlockCompression::BC1, SPECULAR_FORMAT = BlockCompression::BC4, NORMAL_FORMAT = BlockCompression::BC5,
+		DISPLACEMENT_FORMAT = BlockCompression::BC4, AO_FORMAT = BlockCompression::BC4;
 public:
 	Texture diffuse;
 	Texture specular;
@@ -26,6 +29,17 @@ public:
 	/* Add a ambient oclusion texture file to this Material object. */
 	void addAmbientOcclusion(const Texture &texture);
 
+	/* Load a diffuse texture file (BC1, BC3 with alpha) and add it to this Material object. */
+	void addDiffuse(const char * path);
+	/* Load a specular texture file (BC4) and add it to this Material object. */
+	void addSpecular(const char * path);
+	/* Load a normal texture file (BC5, z is rebuilt in the shader) and add it to this Material object. */
+	void addNormal(const char * path);
+	/* Load a displacement texture file (BC4) and add it to this Material object. */
+	void addDisplacement(const char * path);
+	/* Load a ambient oclusion texture file (BC4) and add it to this Material object. */
+	void addAmbientOcclusion(const char * path);
+
 	/* Returns a bool whether this texture object has a diffuse texture file bound or not */
 	const bool hasDiffuse();
 	/* Returns a bool whether this texture object has a specular texture file bound or not */
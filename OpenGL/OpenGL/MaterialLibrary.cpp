@@ -0,0 +1,192 @@
+#include "MaterialLibrary.h"
+#include "GLState.h"
+#include <algorithm>
+#include <stdio.h>
+
+int MaterialLibrary::add(Material & material, float shininess)
+{
+	Record record;
+	for (int slot = 0; slot < SLOTS; slot++) {
+		record.layers[slot] = -1;
+		record.arrays[slot] = 0;
+	}
+	record.shininess = shininess;
+	record.padding = 0;
+	materials.push_back(&material);
+	records.push_back(record);
+	return (int)materials.size() - 1;
+}
+
+bool MaterialLibrary::build()
+{
+	for (int slot = 0; slot < SLOTS; slot++)
+		buildSlot((Slot)slot);
+
+	if (records.empty())
+		return true;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, sizeof(Record) * records.size(), records.data(), 0);
+	return true;
+}
+
+void MaterialLibrary::buildSlot(Slot slot)
+{
+	const char * names[] = { "diffuse", "specular", "normal", "displacement", "ambient occlusion" };
+	std::vector<Map> maps;
+	for (int i = 0; i < (int)materials.size(); i++) {
+		Map entry = {};
+		entry.material = i;
+		entry.texture = map(*materials[i], slot);
+		if (entry.texture == 0) continue;
+		glGetTextureLevelParameteriv(entry.texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &entry.format);
+		glGetTextureLevelParameteriv(entry.texture, 0, GL_TEXTURE_WIDTH, &entry.width);
+		glGetTextureLevelParameteriv(entry.texture, 0, GL_TEXTURE_HEIGHT, &entry.height);
+		entry.levels = levelCount(entry.texture);
+		if (entry.levels <= 0 || entry.width <= 0 || entry.height <= 0) {
+			printf("Warning: The %s map of material %d has no image. It is left out\n", names[slot], i);
+			continue;
+		}
+		maps.push_back(entry);
+	}
+
+	// Every size and format gets its own array. The smallest maps first, so when the arrays run out the larger maps left
+	// can still be copied from a smaller mip level into an array that is there
+	std::stable_sort(maps.begin(), maps.end(), [](const Map & a, const Map & b) { return a.width * a.height < b.width * b.height; });
+	std::vector<Array> groups;
+	for (int index = 0; index < (int)maps.size(); index++) {
+		Map & entry = maps[index];
+		entry.array = -1;
+		entry.first_level = 0;
+		for (int array = 0; array < (int)groups.size() && entry.array < 0; array++) {
+			const Array & group = groups[array];
+			if (group.format == entry.format && group.width == entry.width && group.height == entry.height)
+				entry.array = array;
+		}
+		if (entry.array < 0 && (int)groups.size() < MAX_ARRAYS) {
+			Array group;
+			group.format = entry.format;
+			group.width = entry.width;
+			group.height = entry.height;
+			group.levels = entry.levels;
+			groups.push_back(group);
+			entry.array = (int)groups.size() - 1;
+		}
+		for (int array = 0; array < (int)groups.size() && entry.array < 0; array++) {
+			const Array & group = groups[array];
+			if (group.format != entry.format) continue;
+			int level = 0;
+			while (level < entry.levels && std::max(entry.width >> level, 1) > group.width)
+				level++;
+			if (level < entry.levels && std::max(entry.width >> level, 1) == group.width && std::max(entry.height >> level, 1) == group.height) {
+				entry.array = array;
+				entry.first_level = level;
+				printf("Warning: The %s map of material %d is %dx%d, the %s maps already have %d sizes and formats. It is used at %dx%d\n",
+					names[slot], entry.material, entry.width, entry.height, names[slot], MAX_ARRAYS, group.width, group.height);
+			}
+		}
+		if (entry.array < 0) {
+			printf("Warning: The %s map of material %d is %dx%d, the %s maps already have %d sizes and formats. It is left out\n",
+				names[slot], entry.material, entry.width, entry.height, names[slot], MAX_ARRAYS);
+			continue;
+		}
+
+		Array & group = groups[entry.array];
+		group.levels = std::min(group.levels, entry.levels - entry.first_level);
+		records[entry.material].arrays[slot] = entry.array;
+		records[entry.material].layers[slot] = (int)group.maps.size();
+		group.maps.push_back(index);
+	}
+
+	for (int array = 0; array < (int)groups.size(); array++) {
+		const Array & group = groups[array];
+		unsigned int & texture = arrays[slot][array];
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+		glTextureStorage3D(texture, group.levels, group.format, group.width, group.height, (GLsizei)group.maps.size());
+		for (int layer = 0; layer < (int)group.maps.size(); layer++) {
+			const Map & entry = maps[group.maps[layer]];
+			for (int level = 0; level < group.levels; level++) {
+				glCopyImageSubData(entry.texture, GL_TEXTURE_2D, entry.first_level + level, 0, 0, 0, texture, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+					std::max(group.width >> level, 1), std::max(group.height >> level, 1), 1);
+			}
+		}
+
+		// Sampled like the textures they came from, single channel maps are read as grey
+		GLint swizzle[4];
+		glGetTextureParameteriv(maps[group.maps[0]].texture, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		glTextureParameteriv(texture, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+}
+
+void MaterialLibrary::bind()
+{
+	for (int slot = 0; slot < SLOTS; slot++) {
+		for (int array = 0; array < MAX_ARRAYS; array++) {
+			GLState::activeTexture(GL_TEXTURE0 + FIRST_UNIT + slot * MAX_ARRAYS + array);
+			GLState::bindTexture(GL_TEXTURE_2D_ARRAY, arrays[slot][array]);
+		}
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, buffer);
+}
+
+void MaterialLibrary::setSamplers(Shader & shader)
+{
+	const char * samplers[] = { "diffuse_maps", "specular_maps", "normal_maps", "displacement_maps", "ao_maps" };
+	char name[32];
+	for (int slot = 0; slot < SLOTS; slot++) {
+		for (int array = 0; array < MAX_ARRAYS; array++) {
+			snprintf(name, sizeof(name), "%s[%d]", samplers[slot], array);
+			shader.setInt(name, FIRST_UNIT + slot * MAX_ARRAYS + array);
+		}
+	}
+}
+
+ShaderVariants::Features MaterialLibrary::features(int material) const
+{
+	ShaderVariants::Features features = 0;
+	if (records[material].layers[NORMAL] >= 0) features |= ShaderVariants::NORMAL_MAP;
+	if (records[material].layers[SPECULAR] >= 0) features |= ShaderVariants::SPECULAR_MAP;
+	return features;
+}
+
+void MaterialLibrary::remove()
+{
+	GLState::deleteTextures(SLOTS * MAX_ARRAYS, &arrays[0][0]);
+	for (int slot = 0; slot < SLOTS; slot++)
+		for (int array = 0; array < MAX_ARRAYS; array++)
+			arrays[slot][array] = 0;
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+unsigned int MaterialLibrary::map(Material & material, Slot slot)
+{
+	switch (slot) {
+	case DIFFUSE: return material.hasDiffuse() ? material.diffuse.id : 0;
+	case SPECULAR: return material.hasSpecular() ? material.specular.id : 0;
+	case NORMAL: return material.hasNormal() ? material.normal.id : 0;
+	case DISPLACEMENT: return material.hasDisplacement() ? material.displacement.id : 0;
+	case AO: return material.hasAO() ? material.ambient_occlusion.id : 0;
+	default: return 0;
+	}
+}
+
+int MaterialLibrary::levelCount(unsigned int texture)
+{
+	GLint levels = 0;
+	glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+	if (levels > 0)
+		return levels;
+
+	// Mutable storage, the levels up to the first one without an image
+	for (levels = 0; levels < 32; levels++) {
+		GLint width = 0;
+		glGetTextureLevelParameteriv(texture, levels, GL_TEXTURE_WIDTH, &width);
+		if (width == 0)
+			break;
+	}
+	return levels;
+}
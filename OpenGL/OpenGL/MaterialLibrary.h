@@ -0,0 +1,69 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Material.h"
+#include "ShaderVariants.h"
+#include <vector>
+
+/*
+The maps of all materials packed into GL_TEXTURE_2D_ARRAYs per slot (diffuse, specular, normal, displacement and
+ambient occlusion), with a record per material in a shader storage buffer that holds the array and layer of each of
+its maps. A draw only sets the index of its material, and the arrays are bound once a frame.
+
+The maps of an array share their size and format, every size and format of a slot has its own array, up to MAX_ARRAYS.
+After that a larger map is copied from the mip level that has the size of an array of its format, with a warning. The
+layers are copied on the GPU from the textures of the materials, block compressed data stays as it is.
+*/
+class MaterialLibrary
+{
+public:
+	enum Slot { DIFFUSE, SPECULAR, NORMAL, DISPLACEMENT, AO, SLOTS };
+	/* Binding point of the Materials buffer, layout(std430, binding = 2) in the shaders */
+	static const unsigned int MATERIAL_BINDING = 2;
+	/* Arrays of one slot, the sampler arrays of the shaders have this size */
+	static const int MAX_ARRAYS = 3;
+	/* The arrays are bound to FIRST_UNIT + slot * MAX_ARRAYS + array, clear of the units the other passes use */
+	static const unsigned int FIRST_UNIT = 16;
+	/* Add a material, before build(). Returns its index */
+	int add(Material & material, float shininess = 64.0f);
+	/* Create the arrays and the material buffer. Returns false on failure */
+	bool build();
+	/* Bind the arrays to their texture units and the material buffer */
+	void bind();
+	/* Point the sampler arrays of a program at the units of the arrays */
+	static void setSamplers(Shader & shader);
+	/* Returns the shader features of the maps a material has in the arrays */
+	ShaderVariants::Features features(int material) const;
+	/* Delete the arrays and the buffer */
+	void remove();
+private:
+	/* Same layout as the Materials buffer, std430 */
+	struct Record {
+		int layers[SLOTS];	// -1 without a map
+		int arrays[SLOTS];	// Of the slot
+		float shininess;
+		int padding;
+	};
+	/* A map of a slot and the part of it that goes into an array */
+	struct Map {
+		int material;
+		unsigned int texture;
+		GLint format, width, height, levels;
+		int array, first_level;
+	};
+	/* Size, format and mip levels shared by the layers of an array */
+	struct Array {
+		GLint format, width, height, levels;
+		std::vector<int> maps;
+	};
+	std::vector<Material *> materials;
+	std::vector<Record> records;
+	unsigned int arrays[SLOTS][MAX_ARRAYS] = {};
+	unsigned int buffer = 0;
+	/* Returns the texture of a slot of a material, 0 without one */
+	static unsigned int map(Material & material, Slot slot);
+	/* Returns the number of mip levels a texture has, 0 without storage */
+	static int levelCount(unsigned int texture);
+	/* Create and fill the arrays of a slot */
+	void buildSlot(Slot slot);
+};
@@ -0,0 +1,289 @@
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include <emmintrin.h>
+#include <math.h>
+
+// Half width of the Kaiser filter in destination texels, 2 gives 8 source taps when halving
+#define KAISER_RADIUS 2.0f
+#define KAISER_ALPHA 4.0f
+#define MAX_TAPS 12
+
+// Image of four floats per texel, the working format between two levels
+struct FloatImage {
+	int width, height, depth;
+	std::vector<float> texels;
+	FloatImage(int w, int h, int d) : width(w), height(h), depth(d), texels((size_t)w * h * d * 4) {}
+	float * row(int y, int z) { return &texels[((size_t)z * height + y) * width * 4]; }
+	const float * row(int y, int z) const { return &texels[((size_t)z * height + y) * width * 4]; }
+};
+
+// Source texels and weights of one destination texel along an axis
+struct Taps {
+	int count;
+	int index[MAX_TAPS];
+	float weight[MAX_TAPS];
+};
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double besselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+// Filter weight at distance x, measured in destination texels
+static double kernel(MipGenerator::Filter filter, double x)
+{
+	x = fabs(x);
+	if (filter == MipGenerator::BOX)
+		return x < 0.5 ? 1.0 : 0.0;
+
+	if (x >= KAISER_RADIUS)
+		return 0.0;
+	double sinc = (x < 1e-6) ? 1.0 : sin(3.14159265358979 * x) / (3.14159265358979 * x);
+	double t = x / KAISER_RADIUS;
+	return sinc * besselI0(KAISER_ALPHA * sqrt(1.0 - t * t)) / besselI0(KAISER_ALPHA);
+}
+
+// Build the taps that shrink an axis of source_size texels to destination_size texels. Textures repeat, so the taps wrap
+static std::vector<Taps> buildTaps(MipGenerator::Filter filter, int source_size, int destination_size)
+{
+	std::vector<Taps> taps(destination_size);
+	double scale = (double)source_size / destination_size;
+	double support = (filter == MipGenerator::BOX ? 0.5 : KAISER_RADIUS) * scale;
+
+	for (int i = 0; i < destination_size; i++) {
+		Taps & t = taps[i];
+		double center = (i + 0.5) * scale;
+		int first = (int)floor(center - support + 0.5), last = (int)floor(center + support - 0.5);
+		double total = 0.0;
+		t.count = 0;
+		for (int s = first; s <= last && t.count < MAX_TAPS; s++) {
+			double w = kernel(filter, (s + 0.5 - center) / scale);
+			if (w == 0.0) continue;
+			t.index[t.count] = ((s % source_size) + source_size) % source_size;
+			t.weight[t.count] = (float)w;
+			total += w;
+			t.count++;
+		}
+		for (int k = 0; k < t.count; k++)
+			t.weight[k] = (float)(t.weight[k] / total);
+	}
+	return taps;
+}
+
+// Shrink along x. Each texel is one __m128, so all channels are filtered by one multiply-add per tap
+static void reduceX(const FloatImage & source, FloatImage & destination, const std::vector<Taps> & taps)
+{
+	ThreadPool::instance().parallelFor(0, destination.height * destination.depth, [&](int line) {
+		int y = line % destination.height, z = line / destination.height;
+		const float * in = source.row(y, z);
+		float * out = destination.row(y, z);
+		for (int x = 0; x < destination.width; x++) {
+			const Taps & t = taps[x];
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < t.count; k++)
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + t.index[k] * 4), _mm_set1_ps(t.weight[k])));
+			_mm_storeu_ps(out + x * 4, sum);
+		}
+	});
+}
+
+// Weighted sum of whole source rows into one destination row
+static void sumRows(const float * const * rows, const Taps & t, float * out, int floats)
+{
+	for (int i = 0; i < floats; i += 4) {
+		__m128 sum = _mm_setzero_ps();
+		for (int k = 0; k < t.count; k++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(t.weight[k])));
+		_mm_storeu_ps(out + i, sum);
+	}
+}
+
+// Shrink along y, one destination row at a time
+static void reduceY(const FloatImage & source, FloatImage & destination, const std::vector<Taps> & taps)
+{
+	ThreadPool::instance().parallelFor(0, destination.height * destination.depth, [&](int line) {
+		int y = line % destination.height, z = line / destination.height;
+		const float * rows[MAX_TAPS];
+		for (int k = 0; k < taps[y].count; k++)
+			rows[k] = source.row(taps[y].index[k], z);
+		sumRows(rows, taps[y], destination.row(y, z), destination.width * 4);
+	});
+}
+
+// Shrink along z, one destination row at a time
+static void reduceZ(const FloatImage & source, FloatImage & destination, const std::vector<Taps> & taps)
+{
+	ThreadPool::instance().parallelFor(0, destination.height * destination.depth, [&](int line) {
+		int y = line % destination.height, z = line / destination.height;
+		const float * rows[MAX_TAPS];
+		for (int k = 0; k < taps[z].count; k++)
+			rows[k] = source.row(y, taps[z].index[k]);
+		sumRows(rows, taps[z], destination.row(y, z), destination.width * 4);
+	});
+}
+
+// sRGB to linear for every 8-bit value
+static const float * srgbTable()
+{
+	static struct Table {
+		float values[256];
+		Table()
+		{
+			for (int i = 0; i < 256; i++) {
+				float c = i / 255.0f;
+				values[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+		}
+	} table;
+	return table.values;
+}
+
+static float linearToSrgb(float c)
+{
+	return (c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static int colorChannels(int channels, int flags)
+{
+	return (flags & MipGenerator::SRGB) ? (channels < 3 ? channels : 3) : 0;
+}
+
+static FloatImage toFloat(const unsigned char * pixels, int width, int height, int depth, int channels, int flags)
+{
+	FloatImage image(width, height, depth);
+	const float * srgb = srgbTable();
+	int color = colorChannels(channels, flags);
+
+	ThreadPool::instance().parallelFor(0, height * depth, [&](int line) {
+		size_t begin = (size_t)line * width;
+		for (size_t i = begin; i < begin + width; i++) for (int c = 0; c < 4; c++) {
+			float v = 0.0f;
+			if (c < channels)
+				v = (c < color) ? srgb[pixels[i * channels + c]] : pixels[i * channels + c] / 255.0f;
+			image.texels[i * 4 + c] = v;
+		}
+	});
+	return image;
+}
+
+// Clamp away filter ringing and renormalise normals, in place, so the next level starts from valid texels
+static void finish(FloatImage & image, int channels, int flags)
+{
+	bool normals = (flags & MipGenerator::NORMAL_MAP) && channels >= 3;
+	ThreadPool::instance().parallelFor(0, image.height * image.depth, [&](int line) {
+		float * t = image.row(line % image.height, line / image.height);
+		for (int x = 0; x < image.width; x++, t += 4) {
+			_mm_storeu_ps(t, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(t), _mm_setzero_ps()), _mm_set1_ps(1.0f)));
+			if (!normals) continue;
+
+			float nx = t[0] * 2.0f - 1.0f, ny = t[1] * 2.0f - 1.0f, nz = t[2] * 2.0f - 1.0f;
+			float length = sqrtf(nx * nx + ny * ny + nz * nz);
+			if (length < 1e-6f) {
+				nx = 0.0f; ny = 0.0f; nz = 1.0f;
+			}
+			else {
+				nx /= length; ny /= length; nz /= length;
+			}
+			t[0] = nx * 0.5f + 0.5f;
+			t[1] = ny * 0.5f + 0.5f;
+			t[2] = nz * 0.5f + 0.5f;
+		}
+	});
+}
+
+static MipGenerator::Level toBytes(const FloatImage & image, int channels, int flags)
+{
+	MipGenerator::Level level;
+	level.width = image.width;
+	level.height = image.height;
+	level.depth = image.depth;
+	level.data.resize((size_t)image.width * image.height * image.depth * channels);
+	int color = colorChannels(channels, flags);
+
+	ThreadPool::instance().parallelFor(0, image.height * image.depth, [&](int line) {
+		size_t begin = (size_t)line * image.width;
+		for (size_t i = begin; i < begin + image.width; i++) for (int c = 0; c < channels; c++) {
+			float v = image.texels[i * 4 + c];
+			if (c < color)
+				v = linearToSrgb(v);
+			level.data[i * channels + c] = (unsigned char)(v * 255.0f + 0.5f);
+		}
+	});
+	return level;
+}
+
+static std::vector<MipGenerator::Level> generate(const unsigned char * pixels, int width, int height, int depth, int channels, MipGenerator::Filter filter, int flags)
+{
+	std::vector<MipGenerator::Level> levels;
+	if (!pixels || width <= 0 || height <= 0 || depth <= 0 || channels < 1 || channels > 4)
+		return levels;
+
+	MipGenerator::Level base;
+	base.width = width;
+	base.height = height;
+	base.depth = depth;
+	base.data.assign(pixels, pixels + (size_t)width * height * depth * channels);
+	levels.push_back(std::move(base));
+
+	FloatImage current = toFloat(pixels, width, height, depth, channels, flags);
+	while (current.width > 1 || current.height > 1 || current.depth > 1) {
+		// One axis at a time, axes that are already 1 texel wide are left alone
+		if (current.width > 1) {
+			FloatImage next(current.width / 2, current.height, current.depth);
+			reduceX(current, next, buildTaps(filter, current.width, next.width));
+			current = std::move(next);
+		}
+		if (current.height > 1) {
+			FloatImage next(current.width, current.height / 2, current.depth);
+			reduceY(current, next, buildTaps(filter, current.height, next.height));
+			current = std::move(next);
+		}
+		if (current.depth > 1) {
+			FloatImage next(current.width, current.height, current.depth / 2);
+			reduceZ(current, next, buildTaps(filter, current.depth, next.depth));
+			current = std::move(next);
+		}
+		finish(current, channels, flags);
+		levels.push_back(toBytes(current, channels, flags));
+	}
+	return levels;
+}
+
+std::vector<MipGenerator::Level> MipGenerator::generate2D(const unsigned char * pixels, int width, int height, int channels, Filter filter, int flags)
+{
+	return generate(pixels, width, height, 1, channels, filter, flags);
+}
+
+std::vector<MipGenerator::Level> MipGenerator::generate3D(const unsigned char * pixels, int width, int height, int depth, int channels, Filter filter, int flags)
+{
+	return generate(pixels, width, height, depth, channels, filter, flags);
+}
+
+void MipGenerator::upload2D(GLuint texture, const std::vector<Level> & levels, GLenum internal_format, GLenum format)
+{
+	// Rows of small levels are not 4 byte aligned
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureStorage2D(texture, (GLsizei)levels.size(), internal_format, levels[0].width, levels[0].height);
+	for (size_t i = 0; i < levels.size(); i++)
+		glTextureSubImage2D(texture, (GLint)i, 0, 0, levels[i].width, levels[i].height, format, GL_UNSIGNED_BYTE, levels[i].data.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+void MipGenerator::upload3D(GLuint texture, const std::vector<Level> & levels, GLenum internal_format, GLenum format)
+{
+	GLint alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureStorage3D(texture, (GLsizei)levels.size(), internal_format, levels[0].width, levels[0].height, levels[0].depth);
+	for (size_t i = 0; i < levels.size(); i++)
+		glTextureSubImage3D(texture, (GLint)i, 0, 0, 0, levels[i].width, levels[i].height, levels[i].depth, format, GL_UNSIGNED_BYTE, levels[i].data.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
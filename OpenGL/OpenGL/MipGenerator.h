@@ -0,0 +1,38 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <vector>
+
+/*
+Builds full mipmap chains for 8-bit 2D and 3D images on the CPU instead of glGenerateMipmap. Every level is filtered
+from the one above it in floating point, one axis at a time, with the lines of each pass spread over the ThreadPool.
+A texel is always held as four floats, so the filter taps are plain SSE multiply-adds for any channel count.
+
+Color images can be filtered in linear space (sRGB decoded first and encoded again after), and normal maps are
+renormalised on every level. The result only depends on the input, never on the number of threads.
+*/
+class MipGenerator
+{
+public:
+	enum Filter : short {
+		BOX = 0,	// 2x2(x2) average
+		KAISER = 1	// 8 tap Kaiser windowed sinc, sharper
+	};
+	enum Flags : short {
+		LINEAR = 0,
+		SRGB = 1,		// rgb stored gamma encoded, alpha linear
+		NORMAL_MAP = 2	// rgb is a unit vector stored as v * 0.5 + 0.5
+	};
+	struct Level {
+		int width, height, depth;
+		std::vector<unsigned char> data;
+	};
+	/* Build the mip chain of a 2D image, level 0 is a copy of the input */
+	static std::vector<Level> generate2D(const unsigned char * pixels, int width, int height, int channels, Filter filter, int flags);
+	/* Build the mip chain of a 3D image, level 0 is a copy of the input */
+	static std::vector<Level> generate3D(const unsigned char * pixels, int width, int height, int depth, int channels, Filter filter, int flags);
+	/* Allocate immutable storage for all levels of a new 2D texture (internal_format has to be sized) and upload them */
+	static void upload2D(GLuint texture, const std::vector<Level> & levels, GLenum internal_format, GLenum format);
+	/* Allocate immutable storage for all levels of a new 3D texture (internal_format has to be sized) and upload them */
+	static void upload3D(GLuint texture, const std::vector<Level> & levels, GLenum internal_format, GLenum format);
+};
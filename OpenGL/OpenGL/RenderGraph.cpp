@@ -0,0 +1,371 @@
+#include "RenderGraph.h"
+#include "GLState.h"
+#include <algorithm>
+
+// Frames a physical texture is kept after its last use
+#define UNUSED_FRAMES 120
+
+static bool isDepthFormat(GLenum format)
+{
+	return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F ||
+		format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+bool RenderGraph::Description::operator==(const Description & other) const
+{
+	return format == other.format && filter == other.filter && width == other.width && height == other.height;
+}
+
+void RenderGraph::reset()
+{
+	targets.clear();
+	passes.clear();
+	outputs.clear();
+}
+
+void RenderGraph::resize(int width, int height)
+{
+	if (width == this->width && height == this->height)
+		return;
+	this->width = width;
+	this->height = height;
+	render_width = std::max((int)(width * scale + 0.5f), 1);
+	render_height = std::max((int)(height * scale + 0.5f), 1);
+	clear();
+}
+
+void RenderGraph::setRenderScale(float scale)
+{
+	this->scale = scale;
+	int scaled_width = std::max((int)(width * scale + 0.5f), 1);
+	int scaled_height = std::max((int)(height * scale + 0.5f), 1);
+	if (scaled_width == render_width && scaled_height == render_height)
+		return;
+	render_width = scaled_width;
+	render_height = scaled_height;
+	clear();
+}
+
+int RenderGraph::renderWidth() const
+{
+	return render_width;
+}
+
+int RenderGraph::renderHeight() const
+{
+	return render_height;
+}
+
+void RenderGraph::clear()
+{
+	while (!pool.empty())
+		release((int)pool.size() - 1);
+	framebuffers.clear();
+}
+
+RenderGraph::Resource RenderGraph::declare(const char * name, GLenum format, int width, int height, GLenum filter, bool persistent)
+{
+	Target target;
+	target.name = name;
+	target.description.format = format;
+	target.description.filter = filter;
+	target.description.width = std::max(width, 1);
+	target.description.height = std::max(height, 1);
+	target.persistent = persistent;
+	target.imported = false;
+	target.texture = 0;
+	target.physical = -1;
+	target.first_use = target.last_use = -1;
+	target.read = false;
+	target.writer = -1;
+	targets.push_back(target);
+	return (Resource)targets.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::createTexture(const char * name, GLenum format, int divisor, GLenum filter)
+{
+	return declare(name, format, (render_width + divisor - 1) / divisor, (render_height + divisor - 1) / divisor, filter, false);
+}
+
+RenderGraph::Resource RenderGraph::createPersistentTexture(const char * name, GLenum format, int divisor, GLenum filter)
+{
+	return declare(name, format, (render_width + divisor - 1) / divisor, (render_height + divisor - 1) / divisor, filter, true);
+}
+
+RenderGraph::Resource RenderGraph::createWindowTexture(const char * name, GLenum format, GLenum filter)
+{
+	return declare(name, format, width, height, filter, false);
+}
+
+RenderGraph::Resource RenderGraph::createPersistentWindowTexture(const char * name, GLenum format, GLenum filter)
+{
+	return declare(name, format, width, height, filter, true);
+}
+
+RenderGraph::Resource RenderGraph::importTexture(const char * name, unsigned int texture)
+{
+	Resource resource = declare(name, GL_NONE, width, height, GL_NONE, false);
+	targets[resource].imported = true;
+	targets[resource].texture = texture;
+	return resource;
+}
+
+void RenderGraph::addPass(const char * name, const std::vector<Resource> & reads, const std::vector<Resource> & writes, std::function<void()> execute)
+{
+	int index = (int)passes.size();
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.live = false;
+
+	// A pass runs after the last pass that wrote what it reads
+	for (Resource resource : reads) {
+		if (resource == NONE) continue;
+		Target & target = targets[resource];
+		if (target.writer >= 0) {
+			pass.inputs.push_back(target.writer);
+			pass.after.push_back(target.writer);
+		}
+		target.readers.push_back(index);
+		pass.reads.push_back(resource);
+	}
+
+	// And a pass that writes draws on top of the last write, after everyone has read it
+	for (Resource resource : writes) {
+		if (resource == NONE) continue;
+		Target & target = targets[resource];
+		if (target.writer >= 0) {
+			pass.inputs.push_back(target.writer);
+			pass.after.push_back(target.writer);
+		}
+		for (int reader : target.readers)
+			if (reader != index) pass.after.push_back(reader);
+		target.readers.clear();
+		target.writer = index;
+		pass.writes.push_back(resource);
+	}
+
+	passes.push_back(pass);
+}
+
+void RenderGraph::setOutput(Resource resource)
+{
+	outputs.push_back(resource);
+}
+
+void RenderGraph::cull()
+{
+	std::vector<int> stack;
+	for (Resource output : outputs)
+		if (targets[output].writer >= 0) stack.push_back(targets[output].writer);
+
+	while (!stack.empty()) {
+		int index = stack.back();
+		stack.pop_back();
+		if (passes[index].live) continue;
+		passes[index].live = true;
+		for (int input : passes[index].inputs)
+			stack.push_back(input);
+	}
+}
+
+std::vector<int> RenderGraph::schedule() const
+{
+	// Number of live passes that still have to use every transient texture
+	std::vector<int> uses(targets.size(), 0);
+	int live = 0;
+	for (const Pass & pass : passes) {
+		if (!pass.live) continue;
+		live++;
+		for (Resource resource : pass.reads) uses[resource]++;
+		for (Resource resource : pass.writes) uses[resource]++;
+	}
+
+	std::vector<int> order;
+	std::vector<bool> done(passes.size(), false);
+	while ((int)order.size() < live) {
+		int best = -1, best_frees = -1;
+		for (int index = 0; index < (int)passes.size(); index++) {
+			const Pass & pass = passes[index];
+			if (!pass.live || done[index]) continue;
+			bool ready = true;
+			for (int other : pass.after)
+				if (passes[other].live && !done[other]) ready = false;
+			if (!ready) continue;
+
+			int frees = 0;
+			for (Resource resource : pass.reads)
+				if (!targets[resource].persistent && !targets[resource].imported && uses[resource] == 1) frees++;
+			if (frees > best_frees) {
+				best = index;
+				best_frees = frees;
+			}
+		}
+		if (best < 0) {
+			printf("Error: Render graph has a cycle\n");
+			break;
+		}
+
+		order.push_back(best);
+		done[best] = true;
+		for (Resource resource : passes[best].reads) uses[resource]--;
+		for (Resource resource : passes[best].writes) uses[resource]--;
+	}
+	return order;
+}
+
+void RenderGraph::allocate(const std::vector<int> & order)
+{
+	for (Physical & physical : pool) {
+		physical.free_after = -1;
+		physical.fresh = false;
+	}
+
+	// When every texture is used first and last
+	for (int position = 0; position < (int)order.size(); position++) {
+		const Pass & pass = passes[order[position]];
+		for (int i = 0; i < 2; i++) {
+			for (Resource resource : i == 0 ? pass.reads : pass.writes) {
+				Target & target = targets[resource];
+				if (target.first_use < 0) target.first_use = position;
+				target.last_use = position;
+				if (i == 0) target.read = true;
+			}
+		}
+	}
+	for (Resource output : outputs)
+		targets[output].read = true;
+
+	// Transient textures take the memory of textures that are done, in the order they are needed. Depth is kept even when
+	// nobody reads it, the pass itself tests against it
+	std::vector<Resource> transient;
+	for (Resource resource = 0; resource < (Resource)targets.size(); resource++) {
+		Target & target = targets[resource];
+		if (target.imported || target.first_use < 0) continue;
+		if (target.persistent) {
+			target.physical = acquire(target.description, target.first_use, true, target.name);
+			target.texture = pool[target.physical].texture;
+		}
+		else if (target.read || isDepthFormat(target.description.format)) {
+			transient.push_back(resource);
+		}
+	}
+	std::sort(transient.begin(), transient.end(), [&](Resource a, Resource b) { return targets[a].first_use < targets[b].first_use; });
+	for (Resource resource : transient) {
+		Target & target = targets[resource];
+		target.physical = acquire(target.description, target.first_use, false, target.name);
+		pool[target.physical].free_after = target.last_use;
+		target.texture = pool[target.physical].texture;
+	}
+}
+
+int RenderGraph::acquire(const Description & description, int first_use, bool persistent, const std::string & name)
+{
+	for (int i = 0; i < (int)pool.size(); i++) {
+		Physical & physical = pool[i];
+		if (physical.persistent != persistent || !(physical.description == description)) continue;
+		if (persistent ? physical.name != name : physical.free_after >= first_use) continue;
+		physical.last_frame = frame;
+		return i;
+	}
+
+	Physical physical;
+	physical.description = description;
+	physical.name = persistent ? name : std::string();
+	physical.free_after = -1;
+	physical.last_frame = frame;
+	physical.persistent = persistent;
+	physical.fresh = true;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &physical.texture);
+	glTextureStorage2D(physical.texture, 1, description.format, description.width, description.height);
+	glTextureParameteri(physical.texture, GL_TEXTURE_MIN_FILTER, description.filter);
+	glTextureParameteri(physical.texture, GL_TEXTURE_MAG_FILTER, description.filter);
+	glTextureParameteri(physical.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(physical.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	pool.push_back(physical);
+	return (int)pool.size() - 1;
+}
+
+void RenderGraph::bindTargets(const Pass & pass)
+{
+	std::vector<unsigned int> colors;
+	unsigned int depth = 0;
+	int target_width = width, target_height = height;
+	bool owned = false;
+	for (Resource resource : pass.writes) {
+		const Target & target = targets[resource];
+		if (target.imported) continue;
+		owned = true;
+		target_width = target.description.width;
+		target_height = target.description.height;
+		// Textures nobody reads have no memory, their output location is left out
+		if (isDepthFormat(target.description.format))
+			depth = target.texture;
+		else
+			colors.push_back(target.texture);
+	}
+
+	// Passes that only write imported textures bind their own framebuffer
+	if (owned) {
+		std::vector<unsigned int> key(colors);
+		key.push_back(depth);
+		std::unique_ptr<Framebuffer> & framebuffer = framebuffers[key];
+		if (!framebuffer) {
+			framebuffer.reset(new Framebuffer());
+			framebuffer->createFromTextures(colors, depth);
+		}
+		framebuffer->bind();
+	}
+	GLState::viewport(0, 0, target_width, target_height);
+}
+
+void RenderGraph::execute()
+{
+	if (width <= 0 || height <= 0)
+		return;
+
+	cull();
+	std::vector<int> order = schedule();
+	allocate(order);
+
+	for (int index : order) {
+		bindTargets(passes[index]);
+		passes[index].execute();
+	}
+	GLState::viewport(0, 0, width, height);
+
+	collect();
+	frame++;
+}
+
+unsigned int RenderGraph::texture(Resource resource) const
+{
+	return resource == NONE ? 0 : targets[resource].texture;
+}
+
+bool RenderGraph::isNew(Resource resource) const
+{
+	if (resource == NONE || targets[resource].physical < 0)
+		return true;
+	return pool[targets[resource].physical].fresh;
+}
+
+void RenderGraph::collect()
+{
+	for (int i = (int)pool.size() - 1; i >= 0; i--)
+		if (frame - pool[i].last_frame > UNUSED_FRAMES) release(i);
+}
+
+void RenderGraph::release(int physical)
+{
+	unsigned int texture = pool[physical].texture;
+	for (auto it = framebuffers.begin(); it != framebuffers.end();) {
+		if (std::find(it->first.begin(), it->first.end(), texture) != it->first.end())
+			it = framebuffers.erase(it);
+		else
+			++it;
+	}
+	GLState::deleteTextures(1, &texture);
+	pool.erase(pool.begin() + physical);
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Framebuffer.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+Render graph for the frame. Every frame the passes are declared again with the textures they read and write, then
+execute() orders them, culls passes whose results are never read, gives textures to the passes that are left and runs
+them.
+
+	transient textures  - live for one frame. Textures with the same format and size whose uses do not overlap share
+	                      memory. A color texture that is written but never read gets no memory at all
+	persistent textures - keep their contents from frame to frame (history), found again by their name
+	imported textures   - owned by someone else (the bloom chain, the default framebuffer), and written by the pass itself
+
+The transient and persistent textures a pass writes are bound as its framebuffer, color attachments in the order they
+were declared (the fragment output locations) and the depth texture as the depth attachment, with the viewport set to
+their size. Memory that has not been used for a while is freed, and resize() drops everything so it is created again
+at the new size. The textures follow the window size times the render scale, for dynamic resolution, except the window
+textures of the passes after the upscale.
+*/
+class RenderGraph
+{
+public:
+	typedef int Resource;
+	static const Resource NONE = -1;
+	/* Remove the passes and textures of the previous frame, the memory is kept for reuse */
+	void reset();
+	/* Set the window size that the sizes of the textures follow, and free all memory */
+	void resize(int width, int height);
+	/* Render the textures at a scale of the window size, and free all memory when that changes their size */
+	void setRenderScale(float scale);
+	/* Returns the size the textures are rendered at */
+	int renderWidth() const;
+	int renderHeight() const;
+	/* Declare a texture for this frame, 1 / divisor of the render size */
+	Resource createTexture(const char * name, GLenum format, int divisor = 1, GLenum filter = GL_LINEAR);
+	/* Declare a texture that keeps its contents between frames */
+	Resource createPersistentTexture(const char * name, GLenum format, int divisor = 1, GLenum filter = GL_LINEAR);
+	/* Declare a texture the size of the window, for the passes after the upscale */
+	Resource createWindowTexture(const char * name, GLenum format, GLenum filter = GL_LINEAR);
+	Resource createPersistentWindowTexture(const char * name, GLenum format, GLenum filter = GL_LINEAR);
+	/* Declare a texture that is owned outside of the graph */
+	Resource importTexture(const char * name, unsigned int texture);
+	/* Add a pass. Writing a texture that an earlier pass wrote draws on top of it */
+	void addPass(const char * name, const std::vector<Resource> & reads, const std::vector<Resource> & writes, std::function<void()> execute);
+	/* Keep the passes that lead to this texture, the result of the frame */
+	void setOutput(Resource resource);
+	/* Order, cull and allocate the passes, then run them */
+	void execute();
+	/* Returns the texture of a resource, valid inside the passes */
+	unsigned int texture(Resource resource) const;
+	/* Returns whether a persistent texture lost its contents (it was created this frame, at the start or after a resize) */
+	bool isNew(Resource resource) const;
+private:
+	struct Description {
+		GLenum format, filter;
+		int width, height;
+		bool operator==(const Description & other) const;
+	};
+	struct Physical {
+		unsigned int texture;
+		Description description;
+		std::string name;	// Of persistent textures
+		int free_after;	// Last pass of the frame it is used in
+		unsigned int last_frame;
+		bool persistent, fresh;
+	};
+	struct Target {
+		std::string name;
+		Description description;
+		bool persistent, imported;
+		unsigned int texture;
+		int physical;
+		int first_use, last_use;
+		bool read;
+		int writer;	// Last pass that wrote it, and the passes that read it since
+		std::vector<int> readers;
+	};
+	struct Pass {
+		std::string name;
+		std::vector<Resource> reads, writes;
+		std::function<void()> execute;
+		std::vector<int> inputs, after;	// Passes it reads the results of, and all passes it has to run after
+		bool live;
+	};
+	int width = 0, height = 0;
+	float scale = 1.0f;
+	int render_width = 0, render_height = 0;
+	unsigned int frame = 0;
+	std::vector<Target> targets;
+	std::vector<Pass> passes;
+	std::vector<Resource> outputs;
+	std::vector<Physical> pool;
+	std::map<std::vector<unsigned int>, std::unique_ptr<Framebuffer>> framebuffers;
+	/* Delete all memory */
+	void clear();
+	Resource declare(const char * name, GLenum format, int width, int height, GLenum filter, bool persistent);
+	/* Order of the live passes. Every pass runs after the passes it depends on, and of the passes that can run next the
+	one that is the last user of the most textures goes first, so their memory can be shared sooner */
+	std::vector<int> schedule() const;
+	/* Mark the passes that lead to an output */
+	void cull();
+	/* Give memory to the textures of the live passes */
+	void allocate(const std::vector<int> & order);
+	/* Create or find a physical texture */
+	int acquire(const Description & description, int first_use, bool persistent, const std::string & name);
+	/* Bind the framebuffer made of the written textures of a pass */
+	void bindTargets(const Pass & pass);
+	/* Delete physical textures that were not used for a while */
+	void collect();
+	/* Delete a physical texture and the framebuffers that use it */
+	void release(int physical);
+};
@@ -1,4 +1,26 @@
 #include "Shader.h"
+#include "GLState.h"
+#ifdef _WIN32
+#include <direct.h>
+#define makeDirectory(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define makeDirectory(path) mkdir(path, 0755)
+#endif
+
+// Linked programs are kept here between runs, one file per pair of shader files
+#define SHADER_CACHE_DIRECTORY "shaders/cache"
+
+// Files including files including files, deeper than this is taken as a loop
+#define MAX_INCLUDE_DEPTH 8
+
+// Header of the cached program binaries
+struct ProgramBinaryHeader {
+	char magic[4];
+	GLenum format;
+	uint32_t length;
+	uint64_t hash;	// Of the sources and the driver
+};
 
 char* Shader::readFile(const char* file_path)
 {
@@ -21,212 +43,559 @@ char* Shader::readFile(const char* file_path)
 	return file_contents;
 }
 
-int Shader::init(const char* vertex_shader_path, const char* fragment_shader_path)
+bool Shader::readSource(const char* file_path, std::string& source, int depth)
 {
-	int success;
-	char infoLog[512];
-	char* vertex_source = readFile(vertex_shader_path);
-	char* fragment_source = readFile(fragment_shader_path);
+	if (depth > MAX_INCLUDE_DEPTH) {
+		printf("Error: Includes nested too deep in %s\n", file_path);
+		return false;
+	}
+	char* contents = readFile(file_path);
+	if (contents == NULL)
+		return false;
+
+	// Included files are found next to the file that includes them
+	std::string directory(file_path);
+	size_t slash = directory.find_last_of("/\\");
+	directory = slash == std::string::npos ? std::string() : directory.substr(0, slash + 1);
+
+	bool success = true;
+	int line_number = 1;
+	for (const char* line = contents; *line && success; line_number++) {
+		const char* end = strchr(line, '\n');
+		size_t length = end ? end - line + 1 : strlen(line);
+		const char* directive = line;
+		while (*directive == ' ' || *directive == '\t') directive++;
+		const char* open = strchr(directive, '"');
+		const char* close = open ? strchr(open + 1, '"') : NULL;
+		if (strncmp(directive, "#include", 8) == 0 && close != NULL && close < line + length) {
+			success = readSource((directory + std::string(open + 1, close)).c_str(), source, depth + 1);
+			// Errors after the include are reported at their line in this file
+			source += "\n#line " + std::to_string(line_number + 1) + "\n";
+		}
+		else {
+			source.append(line, length);
+		}
+		line += length;
+	}
+	free(contents);
+	return success;
+}
+
+bool Shader::preprocess(const char* file_path, const std::string& defines, std::string& source)
+{
+	if (!readSource(file_path, source, 0))
+		return false;
+	if (defines.empty())
+		return true;
+	// The defines go right after #version, which has to be the first line
+	size_t end = source.find('\n');
+	end = end == std::string::npos ? source.size() : end + 1;
+	source.insert(end, defines + "#line 2\n");
+	return true;
+}
 
-	if (vertex_source == NULL) {
-		printf("Error: Vertex Shader is empty\n", vertex_shader_path);
+int Shader::init(const char* vertex_shader_path, const char* fragment_shader_path)
+{
+	if (begin(vertex_shader_path, fragment_shader_path) != 0)
 		return -1;
-	}
+	return finish();
+}
 
-	if (fragment_source == NULL) {
-		printf("Error: Fragment Shader is empty\n", vertex_shader_path);
+int Shader::begin(const char* vertex_shader_path, const char* fragment_shader_path, const std::string& defines, const std::string& variant)
+{
+	std::string vertex_source, fragment_source;
+	if (!preprocess(vertex_shader_path, defines, vertex_source) || !preprocess(fragment_shader_path, defines, fragment_source)) {
+		printf("Error: Unable to read %s and %s\n", vertex_shader_path, fragment_shader_path);
 		return -1;
 	}
 
 	strcpy(vertex_path, vertex_shader_path);
 	strcpy(fragment_path, fragment_shader_path);
+	this->variant = variant;
+
+	// A program linked by the same driver from the same sources is loaded from the cache
+	const char* sources[] = { vertex_source.c_str(), fragment_source.c_str() };
+	pending_hash = programHash(sources, 2);
+	if (loadBinary(pending_hash))
+		return 0;
+
+	// The driver may compile and link in the background, nothing waits for it until finish()
+	printf("Compiling: %s and %s %s\n", vertex_shader_path, fragment_shader_path, variant.c_str());
+	pending[0] = compile(GL_VERTEX_SHADER, sources[0]);
+	pending[1] = compile(GL_FRAGMENT_SHADER, sources[1]);
+	pending_count = 2;
+	link();
+	return 0;
+}
 
-	// Compile the vertex shader
-	printf("Compiling: %s\n", vertex_shader_path);
-	unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vertex_source, NULL);
-	glCompileShader(vertex);
-	// Print compile errors if any
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-		std::cout << "Error: Vertex compilation failed!\n" << infoLog << std::endl;
-	};
-	// Compile the fragment shader
-	printf("Compiling: %s\n", vertex_shader_path);
-	unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fragment_source, NULL);
-	glCompileShader(fragment);
-	// Print compile errors if any
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-		std::cout << "Error: Fragment compilation failed!\n" << infoLog << std::endl;
-	};
-	// Link vertex shader and fragment shader
-	printf("Linking: %s and %s\n", vertex_shader_path, fragment_shader_path);
+int Shader::initCompute(const char* compute_shader_path)
+{
+	std::string compute_source;
+	if (!preprocess(compute_shader_path, std::string(), compute_source)) {
+		printf("Error: Unable to read %s\n", compute_shader_path);
+		return -1;
+	}
+
+	strcpy(vertex_path, compute_shader_path);
+	fragment_path[0] = 0;
+	variant.clear();
+
+	const char* sources[] = { compute_source.c_str() };
+	pending_hash = programHash(sources, 1);
+	if (!loadBinary(pending_hash)) {
+		printf("Compiling: %s\n", compute_shader_path);
+		pending[0] = compile(GL_COMPUTE_SHADER, sources[0]);
+		pending_count = 1;
+		link();
+	}
+	return finish();
+}
+
+int Shader::finish()
+{
+	if (pending_count > 0) {
+		int success;
+		char infoLog[512];
+		glGetProgramiv(ID, GL_LINK_STATUS, &success);
+		if (!success) {
+			// Print compile errors if any, else the linking errors
+			const char* names[] = { "Vertex", "Fragment" };
+			bool compiled = true;
+			for (int i = 0; i < pending_count; i++) {
+				int compile_success;
+				glGetShaderiv(pending[i], GL_COMPILE_STATUS, &compile_success);
+				if (!compile_success) {
+					glGetShaderInfoLog(pending[i], 512, NULL, infoLog);
+					std::cout << "Error: " << (pending_count == 1 ? "Compute" : names[i]) << " compilation failed! " << vertex_path << " " << fragment_path << " " << variant << "\n" << infoLog << std::endl;
+					compiled = false;
+				}
+			}
+			if (compiled) {
+				glGetProgramInfoLog(ID, 512, NULL, infoLog);
+				std::cout << "Error: Shader linking failed! " << vertex_path << " " << fragment_path << " " << variant << "\n" << infoLog << std::endl;
+			}
+		}
+
+		// delete the shaders as they're linked into our program now and no longer necessery
+		for (int i = 0; i < pending_count; i++) {
+			glDetachShader(ID, pending[i]);
+			glDeleteShader(pending[i]);
+		}
+		pending_count = 0;
+		if (!success) {
+			// No half built program is left behind to be used
+			GLState::deleteProgram(ID);
+			ID = 0;
+			return -1;
+		}
+		saveBinary(pending_hash);
+	}
+
+	buildUniformTable();
+	return 0;
+}
+
+unsigned int Shader::compile(GLenum type, const char* source)
+{
+	unsigned int shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	return shader;
+}
+
+void Shader::link()
+{
 	ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
+	// Let the driver keep the binary, so it can be cached
+	if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+		glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	for (int i = 0; i < pending_count; i++)
+		glAttachShader(ID, pending[i]);
 	glLinkProgram(ID);
-	// print linking errors if any
+}
+
+uint64_t Shader::programHash(const char* const* sources, int count)
+{
+	// FNV-1a over the sources and the driver strings, a new driver rejects the old binaries anyway
+	uint64_t hash = 14695981039346656037ULL;
+	const char* driver[] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+	for (int i = 0; i < count + 3; i++) {
+		const char* text = i < count ? sources[i] : driver[i - count];
+		if (text == NULL)
+			continue;
+		// The terminator is hashed too, so the text can not move between two strings
+		for (const unsigned char* c = (const unsigned char*)text;; c++) {
+			hash ^= *c;
+			hash *= 1099511628211ULL;
+			if (*c == 0)
+				break;
+		}
+	}
+	return hash;
+}
+
+std::string Shader::cachePath() const
+{
+	// shaders/cache/<vertex>.<fragment>.<variant>.bin, from the file names without their directory and extension
+	std::string path = SHADER_CACHE_DIRECTORY;
+	const char* paths[] = { vertex_path, fragment_path };
+	for (int i = 0; i < 2; i++) {
+		if (paths[i][0] == 0)
+			continue;
+		const char* name = paths[i];
+		for (const char* c = paths[i]; *c; c++)
+			if (*c == '/' || *c == '\\') name = c + 1;
+		const char* extension = strrchr(name, '.');
+		path += (i == 0 ? "/" : ".") + std::string(name, extension ? extension - name : strlen(name));
+	}
+	if (!variant.empty())
+		path += "." + variant;
+	return path + ".bin";
+}
+
+bool Shader::loadBinary(uint64_t hash)
+{
+	GLint formats = 0;
+	if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats == 0)
+		return false;
+
+	FILE* input_file = fopen(cachePath().c_str(), "rb");
+	if (input_file == NULL)
+		return false;
+
+	ProgramBinaryHeader header;
+	std::vector<unsigned char> binary;
+	bool valid = fread(&header, sizeof(header), 1, input_file) == 1
+		&& memcmp(header.magic, "PGB1", 4) == 0
+		&& header.hash == hash
+		&& header.length > 0;
+	if (valid) {
+		binary.resize(header.length);
+		valid = fread(binary.data(), 1, binary.size(), input_file) == binary.size();
+	}
+	fclose(input_file);
+	if (!valid)
+		return false;
+
+	// The driver may still reject it, after an update for example, then the sources are compiled
+	ID = glCreateProgram();
+	glProgramBinary(ID, header.format, binary.data(), (GLsizei)binary.size());
+	int success;
 	glGetProgramiv(ID, GL_LINK_STATUS, &success);
-	if (!success)
-	{
-		glGetProgramInfoLog(ID, 512, NULL, infoLog);
-		std::cout << "Error: Shader linking failed!\n" << infoLog << std::endl;
+	if (!success) {
+		GLState::deleteProgram(ID);
+		ID = 0;
+		return false;
 	}
+	printf("Loaded from cache: %s\n", cachePath().c_str());
+	return true;
+}
 
-	// delete the shaders as they're linked into our program now and no longer necessery
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
-	
-	return 0;
+void Shader::saveBinary(uint64_t hash)
+{
+	GLint formats = 0;
+	if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats == 0)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	std::vector<unsigned char> binary(length);
+	ProgramBinaryHeader header;
+	memcpy(header.magic, "PGB1", 4);
+	header.hash = hash;
+	glGetProgramBinary(ID, length, &length, &header.format, binary.data());
+	header.length = (uint32_t)length;
+
+	makeDirectory(SHADER_CACHE_DIRECTORY);
+	std::string path = cachePath();
+	FILE* output_file = fopen(path.c_str(), "wb");
+	if (output_file == NULL) {
+		printf("Warning: Unable to write shader cache: %s\n", path.c_str());
+		return;
+	}
+	fwrite(&header, sizeof(header), 1, output_file);
+	fwrite(binary.data(), 1, header.length, output_file);
+	fclose(output_file);
+}
+
+void Shader::buildUniformTable()
+{
+	uniforms.clear();
+	table.clear();
+
+	GLint count = 0, max_length = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+	std::vector<char> name(max_length + 16);
+	std::vector<UniformSlot> names;
+
+	for (GLint i = 0; i < count; i++) {
+		GLint size = 0;
+		GLenum type;
+		GLsizei length = 0;
+		glGetActiveUniform(ID, i, max_length, &length, &size, &type, name.data());
+		// Uniforms in blocks have no location
+		GLint location = glGetUniformLocation(ID, name.data());
+		if (location < 0)
+			continue;
+
+		Uniform uniform = {};
+		uniform.location = location;
+		names.push_back({ uniformHash(name.data()), (int)uniforms.size() });
+		uniforms.push_back(uniform);
+
+		// An array is listed once as name[0], every element gets its own location
+		if (length < 3 || strcmp(name.data() + length - 3, "[0]") != 0)
+			continue;
+		name[length - 3] = 0;
+		names.push_back({ uniformHash(name.data()), (int)uniforms.size() - 1 });
+		for (GLint element = 1; element < size; element++) {
+			snprintf(name.data() + length - 3, name.size() - length + 3, "[%d]", element);
+			uniform.location = glGetUniformLocation(ID, name.data());
+			names.push_back({ uniformHash(name.data()), (int)uniforms.size() });
+			uniforms.push_back(uniform);
+		}
+	}
+
+	// At most half full, so a lookup of a name that is not there stops soon
+	size_t capacity = 1;
+	while (capacity < names.size() * 2)
+		capacity *= 2;
+	table.assign(capacity, { 0, -1 });
+	for (const UniformSlot & entry : names) {
+		size_t slot = entry.hash & (capacity - 1);
+		while (table[slot].uniform >= 0) {
+			if (table[slot].hash == entry.hash)
+				printf("Error: Two uniforms of %s have the same name hash\n", fragment_path[0] ? fragment_path : vertex_path);
+			slot = (slot + 1) & (capacity - 1);
+		}
+		table[slot] = entry;
+	}
+}
+
+Shader::Uniform * Shader::findUniform(UniformHash hash) const
+{
+	if (table.empty())
+		return nullptr;
+	size_t mask = table.size() - 1;
+	for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+		if (table[slot].uniform < 0)
+			return nullptr;
+		if (table[slot].hash == hash)
+			return &uniforms[table[slot].uniform];
+	}
+}
+
+bool Shader::changed(Uniform * uniform, const void * value, size_t size) const
+{
+	if (uniform == nullptr)
+		return false;
+	if (uniform->set && memcmp(uniform->value, value, size) == 0)
+		return false;
+	memcpy(uniform->value, value, size);
+	uniform->set = true;
+	return true;
 }
 
-void Shader::use()
+void Shader::use() const
 {
-	glUseProgram(ID);
+	GLState::useProgram(ID);
+}
+
+// The values are set on the program itself, so the cached values stay right whichever program is in use
+
+void Shader::setBool(UniformHash name, bool value) const
+{
+	setInt(name, (int)value);
 }
 
 void Shader::setBool(const char* name, bool value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name), (int)value);
+	setInt(uniformHash(name), (int)value);
 }
 
 void Shader::setBool(std::string name, bool value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	setInt(uniformHash(name.c_str()), (int)value);
+}
+
+void Shader::setInt(UniformHash name, int value) const
+{
+	Uniform * uniform = findUniform(name);
+	if (changed(uniform, &value, sizeof(value)))
+		glProgramUniform1i(ID, uniform->location, value);
 }
 
 void Shader::setInt(const char* name, int value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name), value);
+	setInt(uniformHash(name), value);
 }
 
 void Shader::setInt(std::string name, int value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	setInt(uniformHash(name.c_str()), value);
+}
+
+void Shader::setFloat(UniformHash name, float value) const
+{
+	Uniform * uniform = findUniform(name);
+	if (changed(uniform, &value, sizeof(value)))
+		glProgramUniform1f(ID, uniform->location, value);
 }
 
 void Shader::setFloat(const char* name, float value) const
 {
-	glUniform1f(glGetUniformLocation(ID, name), value);
+	setFloat(uniformHash(name), value);
 }
 
 void Shader::setFloat(std::string name, float value) const
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	setFloat(uniformHash(name.c_str()), value);
 }
 
-void Shader::setVec2(const char* name, const vec2 & value) const
+void Shader::setVec2(UniformHash name, const vec2 & value) const
 {
 	float temp[] = { value.x, value.y };
-	glUniform2fv(glGetUniformLocation(ID, name), 1, temp);
+	Uniform * uniform = findUniform(name);
+	if (changed(uniform, temp, sizeof(temp)))
+		glProgramUniform2fv(ID, uniform->location, 1, temp);
 }
 
-void Shader::setVec2(std::string name, const vec2 & value) const
+void Shader::setVec2(const char* name, const vec2 & value) const
 {
-	float temp[] = { value.x, value.y };
-	glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, temp);
+	setVec2(uniformHash(name), value);
 }
 
+void Shader::setVec2(std::string name, const vec2 & value) const
+{
+	setVec2(uniformHash(name.c_str()), value);
+}
 
 void Shader::setVec2(const char* name, float x, float y) const
 {
-	glUniform2f(glGetUniformLocation(ID, name), x, y);
+	setVec2(uniformHash(name), vec2(x, y));
 }
 
-void Shader::setVec3(const char* name, const vec3 & value) const
+void Shader::setVec3(UniformHash name, const vec3 & value) const
 {
 	float temp[] = { value.x, value.y, value.z };
-	glUniform3fv(glGetUniformLocation(ID, name), 1, temp);
+	Uniform * uniform = findUniform(name);
+	if (changed(uniform, temp, sizeof(temp)))
+		glProgramUniform3fv(ID, uniform->location, 1, temp);
+}
+
+void Shader::setVec3(const char* name, const vec3 & value) const
+{
+	setVec3(uniformHash(name), value);
 }
 
 void Shader::setVec3(std::string name, const vec3 & value) const
 {
-	float temp[] = { value.x, value.y, value.z };
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, temp);
+	setVec3(uniformHash(name.c_str()), value);
 }
 
 void Shader::setVec3(const char* name, float x, float y, float z) const
 {
-	glUniform3f(glGetUniformLocation(ID, name), x, y, z);
+	setVec3(uniformHash(name), vec3(x, y, z));
 }
 
-void Shader::setVec4(const char* name, const vec4 & value) const
+void Shader::setVec4(UniformHash name, const vec4 & value) const
 {
 	float temp[] = { value.x, value.y, value.z, value.w };
-	glUniform4fv(glGetUniformLocation(ID, name), 1, temp);
+	Uniform * uniform = findUniform(name);
+	if (changed(uniform, temp, sizeof(temp)))
+		glProgramUniform4fv(ID, uniform->location, 1, temp);
 }
 
-void Shader::setVec4(std::string name, const vec4 & value) const
+void Shader::setVec4(const char* name, const vec4 & value) const
 {
-	float temp[] = { value.x, value.y, value.z, value.w };
-	glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, temp);
+	setVec4(uniformHash(name), value);
 }
 
+void Shader::setVec4(std::string name, const vec4 & value) const
+{
+	setVec4(uniformHash(name.c_str()), value);
+}
 
 void Shader::setVec4(const char* name, float x, float y, float z, float w)
 {
-	glUniform4f(glGetUniformLocation(ID, name), x, y, z, w);
+	setVec4(uniformHash(name), vec4(x, y, z, w));
+}
+
+void Shader::setMat2(UniformHash name, const mat2 & mat) const
+{
+	Uniform * uniform = findUniform(name);
+	if (changed(uniform, mat.matrix, sizeof(mat.matrix)))
+		glProgramUniformMatrix2fv(ID, uniform->location, 1, GL_FALSE, mat.matrix);
 }
 
 void Shader::setMat2(const char* name, const mat2 & mat) const
 {
-	glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, mat.matrix);
+	setMat2(uniformHash(name), mat);
 }
 
 void Shader::setMat2(std::string name, const mat2 & mat) const
 {
-	glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, mat.matrix);
+	setMat2(uniformHash(name.c_str()), mat);
+}
+
+void Shader::setMat3(UniformHash name, const mat3 & mat) const
+{
+	Uniform * uniform = findUniform(name);
+	if (changed(uniform, mat.matrix, sizeof(mat.matrix)))
+		glProgramUniformMatrix3fv(ID, uniform->location, 1, GL_FALSE, mat.matrix);
 }
 
 void Shader::setMat3(const char* name, const mat3 & mat) const
 {
-	glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, mat.matrix);
+	setMat3(uniformHash(name), mat);
 }
 
 void Shader::setMat3(std::string name, const mat3 & mat) const
 {
-	glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, mat.matrix);
+	setMat3(uniformHash(name.c_str()), mat);
+}
+
+void Shader::setMat4(UniformHash name, const mat4 & mat) const
+{
+	Uniform * uniform = findUniform(name);
+	if (changed(uniform, mat.matrix, sizeof(mat.matrix)))
+		glProgramUniformMatrix4fv(ID, uniform->location, 1, GL_FALSE, mat.matrix);
 }
 
 void Shader::setMat4(const char* name, const mat4 & mat) const
 {
-	glUseProgram(ID);
-	glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, mat.matrix);
+	setMat4(uniformHash(name), mat);
 }
 
 void Shader::setMat4(std::string name, const mat4 & mat) const
 {
-	glUseProgram(ID);
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, mat.matrix);
+	setMat4(uniformHash(name.c_str()), mat);
 }
 
 void Shader::setTexture1D(Texture t, const char* name)
 {
-	glUseProgram(ID);
-	GLint uni = glGetUniformLocation(ID, name);
-	glUniform1i(uni, t.index);
-	glActiveTexture(GL_TEXTURE0 + t.index);
-	glBindTexture(GL_TEXTURE_1D, t.id);
+	setInt(name, t.index);
+	GLState::activeTexture(GL_TEXTURE0 + t.index);
+	GLState::bindTexture(GL_TEXTURE_1D, t.id);
 }
 
 void Shader::setTexture2D(Texture t, const char* name)
 {
-	glUseProgram(ID);
-	GLint uni = glGetUniformLocation(ID, name);
-	glUniform1i(uni, t.index);
-	glActiveTexture(GL_TEXTURE0 + t.index);
-	glBindTexture(GL_TEXTURE_2D, t.id);
+	setInt(name, t.index);
+	GLState::activeTexture(GL_TEXTURE0 + t.index);
+	GLState::bindTexture(GL_TEXTURE_2D, t.id);
 }
 
 void Shader::setTexture3D(Texture t, const char* name)
 {
-	glUseProgram(ID);
-	GLint uni = glGetUniformLocation(ID, name);
-	glUniform1i(uni, t.index);
-	glActiveTexture(GL_TEXTURE0 + t.index);
-	glBindTexture(GL_TEXTURE_3D, t.id);
-}
\ No newline at end of file
+	setInt(name, t.index);
+	GLState::activeTexture(GL_TEXTURE0 + t.index);
+	GLState::bindTexture(GL_TEXTURE_3D, t.id);
+}
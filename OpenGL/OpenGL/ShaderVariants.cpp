@@ -0,0 +1,105 @@
+#include "ShaderVariants.h"
+#include "GLState.h"
+#include "LightBuffer.h"
+#include <algorithm>
+
+void ShaderVariants::init(const char * vertex_path, const char * fragment_path, std::function<void(Shader &)> setup)
+{
+	this->vertex_path = vertex_path;
+	this->fragment_path = fragment_path;
+	this->setup = setup;
+
+	// Let the driver use as many threads as it likes for the variants that are built together
+	if (GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	else if (GLEW_ARB_parallel_shader_compile)
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+}
+
+bool ShaderVariants::prepare(const std::vector<Features> & variants)
+{
+	// Every variant is started before the first one is waited for, so they compile at the same time
+	std::vector<Shader *> started;
+	bool success = true;
+	for (Features features : variants) {
+		if (this->variants.count(features)) continue;
+		Shader * shader = begin(features);
+		if (shader == nullptr)
+			success = false;
+		else
+			started.push_back(shader);
+	}
+	for (Shader * shader : started)
+		success = finish(*shader) && success;
+	return success;
+}
+
+Shader * ShaderVariants::get(Features features)
+{
+	auto it = variants.find(features);
+	if (it != variants.end())
+		return it->second.get();
+
+	// A variant that fails stays in the map, so it is not built again every draw
+	Shader * shader = begin(features);
+	if (shader != nullptr)
+		finish(*shader);
+	return variants[features].get();
+}
+
+ShaderVariants::Features ShaderVariants::lightCounts(int directional, int point, int spot, int positions)
+{
+	Features features = LIGHT_COUNTS;
+	int counts[] = { directional, point, spot, positions };
+	for (int i = 0; i < 4; i++)
+		features |= (Features)std::min(std::max(counts[i], 0), LightBuffer::MAX_LIGHTS) << (LIGHT_COUNT_SHIFT + i * LIGHT_COUNT_BITS);
+	return features;
+}
+
+void ShaderVariants::remove()
+{
+	for (auto & variant : variants)
+		GLState::deleteProgram(variant.second->ID);
+	variants.clear();
+}
+
+std::string ShaderVariants::defines(Features features)
+{
+	std::string defines;
+	if (features & NORMAL_MAP) defines += "#define NORMAL_MAP\n";
+	if (features & SPECULAR_MAP) defines += "#define SPECULAR_MAP\n";
+	if (features & LIGHT_COUNTS) {
+		const char * names[] = { "DIRECTIONAL_LIGHTS", "POINT_LIGHTS", "SPOT_LIGHTS", "LIGHT_POSITIONS" };
+		for (int i = 0; i < 4; i++) {
+			int count = (features >> (LIGHT_COUNT_SHIFT + i * LIGHT_COUNT_BITS)) & ((1 << LIGHT_COUNT_BITS) - 1);
+			defines += std::string("#define ") + names[i] + " " + std::to_string(count) + "\n";
+		}
+	}
+	return defines;
+}
+
+Shader * ShaderVariants::begin(Features features)
+{
+	char name[16];
+	snprintf(name, sizeof(name), "%08x", features);
+	std::unique_ptr<Shader> & shader = variants[features];
+	shader.reset(new Shader());
+	if (shader->begin(vertex_path.c_str(), fragment_path.c_str(), defines(features), name) != 0) {
+		// Kept without a program, it draws nothing
+		shader->ID = 0;
+		return nullptr;
+	}
+	return shader.get();
+}
+
+bool ShaderVariants::finish(Shader & shader)
+{
+	if (shader.finish() != 0) {
+		// Kept without a program like a variant that could not be read
+		shader.ID = 0;
+		return false;
+	}
+	shader.use();
+	setup(shader);
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "Shader.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+Specialised builds of one pair of shaders. A variant is named by a bitmask of features, and every feature that is set
+becomes a #define in front of the sources, so the paths of the features that are not set are compiled out instead of
+branched over at runtime.
+
+	material features - from the maps the MaterialLibrary has for the material that is drawn (normal map, specular map)
+	light counts      - the number of lights of every type, compiled in so the loops over them are unrolled. Without
+	                    them the shaders read the counts from the light block
+
+The variants that are known up front are built together in prepare(), where the driver compiles them in parallel with
+KHR_parallel_shader_compile. Any other variant is built the first time it is asked for.
+*/
+class ShaderVariants
+{
+public:
+	typedef unsigned int Features;
+	static const Features NORMAL_MAP = 1 << 0;
+	static const Features SPECULAR_MAP = 1 << 1;
+	static const Features MATERIAL_FEATURES = NORMAL_MAP | SPECULAR_MAP;
+	/* Set the shaders the variants are built from. setup is called on every new variant, to set its samplers */
+	void init(const char * vertex_path, const char * fragment_path, std::function<void(Shader &)> setup);
+	/* Build these variants all at once. Returns false when one of them fails */
+	bool prepare(const std::vector<Features> & variants);
+	/* Returns the variant with these features, built now when it was not prepared */
+	Shader * get(Features features);
+	/* Returns the features with the light counts compiled in, at most LightBuffer::MAX_LIGHTS of each */
+	static Features lightCounts(int directional, int point, int spot, int positions);
+	/* Delete every variant */
+	void remove();
+private:
+	/* The light counts are 5 bit fields from LIGHT_COUNT_SHIFT on, after a bit that says they are set */
+	static const Features LIGHT_COUNTS = 1 << 7;
+	static const int LIGHT_COUNT_SHIFT = 8, LIGHT_COUNT_BITS = 5;
+	std::string vertex_path, fragment_path;
+	std::function<void(Shader &)> setup;
+	std::map<Features, std::unique_ptr<Shader>> variants;
+	/* The #defines of a variant */
+	static std::string defines(Features features);
+	/* Start building a variant. Returns nullptr on failure, the variant is kept without a program */
+	Shader * begin(Features features);
+	/* Wait for a variant and set it up. Returns false on failure */
+	bool finish(Shader & shader);
+};
@@ -1,4 +1,5 @@
 #include "Text.h"
+#include "GLState.h"
 
 /*
 
@@ -11,12 +12,9 @@
 void Text::initFonts(std::string fontPath, int WINDOW_HEIGHT, int WINDOW_WIDTH)
 {
 
-	textShader.init("shaders/text_vert.shader", "shaders/text_frag.shader");
-	mat4 projection = mat4::makeOrtho(0.0f, static_cast<GLfloat>(WINDOW_WIDTH), 0.0f, static_cast<GLfloat>(WINDOW_HEIGHT));
-	textShader.use();
-
-
-	textShader.setMat4("projection", projection);
+	if (textShader.init("shaders/text_vert.shader", "shaders/text_frag.shader") != 0)
+		printf("Error: Unable to create the text shader\n");
+	resize(WINDOW_HEIGHT, WINDOW_WIDTH);
 
 
 	FT_Library ft;
@@ -48,7 +46,7 @@ void Text::initFonts(std::string fontPath, int WINDOW_HEIGHT, int WINDOW_WIDTH)
 		// Generate texture
 		GLuint texture;
 		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
+		GLState::bindTexture(GL_TEXTURE_2D, texture);
 		glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
@@ -75,7 +73,7 @@ void Text::initFonts(std::string fontPath, int WINDOW_HEIGHT, int WINDOW_WIDTH)
 		Characters.insert(std::pair<GLchar, Character>(c, character));
 	}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::bindTexture(GL_TEXTURE_2D, 0);
 	// Destroy FreeType once we're finished
 	FT_Done_Face(face);
 	FT_Done_FreeType(ft);
@@ -84,25 +82,31 @@ void Text::initFonts(std::string fontPath, int WINDOW_HEIGHT, int WINDOW_WIDTH)
 	// Configure VAO/VBO for texture quads
 	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
+	GLState::bindVertexArray(VAO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	GLState::bindVertexArray(0);
 
 
 }
 
+void Text::resize(int WINDOW_HEIGHT, int WINDOW_WIDTH)
+{
+	mat4 projection = mat4::makeOrtho(0.0f, static_cast<GLfloat>(WINDOW_WIDTH), 0.0f, static_cast<GLfloat>(WINDOW_HEIGHT));
+	textShader.setMat4("projection", projection);
+}
+
 void Text::RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, vec3 color)
 {
 	// Activate corresponding render state	
 	textShader.use();
-	glUniform3f(glGetUniformLocation(textShader.ID, "textColor"), color.x, color.y, color.z);
+	textShader.setVec3("textColor", color);
 	//shader.setVec4("textColor", color.x, color.y, color.z);
-	glActiveTexture(GL_TEXTURE0);
-	glBindVertexArray(VAO);
+	GLState::activeTexture(GL_TEXTURE0);
+	GLState::bindVertexArray(VAO);
 
 	// Iterate through all characters
 	std::string::const_iterator c;
@@ -126,7 +130,7 @@ void Text::RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, vec
 			{ xpos + w, ypos + h,   1.0, 0.0 }
 		};
 		// Render glyph texture over quad
-		glBindTexture(GL_TEXTURE_2D, ch.TextureID);
+		GLState::bindTexture(GL_TEXTURE_2D, ch.TextureID);
 		// Update content of VBO memory
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices); // Be sure to use glBufferSubData and not glBufferData
@@ -137,6 +141,6 @@ void Text::RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, vec
 		// Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
 		x += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels by 64 to get amount of pixels))
 	}
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::bindVertexArray(0);
+	GLState::bindTexture(GL_TEXTURE_2D, 0);
 }
\ No newline at end of file
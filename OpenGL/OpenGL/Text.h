@@ -25,6 +25,8 @@ private:
 	
 public:
 	void initFonts(std::string fontPath, int WINDOW_HEIGHT, int WINDOW_WIDTH);
+	/* Set the projection of the text for a new window size */
+	void resize(int WINDOW_HEIGHT, int WINDOW_WIDTH);
 	void RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, vec3 color);
 	Shader textShader;
 };
\ No newline at end of file
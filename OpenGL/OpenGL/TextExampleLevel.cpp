@@ -1,4 +1,5 @@
 #include "TextExampleLevel.h"
+#include "GLState.h"
 
 void processInputTextExampleLevel(GLFWwindow *window);
 
@@ -13,11 +14,11 @@ void TextExampleLevel::init(GLFWwindow *window, int WINDOW_HEIGHT, int WINDOW_WI
 	glClearColor(0.0f, 0.2f, 0.3f, 1.0f);
 
 	// Define the viewport dimensions
-	glViewport(0, 0, WINDOW_HEIGHT, WINDOW_WIDTH);
+	GLState::viewport(0, 0, WINDOW_HEIGHT, WINDOW_WIDTH);
 
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::enable(GL_CULL_FACE);
+	GLState::enable(GL_BLEND);
+	GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	//Init fonts and also select a font from fontfile in windows
 	//This might take a while because this program need to calculate every letter in vector graphics
@@ -1,4 +1,6 @@
 #include "Texture.h"
+#include "TextureCache.h"
+#include "CloudVolume.h"
 
 static int active_textures = 0;
 
@@ -8,42 +10,37 @@ Texture::Texture()
 
 Texture::Texture(char const * path)
 {
-	glGenTextures(1, &id);
-
-	int components;
-	unsigned char *data = stbi_load(path, &width, &height, &components, 0);
-	if (!data) {
-		printf("Error: Texture failed to load at path: %s", path);
-		stbi_image_free(data);
-	}
-
-	GLenum format;
-	if (components == 1)
-		format = GL_RED;
-	else if (components == 3)
-		format = GL_RGB;
-	else if (components == 4)
-		format = GL_RGBA;
-
-	// Bind texture and generate mipmap
-	glBindTexture(GL_TEXTURE_2D, id);
-	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	TextureCache::acquire(path, this);
+}
 
-	// Set texture parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+Texture::Texture(char const * path, BlockCompression::Format format)
+{
+	TextureCache::acquire(path, this, format);
+}
 
-	// Free data and unbind texture
-	stbi_image_free(data);
-	glBindTexture(GL_TEXTURE_2D, 0);
+Texture::Texture(const Texture & other)
+	: id(other.id), index(other.index), width(other.width), height(other.height), depth(other.depth)
+{
+	TextureCache::retain(id);
+}
 
+Texture & Texture::operator=(const Texture & other)
+{
+	if (this != &other) {
+		TextureCache::retain(other.id);
+		TextureCache::release(id);
+		id = other.id;
+		index = other.index;
+		width = other.width;
+		height = other.height;
+		depth = other.depth;
+	}
+	return *this;
 }
 
 Texture::~Texture()
 {
+	TextureCache::release(id);
 }
 
 void activateTexture(Texture* t)
@@ -51,44 +48,20 @@ void activateTexture(Texture* t)
 	t->index = active_textures++;
 }
 
-bool createTexture3DFromEX5(Texture* t, const char* file_path)
+bool createTexture3DFromEX5(Texture* t, const char* file_path, std::vector<unsigned char>* density)
 {
-	FILE* fp = fopen(file_path, "r");
-
-	if (fp == NULL) {
-		return false;
-	}
-
-	activateTexture(t);
-
-	/* Read header */
-	fscanf(fp, "%d", &t->width);
-	fscanf(fp, "%d", &t->height);
-	fscanf(fp, "%d", &t->depth);
-
-	/* Create image */
-	std::vector<uint8_t> image;
-	image.reserve(t->width * t->height * t->depth * 4);
-
-	/* Read image*/
-	uint32_t pixel;
-	while (fscanf(fp, "%d", &pixel) == 1) {
-		image.push_back(pixel >> 24);
-		image.push_back(pixel >> 16);
-		image.push_back(pixel >> 8);
-		image.push_back(pixel >> 0);
+	// The text file is converted once to a binary volume next to it, later runs map that file directly.
+	// Without the text file an existing volume file is still used
+	std::string volume_path = std::string(file_path) + ".vol";
+	if (!CloudVolume::upToDate(file_path, volume_path.c_str())) {
+		FILE* fp = fopen(file_path, "r");
+		if (fp != NULL) {
+			fclose(fp);
+			printf("Converting %s to %s...\n", file_path, volume_path.c_str());
+			if (!CloudVolume::convert(file_path, volume_path.c_str()))
+				return false;
+		}
 	}
 
-	glGenTextures(1, &t->id);
-	glBindTexture(GL_TEXTURE_3D, t->id);
-
-	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA, t->width, t->height, t->depth, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
-	glGenerateMipmap(GL_TEXTURE_3D);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
-
-	return true;
-}
\ No newline at end of file
+	return CloudVolume::load(t, volume_path.c_str(), density);
+}
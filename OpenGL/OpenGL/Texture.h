@@ -3,6 +3,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "stb_image.h"
+#include "BlockCompression.h"
 #include <iostream>
 #include <vector>
 
@@ -11,14 +12,20 @@ class Texture
 private:
 public:
 	static unsigned int active_textures;
-	unsigned int id, index;
-	int width, height, depth;
+	unsigned int id = 0, index = 0;
+	int width = 0, height = 0, depth = 0;
 
 	/* Default constructor */
 	Texture();
-	/* Construct texture with image. Specify filepath */
+	/* Construct texture with image. Specify filepath. Images already loaded are shared through TextureCache */
 	Texture(char const * path);
-	/* De-constructor */
+	/* Construct block compressed texture with image. Specify filepath and format */
+	Texture(char const * path, BlockCompression::Format format);
+	/* Copy constructor, shares the GPU texture */
+	Texture(const Texture & other);
+	/* Copy assignment, shares the GPU texture */
+	Texture & operator=(const Texture & other);
+	/* De-constructor, releases the GPU texture when this was the last reference */
 	~Texture();
 };
 
@@ -28,5 +35,6 @@ void activateTexture(Texture * t);
 Author: Rikard Olajos. Texture from noise file generated Rikard Olajos
 https://github.com/rikardolajos/clouds/blob/master/src/texture.cpp
 https://github.com/rikardolajos/noisegen/tree/master/NoiseGen
+The file is converted to a binary CloudVolume (<path>.vol) the first time, which is what gets loaded
 */
-bool createTexture3DFromEX5(Texture * t, const char * file_path);
\ No newline at end of file
+bool createTexture3DFromEX5(Texture * t, const char * file_path, std::vector<unsigned char> * density = nullptr);
\ No newline at end of file
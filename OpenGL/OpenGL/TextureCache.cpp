@@ -0,0 +1,350 @@
+#include "TextureCache.h"
+#include "GLState.h"
+#include "Texture.h"
+#include "MipGenerator.h"
+#include <string.h>
+
+// Header of the <path>.bc<n> files holding a compressed mip chain
+struct CompressedHeader {
+	char magic[4];
+	uint32_t format, width, height, levels;
+	uint64_t source_hash;
+};
+
+TextureCache::Registry & TextureCache::registry()
+{
+	static Registry * registry = new Registry();
+	return *registry;
+}
+
+uint64_t TextureCache::hash(const void * data, size_t size)
+{
+	const unsigned char * bytes = (const unsigned char *)data;
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++) {
+		h ^= bytes[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+int TextureCache::mipFlags(BlockCompression::Format format)
+{
+	// The format tells what the image holds: normal maps are BC5, single channel masks BC4, the rest is color.
+	// Without a format nothing is known, so it is linear data
+	switch (format)
+	{
+	case BlockCompression::NONE: return MipGenerator::LINEAR;
+	case BlockCompression::BC4: return MipGenerator::LINEAR;
+	case BlockCompression::BC5: return MipGenerator::NORMAL_MAP;
+	default: return MipGenerator::SRGB;
+	}
+}
+
+unsigned int TextureCache::upload(const unsigned char * file_data, size_t file_size, uint64_t source_hash, Entry & entry)
+{
+	// Filtered for what was requested, also when it falls back to uncompressed
+	int flags = mipFlags(entry.format);
+	if (entry.format != BlockCompression::NONE) {
+		if (BlockCompression::supported(entry.format))
+			return uploadCompressed(file_data, file_size, source_hash, entry);
+		printf("Warning: BC%d textures not supported by driver, loading %s uncompressed\n", entry.format, entry.path.c_str());
+		entry.format = BlockCompression::NONE;
+	}
+
+	unsigned char *data = stbi_load_from_memory(file_data, (int)file_size, &entry.width, &entry.height, &entry.components, 0);
+	if (!data) {
+		printf("Error: Texture failed to load at path: %s\n", entry.path.c_str());
+		return 0;
+	}
+
+	GLenum format = GL_RGB, internal_format = GL_RGB8;
+	if (entry.components == 1) {
+		format = GL_RED;
+		internal_format = GL_R8;
+	}
+	else if (entry.components == 2) {
+		format = GL_RG;
+		internal_format = GL_RG8;
+	}
+	else if (entry.components == 4) {
+		format = GL_RGBA;
+		internal_format = GL_RGBA8;
+	}
+
+	unsigned int id;
+	glCreateTextures(GL_TEXTURE_2D, 1, &id);
+
+	// Upload the mip chain into immutable storage
+	MipGenerator::upload2D(id, MipGenerator::generate2D(data, entry.width, entry.height, entry.components, MipGenerator::KAISER, flags), internal_format, format);
+
+	// Set texture parameters
+	glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// Free data
+	stbi_image_free(data);
+
+	// Drivers store 1 and 3 component textures padded to 4 bytes per texel, a full mip chain adds 1/3
+	size_t texel_size = (entry.components == 1) ? 1 : 4;
+	entry.bytes = (size_t)entry.width * entry.height * texel_size * 4 / 3;
+
+	return id;
+}
+
+unsigned int TextureCache::uploadCompressed(const unsigned char * file_data, size_t file_size, uint64_t source_hash, Entry & entry)
+{
+	const std::string cache_path = entry.path + ".bc" + std::to_string(entry.format);
+	std::vector<std::vector<unsigned char>> levels;
+
+	if (!readCompressed(cache_path, source_hash, entry, levels)) {
+		std::vector<unsigned char> rgba;
+		{
+			unsigned char *data = stbi_load_from_memory(file_data, (int)file_size, &entry.width, &entry.height, &entry.components, 4);
+			if (!data) {
+				printf("Error: Texture failed to load at path: %s\n", entry.path.c_str());
+				return 0;
+			}
+			rgba.assign(data, data + (size_t)entry.width * entry.height * 4);
+			stbi_image_free(data);
+		}
+
+		// BC1 has no real alpha, keep it for images that have one
+		if (entry.format == BlockCompression::BC1 && entry.components == 4)
+			entry.format = BlockCompression::BC3;
+
+		printf("Compressing %s (BC%d)...\n", entry.path.c_str(), entry.format);
+		for (const MipGenerator::Level & level : MipGenerator::generate2D(rgba.data(), entry.width, entry.height, 4, MipGenerator::KAISER, mipFlags(entry.format)))
+			levels.push_back(BlockCompression::compress(level.data.data(), level.width, level.height, entry.format));
+		writeCompressed(cache_path, source_hash, entry, levels);
+	}
+
+	unsigned int id;
+	glCreateTextures(GL_TEXTURE_2D, 1, &id);
+	glTextureStorage2D(id, (GLsizei)levels.size(), BlockCompression::glFormat(entry.format), entry.width, entry.height);
+
+	// Upload the whole mip chain, glGenerateMipmap does not work on compressed textures
+	entry.bytes = 0;
+	int width = entry.width, height = entry.height;
+	for (size_t level = 0; level < levels.size(); level++) {
+		glCompressedTextureSubImage2D(id, (GLint)level, 0, 0, width, height, BlockCompression::glFormat(entry.format), (GLsizei)levels[level].size(), levels[level].data());
+		entry.bytes += levels[level].size();
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	// Single channel maps are read as grey in the shaders (vec3(texture(...)))
+	if (entry.format == BlockCompression::BC4) {
+		glTextureParameteri(id, GL_TEXTURE_SWIZZLE_G, GL_RED);
+		glTextureParameteri(id, GL_TEXTURE_SWIZZLE_B, GL_RED);
+	}
+
+	// Set texture parameters
+	glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return id;
+}
+
+bool TextureCache::readCompressed(const std::string & cache_path, uint64_t source_hash, Entry & entry, std::vector<std::vector<unsigned char>> & levels)
+{
+	FILE* input_file = fopen(cache_path.c_str(), "rb");
+	if (input_file == NULL)
+		return false;
+
+	CompressedHeader header;
+	bool valid = fread(&header, sizeof(header), 1, input_file) == 1
+		&& memcmp(header.magic, "BCC2", 4) == 0
+		&& header.source_hash == source_hash
+		&& header.levels > 0 && header.levels <= 32;
+
+	int width = header.width, height = header.height;
+	for (uint32_t level = 0; valid && level < header.levels; level++) {
+		std::vector<unsigned char> data(BlockCompression::compressedSize((BlockCompression::Format)header.format, width, height));
+		valid = fread(data.data(), 1, data.size(), input_file) == data.size();
+		levels.push_back(std::move(data));
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+	fclose(input_file);
+
+	if (!valid) {
+		levels.clear();
+		return false;
+	}
+	entry.format = (BlockCompression::Format)header.format;
+	entry.width = header.width;
+	entry.height = header.height;
+	entry.components = (entry.format == BlockCompression::BC4) ? 1 : (entry.format == BlockCompression::BC5) ? 2 : 4;
+	return true;
+}
+
+void TextureCache::writeCompressed(const std::string & cache_path, uint64_t source_hash, const Entry & entry, const std::vector<std::vector<unsigned char>> & levels)
+{
+	FILE* output_file = fopen(cache_path.c_str(), "wb");
+	if (output_file == NULL) {
+		printf("Warning: Unable to write texture cache: %s\n", cache_path.c_str());
+		return;
+	}
+
+	CompressedHeader header;
+	memcpy(header.magic, "BCC2", 4);
+	header.format = entry.format;
+	header.width = entry.width;
+	header.height = entry.height;
+	header.levels = (uint32_t)levels.size();
+	header.source_hash = source_hash;
+	fwrite(&header, sizeof(header), 1, output_file);
+	for (const auto & level : levels)
+		fwrite(level.data(), 1, level.size(), output_file);
+	fclose(output_file);
+}
+
+bool TextureCache::acquire(const char * path, Texture * t, BlockCompression::Format format)
+{
+	Registry & r = registry();
+	const std::string key = (format == BlockCompression::NONE) ? std::string(path) : std::string(path) + "|bc" + std::to_string(format);
+
+	// Same path as an earlier load, no need to touch the file at all
+	auto by_path = r.paths.find(key);
+	if (by_path != r.paths.end()) {
+		const Entry & entry = r.entries[by_path->second];
+		t->id = by_path->second;
+		t->width = entry.width;
+		t->height = entry.height;
+		retain(t->id);
+		return true;
+	}
+
+	FILE* input_file = fopen(path, "rb");
+	if (input_file == NULL) {
+		printf("Error: Texture failed to load at path: %s\n", path);
+		return false;
+	}
+	fseek(input_file, 0, SEEK_END);
+	long input_file_size = ftell(input_file);
+	rewind(input_file);
+	std::vector<unsigned char> file_data(input_file_size > 0 ? input_file_size : 0);
+	fread(file_data.data(), sizeof(unsigned char), file_data.size(), input_file);
+	fclose(input_file);
+
+	// Same content under another path (copied files), share the texture that is already on the GPU
+	uint64_t source_hash = hash(file_data.data(), file_data.size());
+	uint64_t content_hash = source_hash ^ ((uint64_t)format * 0x9E3779B97F4A7C15ULL);
+	auto by_hash = r.hashes.find(content_hash);
+	if (by_hash != r.hashes.end()) {
+		const Entry & entry = r.entries[by_hash->second];
+		r.paths[key] = by_hash->second;
+		t->id = by_hash->second;
+		t->width = entry.width;
+		t->height = entry.height;
+		retain(t->id);
+		return true;
+	}
+
+	Entry entry;
+	entry.path = path;
+	entry.hash = content_hash;
+	entry.format = format;
+	unsigned int id = upload(file_data.data(), file_data.size(), source_hash, entry);
+	if (id == 0)
+		return false;
+
+	entry.references = 1;
+	r.entries[id] = entry;
+	r.paths[key] = id;
+	r.hashes[content_hash] = id;
+
+	t->id = id;
+	t->width = entry.width;
+	t->height = entry.height;
+	return true;
+}
+
+void TextureCache::retain(unsigned int id)
+{
+	if (id == 0)
+		return;
+	Registry & r = registry();
+	auto it = r.entries.find(id);
+	if (it != r.entries.end())
+		it->second.references++;
+}
+
+void TextureCache::release(unsigned int id)
+{
+	if (id == 0)
+		return;
+	Registry & r = registry();
+	auto it = r.entries.find(id);
+	if (it == r.entries.end())
+		return;
+
+	if (--it->second.references > 0)
+		return;
+
+	// Last user is gone, forget every path that pointed at this texture and free the GPU memory
+	for (auto p = r.paths.begin(); p != r.paths.end();) {
+		if (p->second == id) p = r.paths.erase(p);
+		else ++p;
+	}
+	r.hashes.erase(it->second.hash);
+	r.entries.erase(it);
+
+	if (r.alive)
+		GLState::deleteTextures(1, &id);
+}
+
+unsigned int TextureCache::references(unsigned int id)
+{
+	Registry & r = registry();
+	auto it = r.entries.find(id);
+	return (it != r.entries.end()) ? it->second.references : 0;
+}
+
+size_t TextureCache::count()
+{
+	return registry().entries.size();
+}
+
+size_t TextureCache::residentBytes(unsigned int id)
+{
+	Registry & r = registry();
+	auto it = r.entries.find(id);
+	return (it != r.entries.end()) ? it->second.bytes : 0;
+}
+
+size_t TextureCache::residentBytes()
+{
+	size_t total = 0;
+	for (const auto & e : registry().entries)
+		total += e.second.bytes;
+	return total;
+}
+
+void TextureCache::printResident()
+{
+	for (const auto & e : registry().entries) {
+		std::string format = e.second.format ? "BC" + std::to_string(e.second.format) : "raw";
+		printf("  %-50s %5dx%-5d %-4s %8.2f MB  (%u refs)\n", e.second.path.c_str(), e.second.width, e.second.height,
+			format.c_str(), e.second.bytes / (1024.0 * 1024.0), e.second.references);
+	}
+	printf("Textures resident: %zu, %.2f MB\n", count(), residentBytes() / (1024.0 * 1024.0));
+}
+
+void TextureCache::shutdown()
+{
+	Registry & r = registry();
+	for (auto & e : r.entries) {
+		unsigned int id = e.first;
+		GLState::deleteTextures(1, &id);
+	}
+	r.entries.clear();
+	r.paths.clear();
+	r.hashes.clear();
+	r.alive = false;
+}
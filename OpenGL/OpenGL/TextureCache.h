@@ -0,0 +1,74 @@
+#pragma once
+#define _CRT_SECURE_NO_DEPRECATE
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "BlockCompression.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Texture;
+
+/*
+Registry of all image textures loaded from disk. Textures are keyed by file path and by a hash of the
+file contents, so the same image is only decoded and uploaded once no matter how many materials or levels
+ask for it. Every Texture object holding a registered id counts as one reference, and the GPU texture is
+deleted when the last reference goes away.
+
+Textures can be requested block compressed. The compressed mip chain is encoded on the CPU the first time and
+written next to the image as <path>.bc<n>, later loads upload it directly if the image has not changed.
+*/
+class TextureCache
+{
+private:
+	struct Entry {
+		std::string path;
+		// Content hash mixed with the format, a file loaded with two formats gives two textures
+		uint64_t hash = 0;
+		unsigned int references = 0;
+		int width = 0, height = 0, components = 0;
+		BlockCompression::Format format = BlockCompression::NONE;
+		size_t bytes = 0;
+	};
+	struct Registry {
+		std::unordered_map<unsigned int, Entry> entries;
+		std::unordered_map<std::string, unsigned int> paths;
+		std::unordered_map<uint64_t, unsigned int> hashes;
+		bool alive = true;
+	};
+	/* The registry is never destroyed, so textures released during static destruction stay safe */
+	static Registry & registry();
+	/* Returns the MipGenerator flags for what a map requested in a format holds: color, normals or linear data */
+	static int mipFlags(BlockCompression::Format format);
+	/* Decode image data and upload it to a new GL texture. Returns 0 on failure */
+	static unsigned int upload(const unsigned char * file_data, size_t file_size, uint64_t source_hash, Entry & entry);
+	/* Upload a block compressed mip chain, from the disk cache or encoded now. Returns 0 on failure */
+	static unsigned int uploadCompressed(const unsigned char * file_data, size_t file_size, uint64_t source_hash, Entry & entry);
+	/* Read a compressed mip chain written by writeCompressed. Fails if the source image has changed */
+	static bool readCompressed(const std::string & cache_path, uint64_t source_hash, Entry & entry, std::vector<std::vector<unsigned char>> & levels);
+	/* Write a compressed mip chain to disk */
+	static void writeCompressed(const std::string & cache_path, uint64_t source_hash, const Entry & entry, const std::vector<std::vector<unsigned char>> & levels);
+public:
+	/* Hash a block of memory (64-bit FNV-1a) */
+	static uint64_t hash(const void * data, size_t size);
+	/* Load texture at path (or share an already loaded one) and make t reference it */
+	static bool acquire(const char * path, Texture * t, BlockCompression::Format format = BlockCompression::NONE);
+	/* Add a reference to a registered texture. Unregistered ids are ignored */
+	static void retain(unsigned int id);
+	/* Remove a reference to a registered texture, deleting it on the GPU when none are left */
+	static void release(unsigned int id);
+	/* Returns the number of references held to a registered texture */
+	static unsigned int references(unsigned int id);
+	/* Returns the number of textures resident on the GPU */
+	static size_t count();
+	/* Returns the estimated VRAM used by one registered texture (including mipmaps) */
+	static size_t residentBytes(unsigned int id);
+	/* Returns the estimated VRAM used by all registered textures (including mipmaps) */
+	static size_t residentBytes();
+	/* Print every resident texture with its size and reference count */
+	static void printResident();
+	/* Delete all GPU textures before the GL context is destroyed. Later releases become no-ops */
+	static void shutdown();
+};
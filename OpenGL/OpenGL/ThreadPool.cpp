@@ -0,0 +1,97 @@
+#include "ThreadPool.h"
+
+// Set on pool workers, so tasks that call parallelFor again do not wait on themselves
+static thread_local bool is_worker = false;
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+	for (unsigned int i = 0; i < threads; i++)
+		workers.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto & worker : workers)
+		worker.join();
+}
+
+ThreadPool & ThreadPool::instance()
+{
+	static ThreadPool pool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0);
+	return pool;
+}
+
+unsigned int ThreadPool::size() const
+{
+	return (unsigned int)workers.size() + 1;
+}
+
+void ThreadPool::work(Job & job)
+{
+	// The task is only called for an index below end, so the caller is still waiting and the task still exists
+	int i;
+	while ((i = job.next.fetch_add(1)) < job.end) {
+		(*job.task)(i);
+		if (job.remaining.fetch_sub(1) == 1) {
+			std::lock_guard<std::mutex> lock(wake_mutex);
+			done.notify_all();
+		}
+	}
+}
+
+void ThreadPool::run()
+{
+	is_worker = true;
+	unsigned int seen = 0;
+	while (true) {
+		std::shared_ptr<Job> current;
+		{
+			std::unique_lock<std::mutex> lock(wake_mutex);
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) return;
+			seen = generation;
+			current = job;
+		}
+		if (current)
+			work(*current);
+	}
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int)> & task)
+{
+	if (begin >= end)
+		return;
+
+	// Run inline when there is nothing to gain or the pool is already busy (nested call)
+	std::unique_lock<std::mutex> job_lock(job_mutex, std::defer_lock);
+	if (workers.empty() || end - begin == 1 || is_worker || !job_lock.try_lock()) {
+		for (int i = begin; i < end; i++)
+			task(i);
+		return;
+	}
+
+	std::shared_ptr<Job> current = std::make_shared<Job>();
+	current->task = &task;
+	current->next = begin;
+	current->end = end;
+	current->remaining = end - begin;
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		job = current;
+		generation++;
+	}
+	wake.notify_all();
+
+	// The calling thread helps out instead of sleeping
+	work(*current);
+
+	// Wait for the last index. Workers still holding the job find it empty and let go of it
+	std::unique_lock<std::mutex> lock(wake_mutex);
+	done.wait(lock, [&] { return current->remaining.load() == 0; });
+	job.reset();
+}
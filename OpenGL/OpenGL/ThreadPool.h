@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Fixed set of worker threads used by the CPU side asset processing (texture compression, mipmaps, noise, clouds).
+parallelFor splits a range of indices over the workers and the calling thread, and returns when all are done.
+Only one parallelFor runs on the pool at a time. Nested or concurrent calls run serially on the calling thread,
+so a task is always allowed to call parallelFor itself.
+*/
+class ThreadPool
+{
+private:
+	/* One parallelFor. A worker keeps the job it joined, so a late worker can only find it empty, never the next one */
+	struct Job {
+		const std::function<void(int)> * task;
+		std::atomic<int> next, remaining;
+		int end;
+	};
+	std::vector<std::thread> workers;
+	std::mutex job_mutex, wake_mutex;
+	std::condition_variable wake, done;
+	std::shared_ptr<Job> job;
+	unsigned int generation = 0;
+	bool stopping = false;
+	/* Pick indices from a job until it is empty */
+	void work(Job & job);
+	/* Worker thread main loop */
+	void run();
+public:
+	/* Create pool with the given number of worker threads (0 runs everything on the calling thread) */
+	ThreadPool(unsigned int threads);
+	/* De-constructor, joins all worker threads */
+	~ThreadPool();
+	/* Returns the shared pool, sized after the number of hardware threads */
+	static ThreadPool & instance();
+	/* Returns the number of threads that take part in a parallelFor (workers + caller) */
+	unsigned int size() const;
+	/* Run task(i) for every i in [begin, end) and wait for all of them to finish */
+	void parallelFor(int begin, int end, const std::function<void(int)> & task);
+};
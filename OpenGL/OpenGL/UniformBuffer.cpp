@@ -0,0 +1,101 @@
+#include "UniformBuffer.h"
+#include <stdio.h>
+#include <string.h>
+
+bool UniformBuffer::init(unsigned int binding, size_t size, GLenum target)
+{
+	remove();
+	if (!GLEW_VERSION_4_5 && !GLEW_ARB_direct_state_access)
+		return false;
+
+	// Every region starts at an offset the binding accepts
+	GLint alignment = 256;
+	glGetIntegerv(target == GL_SHADER_STORAGE_BUFFER ? GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT : GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	this->target = target;
+	this->binding = binding;
+	this->size = size;
+	stride = (size + alignment - 1) / alignment * alignment;
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, stride * REGIONS, nullptr, flags);
+	memory = (unsigned char *)glMapNamedBufferRange(buffer, 0, stride * REGIONS, flags);
+	if (memory == nullptr) {
+		printf("Error: Failed to map uniform buffer %u\n", binding);
+		remove();
+		return false;
+	}
+	return true;
+}
+
+void * UniformBuffer::beginWrite()
+{
+	if (memory == nullptr)
+		return nullptr;
+
+	// The draws that read the last region have all been issued by now
+	if (current >= 0)
+		fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	current = (current + 1) % REGIONS;
+
+	if (fences[current] != 0) {
+		// Only waits when the GPU is more than REGIONS - 1 frames behind
+		GLenum result = glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		glDeleteSync(fences[current]);
+		fences[current] = 0;
+	}
+	return memory + current * stride;
+}
+
+void UniformBuffer::endWrite()
+{
+	if (memory == nullptr)
+		return;
+	glBindBufferRange(target, binding, buffer, current * stride, size);
+}
+
+void UniformBuffer::write(const void * data)
+{
+	void * region = beginWrite();
+	if (region == nullptr)
+		return;
+	memcpy(region, data, size);
+	endWrite();
+}
+
+int UniformBuffer::region() const
+{
+	return current;
+}
+
+void UniformBuffer::remove()
+{
+	for (int i = 0; i < REGIONS; i++) {
+		if (fences[i] != 0)
+			glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	if (buffer != 0) {
+		glBindBuffer(target, buffer);
+		if (memory != nullptr)
+			glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+		glDeleteBuffers(1, &buffer);
+	}
+	buffer = 0;
+	memory = nullptr;
+	current = -1;
+}
+
+CameraBlock::CameraBlock(const mat4 & view, const mat4 & projection, const vec3 & position)
+{
+	memcpy(this->view, view.matrix, sizeof(this->view));
+	memcpy(this->projection, projection.matrix, sizeof(this->projection));
+	memcpy(sky_view, mat4::removeTranslation(view).matrix, sizeof(sky_view));
+	this->position[0] = position.x;
+	this->position[1] = position.y;
+	this->position[2] = position.z;
+	this->position[3] = 1.0f;
+}
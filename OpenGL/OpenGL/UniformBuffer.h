@@ -0,0 +1,49 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "maths.h"
+#include <stddef.h>
+
+/*
+Uniform buffer that every program shares through a fixed binding point, layout(std140, binding = ...) in the shaders.
+It can be a shader storage buffer as well, for data that is too large for a uniform block.
+
+The buffer is mapped once for its whole life. It has a region for every frame in flight: the CPU writes the next region
+while the GPU may still read the others, and a fence makes sure the GPU is done with a region before it is written again.
+*/
+class UniformBuffer
+{
+public:
+	static const unsigned int CAMERA_BINDING = 0;
+	static const unsigned int LIGHT_BINDING = 1;
+	static const int REGIONS = 3;
+	/* Create the buffer with a region of size bytes per frame in flight. Returns false when it can not be mapped */
+	bool init(unsigned int binding, size_t size, GLenum target = GL_UNIFORM_BUFFER);
+	/* Move to the next region and wait until the GPU is done with it. Returns where to write, nullptr without a buffer */
+	void * beginWrite();
+	/* Bind the written region to the binding point, for the draws that follow */
+	void endWrite();
+	/* Write all of the next region and bind it */
+	void write(const void * data);
+	/* Returns the region that was written last */
+	int region() const;
+	/* Delete the buffer and the fences */
+	void remove();
+private:
+	unsigned int buffer = 0, binding = 0;
+	GLenum target = GL_UNIFORM_BUFFER;
+	size_t size = 0, stride = 0;
+	unsigned char * memory = nullptr;
+	GLsync fences[REGIONS] = { 0, 0, 0 };
+	int current = -1;
+};
+
+/* The Camera block of the shaders, written once a frame */
+struct CameraBlock
+{
+	float view[16];
+	float projection[16];
+	float sky_view[16];	// The view without its translation, for the sky box
+	float position[4];
+	CameraBlock(const mat4 & view, const mat4 & projection, const vec3 & position);
+};
@@ -1,5 +1,6 @@
 #pragma once 
 #include "VegardLevel.h"
+#include "GLState.h"
 #include "Shader.h"
 
 #if 0
@@ -74,8 +75,8 @@ namespace Vegard {
 		// Tell GLFW to capture the players mouse
 		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GLState::enable(GL_BLEND);
+		GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 		//Init fonts
 		text.initFonts("C:/Windows/Fonts/Arial.ttf", WINDOW_HEIGHT, WINDOW_WIDTH);
@@ -107,24 +108,24 @@ namespace Vegard {
 			"resources/skybox/front.jpg"
 		);
 
-		sunTexture.addDiffuse(Texture("resources/textures/sun1.jpg"));
-		sunTexture.addSpecular(Texture("resources/textures/1857-specexponent.jpg"));
-		sunTexture.addNormal(Texture("resources/textures/1857-normal.jpg"));
+		sunTexture.addDiffuse("resources/textures/sun1.jpg");
+		sunTexture.addSpecular("resources/textures/1857-specexponent.jpg");
+		sunTexture.addNormal("resources/textures/1857-normal.jpg");
 
-		groundTexture.addDiffuse(Texture("resources/textures/10744-diffuse.jpg"));
-		groundTexture.addSpecular(Texture("resources/textures/10744-specstrength.jpg"));
-		groundTexture.addNormal(Texture("resources/textures/10744-normal.jpg"));
-		groundTexture.addAmbientOcclusion(Texture("resources/textures/10744-ambientocclusion.jpg"));
+		groundTexture.addDiffuse("resources/textures/10744-diffuse.jpg");
+		groundTexture.addSpecular("resources/textures/10744-specstrength.jpg");
+		groundTexture.addNormal("resources/textures/10744-normal.jpg");
+		groundTexture.addAmbientOcclusion("resources/textures/10744-ambientocclusion.jpg");
 
-		mixedstone.addDiffuse(Texture("resources/textures/mixedstones-diffuse.jpg"));
-		mixedstone.addSpecular(Texture("resources/textures/mixedstones-specular.jpg"));
-		mixedstone.addNormal(Texture("resources/textures/mixedstones-normal.jpg"));
-		mixedstone.addDisplacement(Texture("resources/textures/mixedstones-displace.jpg"));
+		mixedstone.addDiffuse("resources/textures/mixedstones-diffuse.jpg");
+		mixedstone.addSpecular("resources/textures/mixedstones-specular.jpg");
+		mixedstone.addNormal("resources/textures/mixedstones-normal.jpg");
+		mixedstone.addDisplacement("resources/textures/mixedstones-displace.jpg");
 
-		metal.addDiffuse(Texture("resources/textures/1857-diffuse.jpg"));
-		metal.addSpecular(Texture("resources/textures/1857-specexponent.jpg"));
-		metal.addNormal(Texture("resources/textures/1857-normal.jpg"));
-		metal.addDisplacement(Texture("resources/textures/1857-displacement.jpg"));
+		metal.addDiffuse("resources/textures/1857-diffuse.jpg");
+		metal.addSpecular("resources/textures/1857-specexponent.jpg");
+		metal.addNormal("resources/textures/1857-normal.jpg");
+		metal.addDisplacement("resources/textures/1857-displacement.jpg");
 
 		
 
@@ -200,7 +201,7 @@ namespace Vegard {
 		//angle += 0.5f;
 
 		// Draw cubemap (this must AFTER all other objects last or it will decrease peformance)
-		cubemap.drawCubemap(&cubeMapShader, &player.camera, projection);
+		cubemap.drawCubemap(&cubeMapShader);
 
 		// GLFW: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwSwapBuffers(window);
@@ -268,7 +269,7 @@ namespace Vegard {
 	// GLFW: whenever the window size changes, this callback function executes
 	void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	{
-		glViewport(0, 0, width, height);
+		GLState::viewport(0, 0, width, height);
 	}
 
 	// GLFW: whenever the mouse moves, this callback is called
@@ -1,4 +1,5 @@
 #include "Vertex.h"
+#include "GLState.h"
 
 Vertex::Vertex(const std::vector<vec3>& vertices, const std::vector<vec3>& normals, const std::vector<vec3>& colors, const std::vector<vec2>& uvs, const std::vector<vec3>& tangents, const std::vector<vec3>& bitangents, const std::vector<unsigned int>& indices)
 {
@@ -158,56 +159,50 @@ bool Vertex::storeOnGPU()
 {
 	if (hasVertices())
 	{
-		glGenVertexArrays(1, &VAO); // Create VAO that stores the buffer objects.
-		glGenBuffers(1, &VBO); // Create VBO that stores vertex data
-		glGenBuffers(1, &EBO); // Create EBO that stores indices
-		glBindVertexArray(VAO); // Bind the VAO before binding and configuring buffers
-		glBindBuffer(GL_ARRAY_BUFFER, VBO); // Bind the VBO to the GL_ARRAY_BUFFER target								
-		// Copy vertex data into the VBO currently bound to the GL_ARRAY_BUFFER target
-		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * dataSize(), data().data(), GL_STATIC_DRAW);
+		// The objects are created and filled directly, nothing is bound to edit them
+		glCreateVertexArrays(1, &VAO); // Create VAO that stores the buffer objects.
+		glCreateBuffers(1, &VBO); // Create VBO that stores vertex data
+		// Copy vertex data into the VBO, its size is fixed and it is never written again
+		glNamedBufferStorage(VBO, sizeof(float) * dataSize(), data().data(), 0);
 
+		// Every attribute reads from the VBO at binding point 0
 		const unsigned int stride = this->stride() * sizeof(float);
+		glVertexArrayVertexBuffer(VAO, 0, VBO, 0, stride);
 
 		if (hasVertices()) {
 			// Position attribute
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)(verticeStride() * sizeof(float)));
-			glEnableVertexAttribArray(0);
+			attribute(0, 3, verticeStride());
 		}
 		if (hasNormals())
 		{
 			// Normals coordinate attribute
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(normalStride() * sizeof(float)));
-			glEnableVertexAttribArray(1);
+			attribute(1, 3, normalStride());
 		}
 		if (hasColors())
 		{
 			// Colors coordinate attribute
-			glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(colorStride() * sizeof(float)));
-			glEnableVertexAttribArray(2);
+			attribute(2, 3, colorStride());
 		}
 		if (hasUVs())
 		{
 			// Texture coordinate attribute
-			glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void*)(uvStride() * sizeof(float)));
-			glEnableVertexAttribArray(3);
+			attribute(3, 2, uvStride());
 		}
 		if (hasTangents())
 		{
 			// Tangents coordinate attribute
-			glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)(tangentStride() * sizeof(float)));
-			glEnableVertexAttribArray(4);
+			attribute(4, 3, tangentStride());
 		}
 		if (hasBitangents())
 		{
 			// Tangents coordinate attribute
-			glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, stride, (void*)(bitangentStride() * sizeof(float)));
-			glEnableVertexAttribArray(5);
+			attribute(5, 3, bitangentStride());
 		}
 		if (hasIndices()) {
-			// Bind the EBO to the GL_ELEMENT_ARRAY_BUFFER target
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-			// Copy indices data into the EBO currently bound to the GL_ELEMENT_ARRAY_BUFFER target
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+			// Create the EBO with the indices and attach it to the VAO
+			glCreateBuffers(1, &EBO);
+			glNamedBufferStorage(EBO, sizeof(unsigned int) * indices.size(), indices.data(), 0);
+			glVertexArrayElementBuffer(VAO, EBO);
 		}
 
 		storedOnGPU = true;
@@ -220,6 +215,13 @@ bool Vertex::storeOnGPU()
 	}
 }
 
+void Vertex::attribute(unsigned int location, int components, unsigned int offset)
+{
+	glEnableVertexArrayAttrib(VAO, location);
+	glVertexArrayAttribFormat(VAO, location, components, GL_FLOAT, GL_FALSE, offset * sizeof(float));
+	glVertexArrayAttribBinding(VAO, location, 0);
+}
+
 void Vertex::setDrawMode(GLenum mode)
 {
 	draw_mode = mode;
@@ -234,10 +236,11 @@ bool Vertex::drawObject(const Shader * shader, const vec3 &position, const vec3
 {
 	if (storedOnGPU)
 	{
+		shader->use();
 		// Bind textures if if it points to a texture
 		if (material != nullptr) material->bind();
 		// Bind VAO
-		glBindVertexArray(VAO);
+		GLState::bindVertexArray(VAO);
 		// Calculate the model matrix for each object and pass it to shader before drawing
 		mat4 translate = mat4::makeTranslate(position);
 		mat4 rotate = mat4::makeRotate(rotation_degrees, rotation_vector);
@@ -253,8 +256,7 @@ bool Vertex::drawObject(const Shader * shader, const vec3 &position, const vec3
 			glDrawElements(draw_mode, indices.size(), GL_UNSIGNED_INT, 0);
 		else
 			glDrawArrays(draw_mode, 0, size());
-		// Unbind textures
-		if (material != nullptr) material->unbind();
+		// The textures stay bound, the next material with the same maps does not bind them again
 		return true;
 	}
 	else
@@ -288,7 +290,7 @@ bool Vertex::deAllocate()
 {
 	if (storedOnGPU)
 	{
-		glDeleteVertexArrays(1, &VAO);
+		GLState::deleteVertexArrays(1, &VAO);
 		glDeleteBuffers(1, &VBO);
 		glDeleteBuffers(1, &EBO);
 		return true;
@@ -14,13 +14,15 @@ class Vertex
 private:
 	mat4 scale = mat4::makeIdentity(), rotate = mat4::makeIdentity(), position = mat4::makeIdentity();
 	vec2 uv_scale = vec2(1.0f, 1.0f);
-	unsigned int VBO, VAO, EBO;
+	unsigned int VBO = 0, VAO = 0, EBO = 0;
 	bool storedOnGPU = false, scaleTexture = false;
 	GLenum draw_mode = GL_TRIANGLES;
 	/* Private function: Split up vec3 data into smaller pieces */
 	std::vector<vec3> subdivide(const std::vector<vec3> & vertex_data);
 	/* Private function: Split up vec2 data into smaller pieces */
 	std::vector<vec2> subdivide(const std::vector<vec2> & vertex_data);
+	/* Private function: Enable a float attribute of the VAO, offset floats into the vertex */
+	void attribute(unsigned int location, int components, unsigned int offset);
 protected:
 	/* Set draw mode. Defaults to GL_TRIANGLES */
 	void setDrawMode(GLenum mode);
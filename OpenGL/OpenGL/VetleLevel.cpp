@@ -1,7 +1,9 @@
 #pragma once
 #include "VetleLevel.h"
+#include "GLState.h"
 #include "Material.h"
 #include "Shader.h"
+#include "UniformBuffer.h"
 
 namespace vetle {
 
@@ -41,6 +43,7 @@ namespace vetle {
 	// Shaders
 	Shader cubeMapShader;
 	Shader shader;
+	UniformBuffer camera_buffer;
 
 	void VetleLevel::init(GLFWwindow *window, int WINDOW_HEIGHT, int WINDOW_WIDTH)
 	{
@@ -64,6 +67,7 @@ namespace vetle {
 		// ===========================================================================================
 		cubeMapShader.init("shaders/cubemap_vert.shader", "shaders/cubemap_frag.shader");
 		shader.init("shaders/object_vert.shader", "shaders/obj_one_light_frag.shader");
+		camera_buffer.init(UniformBuffer::CAMERA_BINDING, sizeof(CameraBlock));
 
 		// ===========================================================================================
 		// 3D OBJECTS - Set up vertex data and buffers and configure vertex attributes
@@ -84,14 +88,14 @@ namespace vetle {
 			"resources/skybox/front.jpg"
 		);
 
-		sunTexture.addDiffuse(Texture("resources/textures/sun1.jpg"));
-		sunTexture.addSpecular(Texture("resources/textures/1857-specexponent.jpg"));
-		sunTexture.addNormal(Texture("resources/textures/1857-normal.jpg"));
+		sunTexture.addDiffuse("resources/textures/sun1.jpg");
+		sunTexture.addSpecular("resources/textures/1857-specexponent.jpg");
+		sunTexture.addNormal("resources/textures/1857-normal.jpg");
 
-		groundTexture.addDiffuse(Texture("resources/textures/10744-diffuse.jpg"));
-		groundTexture.addSpecular(Texture("resources/textures/10744-specstrength.jpg"));
-		groundTexture.addNormal(Texture("resources/textures/10744-normal.jpg"));
-		groundTexture.addAmbientOcclusion(Texture("resources/textures/10744-ambientocclusion.jpg"));
+		groundTexture.addDiffuse("resources/textures/10744-diffuse.jpg");
+		groundTexture.addSpecular("resources/textures/10744-specstrength.jpg");
+		groundTexture.addNormal("resources/textures/10744-normal.jpg");
+		groundTexture.addAmbientOcclusion("resources/textures/10744-ambientocclusion.jpg");
 
 	}
 
@@ -128,8 +132,8 @@ namespace vetle {
 		mat4 projection = mat4::makePerspective(camera.Fov, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
 		mat4 view = camera.GetViewMatrix();
 
-		shader.setMat4("projection", projection);
-		shader.setMat4("view", view);
+		CameraBlock camera_block(view, projection, camera.Position);
+		camera_buffer.write(&camera_block);
 
 		// -------------------------------------------------------------------------------------------
 		// DRAW OBJECTS (see Rectangle/Cube class for draw functions)
@@ -142,7 +146,7 @@ namespace vetle {
 		angle += 0.5f;
 		
 		// Draw cubemap (this must AFTER all other objects last or it will decrease peformance)
-		cubemap.drawCubemap(&cubeMapShader, &camera, projection);
+		cubemap.drawCubemap(&cubeMapShader);
 
 		// GLFW: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		glfwSwapBuffers(window);
@@ -190,7 +194,7 @@ namespace vetle {
 	// GLFW: whenever the window size changes, this callback function executes
 	void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	{
-		glViewport(0, 0, width, height);
+		GLState::viewport(0, 0, width, height);
 	}
 
 	// GLFW: whenever the mouse moves, this callback is called
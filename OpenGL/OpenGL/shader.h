@@ -8,6 +8,28 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+Hash of a uniform name (FNV-1a). A name can be hashed in pieces, the hash of one piece is passed on to the next, so
+"lights[" + index + "].color" is hashed without building the string. Constant names are hashed by the compiler.
+*/
+typedef uint32_t UniformHash;
+const UniformHash UNIFORM_HASH_BASIS = 2166136261u;
+const UniformHash UNIFORM_HASH_PRIME = 16777619u;
+
+constexpr UniformHash uniformHash(const char * name, UniformHash hash = UNIFORM_HASH_BASIS)
+{
+	return *name == 0 ? hash : uniformHash(name + 1, (hash ^ (unsigned char)*name) * UNIFORM_HASH_PRIME);
+}
+
+/* Continue a hash with the decimal digits of an array index */
+constexpr UniformHash uniformIndexHash(unsigned int index, UniformHash hash)
+{
+	return index < 10 ? (hash ^ (unsigned char)('0' + index)) * UNIFORM_HASH_PRIME : uniformIndexHash(index % 10, uniformIndexHash(index / 10, hash));
+}
 
 class Shader {
 public:
@@ -18,10 +40,18 @@ public:
 	char fragment_path[256];
 	/* Read from file specified and store in a string */
 	static char * readFile(const char * file_path);
-	/* Initialize vertex and fragment shader. Read the files and compile them. Create shader program. */
+	/* Initialize vertex and fragment shader. Read the files and compile them, or load the program from the cache. Returns -1 on failure */
 	int init(const char* vertex_shader_path, const char* fragment_shader_path);
+	/* Start building a program from vertex and fragment shader with #defines put in after #version, without waiting for
+	the driver to compile it. Several programs started together compile in parallel with KHR_parallel_shader_compile.
+	The variant names the cache file. Call finish() before using it. Returns -1 on failure */
+	int begin(const char* vertex_shader_path, const char* fragment_shader_path, const std::string& defines = std::string(), const std::string& variant = std::string());
+	/* Wait for the program from begin() and check it. Returns -1 on failure */
+	int finish();
+	/* Initialize a compute shader program. Read the file and compile it, or load it from the cache. Returns -1 on failure */
+	int initCompute(const char* compute_shader_path);
 	/* Use this program */
-	void use();
+	void use() const;
 	/* Set uniform: bool */
 	void setBool(const char*, bool value) const;
 	/* Set uniform: bool */
@@ -64,10 +94,69 @@ public:
 	void setMat4(const char*, const mat4 & mat) const;
 	/* Set uniform: mat4 */
 	void setMat4(std::string name, const mat4 & mat) const;
+	/* Set uniform by the hash of its name: bool */
+	void setBool(UniformHash name, bool value) const;
+	/* Set uniform by the hash of its name: int */
+	void setInt(UniformHash name, int value) const;
+	/* Set uniform by the hash of its name: float */
+	void setFloat(UniformHash name, float value) const;
+	/* Set uniform by the hash of its name: vec2 */
+	void setVec2(UniformHash name, const vec2 & value) const;
+	/* Set uniform by the hash of its name: vec3 */
+	void setVec3(UniformHash name, const vec3 & value) const;
+	/* Set uniform by the hash of its name: vec4 */
+	void setVec4(UniformHash name, const vec4 & value) const;
+	/* Set uniform by the hash of its name: mat2 */
+	void setMat2(UniformHash name, const mat2 & mat) const;
+	/* Set uniform by the hash of its name: mat3 */
+	void setMat3(UniformHash name, const mat3 & mat) const;
+	/* Set uniform by the hash of its name: mat4 */
+	void setMat4(UniformHash name, const mat4 & mat) const;
 	/* Set Texture 1D  */
 	void setTexture1D(Texture t, const char* name);
 	/* Set Texture 2D  */
 	void setTexture2D(Texture t, const char* name);
 	/* Set Texture 3D  */
 	void setTexture3D(Texture t, const char* name);
+private:
+	/* Stages compiling and linking since begin(), and the hash the program is cached under */
+	unsigned int pending[2];
+	int pending_count = 0;
+	uint64_t pending_hash = 0;
+	std::string variant;
+	/* Read a file and the files it #includes "file" into source */
+	static bool readSource(const char* file_path, std::string& source, int depth);
+	/* Read a shader and put the defines in after #version */
+	static bool preprocess(const char* file_path, const std::string& defines, std::string& source);
+	/* Start compiling one stage, errors are checked in finish() */
+	static unsigned int compile(GLenum type, const char* source);
+	/* Start linking the pending stages into ID */
+	void link();
+	/* Hash of the sources and the driver that a cached binary has to match */
+	static uint64_t programHash(const char* const* sources, int count);
+	/* Path of the cached binary of this program */
+	std::string cachePath() const;
+	/* Load the program from the cache. Returns false when there is none, or the driver rejects it */
+	bool loadBinary(uint64_t hash);
+	/* Store the linked program in the cache */
+	void saveBinary(uint64_t hash);
+	struct Uniform {
+		GLint location;
+		bool set;	// Whether value holds what the program has
+		unsigned char value[sizeof(float) * 16];
+	};
+	struct UniformSlot {
+		UniformHash hash;
+		int uniform;	// -1 for an empty slot
+	};
+	/* Last value of every active uniform, the GL call is skipped when the same value is set again */
+	mutable std::vector<Uniform> uniforms;
+	/* Open addressing hash table from the name hashes to the uniforms. Arrays are found with and without [0] */
+	std::vector<UniformSlot> table;
+	/* Enumerate the active uniforms of the linked program into the table */
+	void buildUniformTable();
+	/* Returns the uniform with this name hash, nullptr when the program has no such active uniform */
+	Uniform * findUniform(UniformHash hash) const;
+	/* Store the value of a uniform. Returns false when it already had it, or does not exist */
+	bool changed(Uniform * uniform, const void * value, size_t size) const;
 };
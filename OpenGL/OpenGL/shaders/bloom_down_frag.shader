@@ -0,0 +1,49 @@
+#version 450 core
+
+out vec4 fcolor;
+
+in vec2 UVs;
+
+// The scene bright color, or the previous level of the chain
+uniform sampler2D source;
+// Weigh the taps by their brightness, for the first level
+uniform bool karis_average = false;
+
+float karis_weight(vec3 color) {
+	return 1.0 / (1.0 + dot(color, vec3(0.2126, 0.7152, 0.0722)));
+}
+
+// Average of a group of 4 taps, weighted by karis_weight when enabled
+vec3 group(vec3 a, vec3 b, vec3 c, vec3 d) {
+	if (!karis_average) return (a + b + c + d) * 0.25;
+	vec4 sum = vec4(a, 1.0) * karis_weight(a) + vec4(b, 1.0) * karis_weight(b) + vec4(c, 1.0) * karis_weight(c) + vec4(d, 1.0) * karis_weight(d);
+	return sum.rgb / sum.a;
+}
+
+void main() {
+	// 13 taps around the texel of this (half as large) level, from "Next Generation Post Processing in Call of Duty:
+	// Advanced Warfare". Every tap is bilinear, so the filter covers 6x6 texels of the source
+	vec2 texel = 1.0 / textureSize(source, 0);
+	vec3 a = texture(source, UVs + texel * vec2(-2.0, 2.0)).rgb;
+	vec3 b = texture(source, UVs + texel * vec2(0.0, 2.0)).rgb;
+	vec3 c = texture(source, UVs + texel * vec2(2.0, 2.0)).rgb;
+	vec3 d = texture(source, UVs + texel * vec2(-2.0, 0.0)).rgb;
+	vec3 e = texture(source, UVs).rgb;
+	vec3 f = texture(source, UVs + texel * vec2(2.0, 0.0)).rgb;
+	vec3 g = texture(source, UVs + texel * vec2(-2.0, -2.0)).rgb;
+	vec3 h = texture(source, UVs + texel * vec2(0.0, -2.0)).rgb;
+	vec3 i = texture(source, UVs + texel * vec2(2.0, -2.0)).rgb;
+	vec3 j = texture(source, UVs + texel * vec2(-1.0, 1.0)).rgb;
+	vec3 k = texture(source, UVs + texel * vec2(1.0, 1.0)).rgb;
+	vec3 l = texture(source, UVs + texel * vec2(-1.0, -1.0)).rgb;
+	vec3 m = texture(source, UVs + texel * vec2(1.0, -1.0)).rgb;
+
+	// The inner square counts for half, the 4 overlapping outer squares for the other half
+	vec3 result = group(j, k, l, m) * 0.5;
+	result += group(a, b, d, e) * 0.125;
+	result += group(b, c, e, f) * 0.125;
+	result += group(d, e, g, h) * 0.125;
+	result += group(e, f, h, i) * 0.125;
+
+	fcolor = vec4(max(result, vec3(0.0)), 1.0);
+}
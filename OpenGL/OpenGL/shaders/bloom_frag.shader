@@ -8,18 +8,27 @@
 	uniform sampler2D bloom_blur;
 
 	uniform bool bloom;
+	// The bloom texture is a sum of the levels of the bloom chain
+	uniform float bloom_strength = 1.0;
 	uniform float exposure;
+	// HDR_buffer can be smaller than the screen (dynamic resolution), the upscale is sharpened by this much
+	uniform float sharpness = 0.0;
+
+	vec3 sharpen(vec3 center);
 
 	void main() {
 		vec3 result = vec3(0.0);
 		vec3 hdrColor = texture(HDR_buffer, UV).rgb;
+		if (sharpness > 0.0) {
+			hdrColor = sharpen(hdrColor);
+		}
 		vec3 bloomColor = texture(bloom_blur, UV).rgb;
 
 		result += hdrColor;
 
 		if (bloom) {
 			// Add the original scene and the bloom scene together
-			result += bloomColor;
+			result += bloomColor * bloom_strength;
 		}
 
 		// This function will make the result vector vary from 0 to 1 in all rgb colors, depending on the value of exposure.
@@ -29,4 +38,18 @@
 
 		FragColor = vec4(result, 1.0f);
 
+	}
+
+	// Unsharp mask over the texels around the upscaled pixel, kept within their range so edges do not ring
+	vec3 sharpen(vec3 center) {
+		vec2 texel = 1.0 / textureSize(HDR_buffer, 0);
+		vec3 north = texture(HDR_buffer, UV + vec2(0.0, texel.y)).rgb;
+		vec3 south = texture(HDR_buffer, UV - vec2(0.0, texel.y)).rgb;
+		vec3 east = texture(HDR_buffer, UV + vec2(texel.x, 0.0)).rgb;
+		vec3 west = texture(HDR_buffer, UV - vec2(texel.x, 0.0)).rgb;
+
+		vec3 low = min(center, min(min(north, south), min(east, west)));
+		vec3 high = max(center, max(max(north, south), max(east, west)));
+		vec3 average = (north + south + east + west) * 0.25;
+		return clamp(center + (center - average) * sharpness, low, high);
 	}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#version 450 core
+
+out vec4 fcolor;
+
+in vec2 UVs;
+
+// The smaller level of the chain, added onto this one
+uniform sampler2D source;
+// Distance between the taps in texels of the source
+uniform float radius = 1.0;
+
+void main() {
+	// 3x3 tent filter
+	vec2 offset = radius / textureSize(source, 0);
+	vec3 result = texture(source, UVs).rgb * 4.0;
+	result += texture(source, UVs + offset * vec2(0.0, 1.0)).rgb * 2.0;
+	result += texture(source, UVs + offset * vec2(-1.0, 0.0)).rgb * 2.0;
+	result += texture(source, UVs + offset * vec2(1.0, 0.0)).rgb * 2.0;
+	result += texture(source, UVs + offset * vec2(0.0, -1.0)).rgb * 2.0;
+	result += texture(source, UVs + offset * vec2(-1.0, 1.0)).rgb;
+	result += texture(source, UVs + offset * vec2(1.0, 1.0)).rgb;
+	result += texture(source, UVs + offset * vec2(-1.0, -1.0)).rgb;
+	result += texture(source, UVs + offset * vec2(1.0, -1.0)).rgb;
+
+	fcolor = vec4(result / 16.0, 1.0);
+}
@@ -0,0 +1,7 @@
+// Shared by every program, written once a frame
+layout(std140, binding = 0) uniform Camera {
+	mat4 view;
+	mat4 projection;
+	mat4 sky_view;
+	vec4 view_position;
+};
@@ -8,6 +8,20 @@ layout(location = 1) out vec4 bright_color;
 uniform sampler3D cloud_texture;
 uniform sampler3D cloud_structure;
 uniform sampler2D diffuse_buffer;
+// Sparse brick cloudscape (CloudBricks): brick_table holds the atlas slot of every brick, w is 0 when it is not resident
+uniform bool use_bricks = false;
+uniform usampler3D brick_table;
+uniform sampler3D brick_atlas;
+uniform float brick_units = 100.0;
+uniform vec3 brick_atlas_size;
+// Scene depth, and its smallest and largest value for every depth_tile_size^2 tile (DepthTiles). Rays stop at the scene
+uniform sampler2D depth_buffer;
+uniform sampler2D depth_tiles;
+uniform bool use_depth = false;
+uniform int depth_tile_size = 16;
+// Optical depth toward the sun, from CloudLighting. When it is not built the light rays are marched per sample
+uniform sampler3D light_volume;
+uniform bool use_light_volume = false;
 
 uniform vec2 window_size;
 uniform vec3 camera_position;
@@ -19,29 +33,81 @@ uniform mat4 inv_view;
 uniform mat4 inv_proj;
 
 uniform float end = 500.0;
+// Part of the ray that is marched. With the cloud sky the far part is baked into a cubemap and only the near part
+// is marched per pixel. end still sets the length of the light rays
+uniform float start = 0.0;
+uniform float stop = 1e6;
 uniform float coverage = 0.4;
 
+// Temporal mode: march one pixel (pixel_offset) of every block_size^2 block, and write the cloud color and distance
+// instead of the composited scene. cloud_resolve_frag fills in the rest from the previous frames
+uniform bool temporal = false;
+uniform int block_size = 4;
+uniform vec2 pixel_offset = vec2(0.0);
+uniform float step_size = 1.0;
+uniform int frame = 0;
+
 float PI = 3.1415962;
 float PI_r = 0.3183098;
+// Height where cloud_sampling starts to find clouds, rays that stay below it are not marched
+float CLOUD_BASE = 80.0;
+vec3 SKY_COLOR = vec3(0.416, 0.518, 0.694);
 
 float HG(float costheta);
 float phase(vec3 v1, vec3 v2, float t);
 float cloud_coverage(float t);
-float cloud_sampling_lowres(vec3 v, float delta);
+float empty_space(vec3 v, vec3 dir);
 float cloud_sampling(vec3 v, float delta);
+vec4 brick_sampling(vec3 v);
 float cast_scatter_ray(vec3 origin, vec3 dir, float t);
-vec4 cast_ray(vec3 origin, vec3 dir);
+vec4 cast_ray(vec3 origin, vec3 dir, float jitter, float last, out float depth);
+float linear_depth(float depth);
+bool reaches_clouds(vec3 origin, vec3 dir, float last);
 float rand(vec2 co);
+float interleaved_gradient_noise(vec2 pixel);
 
 void main() {
+	// In temporal mode every fragment stands for one pixel of a block
+	vec2 pixel = temporal ? floor(gl_FragCoord.xy) * block_size + pixel_offset + 0.5 : gl_FragCoord.xy;
+
 	// Calculate the ray. based on this: http://antongerdelan.net/opengl/raycasting.html
-	float x = 2.0 * gl_FragCoord.x / window_size.x - 1.0;
-	float y = 2.0 * gl_FragCoord.y / window_size.y - 1.0;
+	float x = 2.0 * pixel.x / window_size.x - 1.0;
+	float y = 2.0 * pixel.y / window_size.y - 1.0;
 	vec4 ray_clip = vec4(vec2(x, y), -1.0, 1.0);
 	vec4 ray_view = vec4((inv_proj * ray_clip).xy, -1.0, 0.0);
 	vec3 ray_world = normalize((inv_view * ray_view).xyz);
 
-	vec4 cloud_color = cast_ray(camera_position, ray_world);
+	// Offset where the samples start along the ray, so the longer temporal steps are spread out over frames
+	float jitter = temporal ? interleaved_gradient_noise(pixel + 5.588238 * float(frame % 64)) : 0.0;
+
+	// Stop the ray at the scene. Tiles with only sky skip reading the depth, and tiles with only geometry too close
+	// to reach the clouds skip the whole ray
+	float last = min(end, stop);
+	if (use_depth) {
+		ivec2 texel = min(ivec2(pixel), ivec2(window_size) - 1);
+		vec2 tile = texelFetch(depth_tiles, texel / depth_tile_size, 0).rg;
+		// Distance along this ray to a view depth
+		float ray_scale = length(ray_view.xyz);
+		if (tile.y < 1.0) {
+			last = min(last, linear_depth(tile.y) * ray_scale);
+		}
+		if (tile.x < 1.0 && reaches_clouds(camera_position, ray_world, last)) {
+			float scene_depth = texelFetch(depth_buffer, texel, 0).r;
+			if (scene_depth < 1.0) last = min(last, linear_depth(scene_depth) * ray_scale);
+		}
+	}
+
+	float depth = last;
+	vec4 cloud_color = vec4(SKY_COLOR, 0.0);
+	if (reaches_clouds(camera_position, ray_world, last)) {
+		cloud_color = cast_ray(camera_position, ray_world, jitter, last, depth);
+	}
+	if (temporal) {
+		fragment_color = cloud_color;
+		bright_color = vec4(depth);
+		return;
+	}
+
 	vec4 diffuse_color = texelFetch(diffuse_buffer, ivec2(gl_FragCoord.xy), 0);
 
 	fragment_color.a = 0.9;
@@ -56,81 +122,78 @@ float rand(vec2 co) {
 	return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
 }
 
-// http://www.iquilezles.org/www/articles/terrainmarching/terrainmarching.htm
-vec4 cast_ray(vec3 origin, vec3 dir) {
-	float delta_large = 3.0;
-	float delta_small = 1.0;
-	float start = gl_DepthRange.near;
+// Jimenez 2014, noise with most of its energy in the high frequencies like blue noise, without a texture
+float interleaved_gradient_noise(vec2 pixel) {
+	return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+// View space depth (distance along the view direction) of a depth buffer value
+float linear_depth(float depth) {
+	vec4 view_position = inv_proj * vec4(0.0, 0.0, depth * 2.0 - 1.0, 1.0);
+	return -view_position.z / view_position.w;
+}
+
+// Whether a ray that ends at last can get up to the clouds
+bool reaches_clouds(vec3 origin, vec3 dir, float last) {
+	return last > start && origin.y + max(dir.y, 0.0) * last > CLOUD_BASE;
+}
 
+// http://www.iquilezles.org/www/articles/terrainmarching/terrainmarching.htm
+vec4 cast_ray(vec3 origin, vec3 dir, float jitter, float last, out float depth) {
+	float delta_small = step_size;
+	float recheck_distance = 3.0;
 	vec4 result = vec4(0.0);
 	vec3 cloud_bright_result = vec3(4.0, 4.0, 4.0);
-	result.rgb = vec3(0.416, 0.518, 0.694);;
+	result.rgb = SKY_COLOR;
 
-	float length_inside = 0.0;
 	bool inside = false;
-	bool looking_for_new_inside = true;
 	int points_inside = 0;
 	vec3 sample_point = origin;
 
-	bool first = false;
-	float delta = delta_large;
-	for (float t = start; t < end; t += delta) {
-		sample_point = origin + dir * t;
+	// Distance to the clouds, weighted by how much every sample adds
+	float depth_sum = 0.0, alpha_sum = 0.0;
 
-		if (first) delta_small = 1.0;
+	float delta = delta_small;
+	for (float t = start; t < last; t += delta) {
+		sample_point = origin + dir * t;
 
 		// Stop rays that already reached full opacity
 		if (result.a >= 1.0) break;
 
-		float alpha = 0.0;
-		float alpha_lowres = 0.0;
 		if (!inside) {
-			alpha_lowres = cloud_sampling_lowres(sample_point, delta);
-
-			if (alpha_lowres > 0.001) inside = true;
-
-			else looking_for_new_inside = true;
-		}
-
-		if (inside) {
-			// Start of a new inside session?
-			if (looking_for_new_inside) {
-				// Move the starting point a large delta backwards
-				t -= delta_large;
-
-				if (t < gl_DepthRange.near) t = gl_DepthRange.near;
-
-				sample_point = origin + dir * t;
-				delta = delta_small;
-				looking_for_new_inside = false;
-				points_inside = 0;
-				first = true;
+			// Jump over the largest empty structure cell around the point
+			float skip = empty_space(sample_point, dir);
+			if (skip > 0.0) {
+				delta = skip;
+				continue;
 			}
-
-			// Comment this line to see cloud structure
-			alpha = cloud_sampling(sample_point, delta);
-			result.a += alpha;
-			result.a = clamp(result.a, 0.0, 1.0);
-			points_inside += 1;
-
-			// Calculate the shadows and the scattering
-			float energy = cast_scatter_ray(sample_point, normalize(sun_position - sample_point), t);
-			float inside_weight = smoothstep(5, 0, points_inside);
-			result.rgb += cloud_bright_result * energy * alpha;
+			inside = true;
+			points_inside = 0;
+			delta = delta_small;
+			t += jitter * delta_small;
+			sample_point = origin + dir * t;
 		}
 
-		// Check next structure block if we are still inside
-		if (inside && (points_inside * delta_small) > delta_large) {
-			alpha_lowres = cloud_sampling_lowres(sample_point, delta);
-			if (alpha_lowres == 0.0) {
-				inside = false;
-				looking_for_new_inside = true;
-				delta = delta_large;
-			}
+		// Comment this line to see cloud structure
+		float alpha = cloud_sampling(sample_point, delta);
+		result.a += alpha;
+		result.a = clamp(result.a, 0.0, 1.0);
+		points_inside += 1;
+		depth_sum += t * alpha;
+		alpha_sum += alpha;
+
+		// Calculate the shadows and the scattering
+		float energy = cast_scatter_ray(sample_point, normalize(sun_position - sample_point), t);
+		result.rgb += cloud_bright_result * energy * alpha;
+
+		// Check the structure again every few samples, and go back to skipping once outside
+		if ((points_inside * delta_small) > recheck_distance) {
+			if (empty_space(sample_point, dir) > 0.0) inside = false;
 			points_inside = 0;
 		}
 	}
 
+	depth = alpha_sum > 0.0 ? depth_sum / alpha_sum : last;
 	return result;
 }
 
@@ -142,9 +205,14 @@ float cast_scatter_ray(vec3 origin, vec3 dir, float t) {
 
 	float phase = phase(dir, vec3(camera_position - origin), t);
 
-	for (float t = 0.0; t < end / 10; t += delta) {
-		sample_point = origin + dir * t;
-		inside += cloud_sampling(sample_point, delta);
+	if (use_light_volume) {
+		inside = texture(light_volume, vec3(origin.x, origin.y - 80, origin.z) / 800).r;
+	}
+	else {
+		for (float t = 0.0; t < end / 10; t += delta) {
+			sample_point = origin + dir * t;
+			inside += cloud_sampling(sample_point, delta);
+		}
 	}
 
 	float scatter = 3 * exp(-0.7 * inside) * (1.0 - exp(-0.8 * inside));
@@ -167,20 +235,56 @@ float cloud_coverage(float t) {
 	return smoothstep(0.35, coverage, t) * t;
 }
 
-float cloud_sampling_lowres(vec3 v, float delta) {
+// Distance along dir to the end of the coarsest empty cell of the structure pyramid around v, 0 when the finest cell is occupied
+float empty_space(vec3 v, vec3 dir) {
 	v.y -= 80;
-	vec4 texture = texture(cloud_structure, v / 800);
-	return texture.r;
+	vec3 uvw = v / 800;
+	for (int level = textureQueryLevels(cloud_structure) - 1; level >= 0; level--) {
+		if (textureLod(cloud_structure, uvw, level).r > 0.0) continue;
+
+		// Leave the cell through the nearest face in the direction of the ray
+		vec3 cells = vec3(textureSize(cloud_structure, level));
+		vec3 position = uvw * cells;
+		vec3 speed = dir * cells / 800;
+		vec3 exit = mix(vec3(1e6), (floor(position) + step(0.0, dir) - position) / speed, greaterThan(abs(speed), vec3(1e-6)));
+		return min(min(exit.x, exit.y), exit.z) + 0.01;
+	}
+	return 0.0;
 }
 
 float cloud_sampling(vec3 v, float delta) {
 
 	v.y -= 80;
 
-	vec4 textureA = texture(cloud_texture, v / 800);
+	vec4 textureA;
+	if (use_bricks) {
+		// The bricks keep red, blue and alpha of the noise
+		vec3 brick = brick_sampling(v).rgb;
+		textureA = vec4(brick.r, 0.0, brick.g, brick.b);
+	}
+	else {
+		textureA = texture(cloud_texture, v / 800);
+	}
 
 	float cloud_coverage = cloud_coverage(textureA.r);
 	float bottom = smoothstep(0, 80, v.y);
 
 	return textureA.r * cloud_coverage * bottom * delta * pow(textureA.b, 0.3) * pow(textureA.a, 0.4);
-}
\ No newline at end of file
+}
+
+// Sample the brick cloudscape at a point above the bottom of the clouds. Bricks that are empty or not paged in are clear
+vec4 brick_sampling(vec3 v) {
+	ivec3 table_size = textureSize(brick_table, 0);
+	vec3 position = v / brick_units;
+	if (position.y < 0.0 || position.y >= float(table_size.y)) return vec4(0.0);
+
+	// The table repeats along x and z, like the weather
+	ivec3 brick = ivec3(floor(position));
+	brick.xz = (brick.xz % table_size.xz + table_size.xz) % table_size.xz;
+	uvec4 slot = texelFetch(brick_table, brick, 0);
+	if (slot.w == 0u) return vec4(0.0);
+
+	// Slots are 18^3 with a one texel border around the 16^3 brick
+	vec3 texel = vec3(slot.xyz) * 18.0 + 1.0 + fract(position) * 16.0;
+	return texture(brick_atlas, texel / brick_atlas_size);
+}
@@ -0,0 +1,52 @@
+#version 450 core
+
+layout(local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+// Optical depth toward the sun from the center of every texel, sampled by cloud_frag instead of cast_scatter_ray's loop
+layout(r16f, binding = 0) uniform writeonly image3D light_volume;
+
+uniform sampler3D cloud_texture;
+
+uniform vec3 sun_direction;
+uniform float coverage = 0.4;
+uniform float end = 500.0;
+
+float cloud_coverage(float t);
+float cloud_sampling(vec3 v, float delta);
+
+void main() {
+	ivec3 texel = ivec3(gl_GlobalInvocationID);
+	ivec3 size = imageSize(light_volume);
+	if (any(greaterThanEqual(texel, size))) return;
+
+	// The volume covers one tile of the noise, starting at the bottom of the clouds
+	vec3 origin = (vec3(texel) + 0.5) / vec3(size) * 800;
+	origin.y += 80;
+
+	// Same light ray as cast_scatter_ray in cloud_frag
+	float delta = 10.0;
+	float inside = 0.0;
+	for (float t = 0.0; t < end / 10; t += delta) {
+		inside += cloud_sampling(origin + sun_direction * t, delta);
+	}
+
+	imageStore(light_volume, texel, vec4(inside));
+}
+
+// Same as cloud_frag
+float cloud_coverage(float t) {
+	return smoothstep(0.35, coverage, t) * t;
+}
+
+// Same as cloud_frag
+float cloud_sampling(vec3 v, float delta) {
+
+	v.y -= 80;
+
+	vec4 textureA = texture(cloud_texture, v / 800);
+
+	float cloud_coverage = cloud_coverage(textureA.r);
+	float bottom = smoothstep(0, 80, v.y);
+
+	return textureA.r * cloud_coverage * bottom * delta * pow(textureA.b, 0.3) * pow(textureA.a, 0.4);
+}
@@ -0,0 +1,105 @@
+#version 450 core
+
+layout(location = 0) in vec3 vertex_position;
+
+layout(location = 0) out vec4 history_color;
+layout(location = 1) out float history_depth;
+layout(location = 2) out vec4 fragment_color;
+layout(location = 3) out vec4 bright_color;
+
+// One marched pixel per block, from cloud_frag in temporal mode
+uniform sampler2D march_color;
+uniform sampler2D march_depth;
+// The resolved clouds of the previous frame
+uniform sampler2D previous_color;
+uniform sampler2D previous_depth;
+uniform sampler2D diffuse_buffer;
+
+uniform vec2 window_size;
+uniform int block_size = 4;
+uniform vec2 pixel_offset = vec2(0.0);
+uniform bool history_valid = false;
+
+uniform vec3 camera_position;
+uniform vec3 previous_camera_position;
+uniform mat4 inv_view;
+uniform mat4 inv_proj;
+uniform mat4 previous_view;
+uniform mat4 previous_proj;
+
+// Largest relative change in cloud distance that still counts as the same clouds
+float DEPTH_TOLERANCE = 0.1;
+
+vec3 ray_direction(vec2 pixel);
+vec4 reproject(ivec2 block, vec4 current, float depth, out float reprojected_depth);
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 block = pixel / block_size;
+
+	vec4 cloud = texelFetch(march_color, block, 0);
+	float depth = texelFetch(march_depth, block, 0).r;
+
+	// Pixels that were not marched this frame are taken from the history when it can be trusted
+	bool marched = all(equal(pixel % block_size, ivec2(pixel_offset)));
+	if (history_valid && !marched) {
+		float reprojected_depth;
+		vec4 reprojected = reproject(block, cloud, depth, reprojected_depth);
+		if (reprojected.a >= 0.0) {
+			cloud = reprojected;
+			depth = reprojected_depth;
+		}
+	}
+
+	history_color = cloud;
+	history_depth = depth;
+
+	vec4 diffuse_color = texelFetch(diffuse_buffer, pixel, 0);
+
+	fragment_color.a = 0.9;
+	fragment_color.rgb = mix(diffuse_color.rgb, cloud.rgb, cloud.a)*0.8;
+
+	// The framebuffer is not cleared, so bright_color is always written
+	bright_color = vec4(0.0);
+	if (dot(fragment_color.rgb, vec3(0.1126, 0.3152, 0.0722)) > 500.0) {
+		bright_color = vec4(fragment_color.rgb, 1.0);
+	}
+}
+
+// Same ray as cloud_frag
+vec3 ray_direction(vec2 pixel) {
+	float x = 2.0 * pixel.x / window_size.x - 1.0;
+	float y = 2.0 * pixel.y / window_size.y - 1.0;
+	vec4 ray_clip = vec4(vec2(x, y), -1.0, 1.0);
+	vec4 ray_view = vec4((inv_proj * ray_clip).xy, -1.0, 0.0);
+	return normalize((inv_view * ray_view).xyz);
+}
+
+// Look up where the clouds seen through this pixel were on the previous frame. Returns alpha -1 when the history
+// has to be rejected (outside the previous view, or a different distance which means it showed other clouds)
+vec4 reproject(ivec2 block, vec4 current, float depth, out float reprojected_depth) {
+	reprojected_depth = depth;
+
+	vec3 point = camera_position + ray_direction(gl_FragCoord.xy) * depth;
+	vec3 previous_dir = normalize(point - previous_camera_position);
+	vec4 clip = previous_proj * (previous_view * vec4(previous_dir, 0.0));
+	if (clip.w <= 0.0) return vec4(-1.0);
+
+	vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+	if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) return vec4(-1.0);
+
+	float history_depth = texture(previous_depth, uv).r;
+	if (abs(history_depth - depth) > DEPTH_TOLERANCE * max(depth, 1.0)) return vec4(-1.0);
+
+	// Keep the history within the colors marched around this block, so moving clouds do not leave trails
+	vec4 low = current, high = current;
+	ivec2 last = textureSize(march_color, 0) - 1;
+	for (int y = -1; y <= 1; y++) for (int x = -1; x <= 1; x++) {
+		vec4 neighbour = texelFetch(march_color, clamp(block + ivec2(x, y), ivec2(0), last), 0);
+		low = min(low, neighbour);
+		high = max(high, neighbour);
+	}
+
+	reprojected_depth = history_depth;
+	return clamp(texture(previous_color, uv), low, high);
+}
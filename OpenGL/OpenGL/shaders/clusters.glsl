@@ -0,0 +1,49 @@
+// The point and spot lights of the frame, assigned to a grid of clusters over the view frustum by LightClusters.
+// The sizes are the same as there
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+
+struct ClusterLight {
+	vec4 position;	// w is 0 for a point light, 1 for a spot light
+	vec4 direction;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 attenuation;	// Constant, linear, quadratic
+	vec4 cone;	// Cosines of the inner and outer cut off
+};
+
+layout(std430, binding = 3) readonly buffer ClusterLights {
+	ClusterLight cluster_lights[];
+};
+
+layout(std430, binding = 4) readonly buffer LightClusters {
+	vec4 cluster_scale;	// Clusters per pixel in x and y, slices per log of the depth and the log of the near plane in slices
+	uvec2 clusters[];	// Offset and count of the light indices of every cluster
+};
+
+layout(std430, binding = 5) readonly buffer LightIndices {
+	uint light_indices[];
+};
+
+// the offset and count of the lights of the cluster of a fragment, from its window position and view space depth
+uvec2 lightCluster(vec2 frag_coord, float depth)
+{
+	ivec2 tile = clamp(ivec2(frag_coord * cluster_scale.xy), ivec2(0), ivec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+	int slice = clamp(int(log(max(depth, 1e-4)) * cluster_scale.z - cluster_scale.w), 0, CLUSTERS_Z - 1);
+	return clusters[tile.x + CLUSTERS_X * (tile.y + CLUSTERS_Y * slice)];
+}
+
+// gathers a light of the clusters into the structs of lights.glsl, which is included first
+PointLight clusterPointLight(ClusterLight light)
+{
+	return PointLight(light.position.xyz, light.attenuation.x, light.attenuation.y, light.attenuation.z,
+		light.ambient.xyz, light.diffuse.xyz, light.specular.xyz);
+}
+
+SpotLight clusterSpotLight(ClusterLight light)
+{
+	return SpotLight(light.position.xyz, light.direction.xyz, light.cone.x, light.cone.y, light.attenuation.x, light.attenuation.y, light.attenuation.z,
+		light.ambient.xyz, light.diffuse.xyz, light.specular.xyz);
+}
@@ -4,9 +4,18 @@ out vec4 FragColor;
 in vec3 TexCoords;
 
 uniform samplerCube skybox;
+// Distant clouds from CloudSky, faded from the previous bake to the current one
+uniform samplerCube previous_clouds;
+uniform samplerCube clouds;
+uniform float clouds_blend = 0.0;
+uniform bool use_clouds = false;
 
 void main()
 {    
 	vec4 result = texture(skybox, TexCoords);
+	if (use_clouds) {
+		vec4 cloud = mix(texture(previous_clouds, TexCoords), texture(clouds, TexCoords), clouds_blend);
+		result.rgb = mix(result.rgb, cloud.rgb, cloud.a);
+	}
 	FragColor = vec4(result.x, result.y, result.z, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#version 450 core
+
+	layout(location = 0) out vec4 FragColor;
+	layout(location = 1) out vec4 BrightColor;
+
+	in vec2 UV;
+
+	#include "camera.glsl"
+	#include "lights.glsl"
+	#include "clusters.glsl"
+	#include "surface.glsl"
+	#include "shading.glsl"
+
+	// The G-buffer, see surface.glsl
+	uniform sampler2D g_albedo;
+	uniform sampler2D g_specular;
+	uniform sampler2D g_normals;
+	uniform sampler2D scene_depth;
+
+	// Of the projection the G-buffer was drawn with, jitter included
+	uniform mat4 inv_view;
+	uniform mat4 inv_proj;
+
+	// Every pixel is lit once, by the directional lights and the lights of its cluster, so the cost is the pixels
+	// plus the lights that reach them instead of the pixels times all lights
+	void main() {
+		ivec2 pixel = ivec2(gl_FragCoord.xy);
+		float depth = texelFetch(scene_depth, pixel, 0).r;
+		// No object here, the sky is drawn over it after
+		if (depth == 1.0) {
+			FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+			BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+			return;
+		}
+
+		vec4 view_point = inv_proj * vec4(UV * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+		vec3 point = (inv_view * vec4(view_point.xyz / view_point.w, 1.0)).xyz;
+		Surface surface = readSurface(texelFetch(g_albedo, pixel, 0), texelFetch(g_specular, pixel, 0), texelFetch(g_normals, pixel, 0));
+		vec3 result = shade(surface, point, gl_FragCoord.xy);
+
+		BrightColor = brightColor(result);
+		FragColor = vec4(result, 1.0);
+	}
@@ -0,0 +1,29 @@
+#version 450 core
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// Smallest (r) and largest (g) depth of every tile
+layout(rg32f, binding = 0) uniform writeonly image2D depth_tiles;
+
+uniform sampler2D depth_buffer;
+uniform int tile_size = 16;
+
+void main() {
+	ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(tile, imageSize(depth_tiles)))) return;
+
+	ivec2 size = textureSize(depth_buffer, 0);
+	ivec2 first = tile * tile_size;
+	ivec2 last = min(first + tile_size, size);
+
+	float low = 1.0, high = 0.0;
+	for (int y = first.y; y < last.y; y++) {
+		for (int x = first.x; x < last.x; x++) {
+			float depth = texelFetch(depth_buffer, ivec2(x, y), 0).r;
+			low = min(low, depth);
+			high = max(high, depth);
+		}
+	}
+
+	imageStore(depth_tiles, tile, vec4(low, high, 0.0, 0.0));
+}
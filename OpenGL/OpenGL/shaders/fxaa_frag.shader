@@ -0,0 +1,144 @@
+#version 450 core
+
+	out vec4 FragColor;
+
+	in vec2 UV;
+
+	// The tonemapped scene. It is read back as linear color, the window framebuffer converts it to sRGB again
+	uniform sampler2D image;
+	// Without FXAA the image is copied as it is, after TAA
+	uniform bool fxaa = true;
+
+	// Smallest contrast around a pixel that counts as an edge, relative to the brightest neighbour, and in dark areas
+	const float EDGE_THRESHOLD = 0.125;
+	const float EDGE_THRESHOLD_MIN = 0.0312;
+	// Steps along the edge to find where it ends, the later steps go further
+	const int SEARCH_STEPS = 10;
+	const float SEARCH_STEP_SIZES[SEARCH_STEPS] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 4.0, 8.0);
+	// How much single pixels that differ from their neighbours are blurred
+	const float SUBPIXEL_QUALITY = 0.75;
+
+	float luma(vec3 color);
+	float lumaAt(vec2 uv);
+
+	void main() {
+		vec3 center = texture(image, UV).rgb;
+		if (!fxaa) {
+			FragColor = vec4(center, 1.0);
+			return;
+		}
+
+		// Pixels without contrast are not on an edge
+		float luma_center = luma(center);
+		float luma_down = luma(textureOffset(image, UV, ivec2(0, -1)).rgb);
+		float luma_up = luma(textureOffset(image, UV, ivec2(0, 1)).rgb);
+		float luma_left = luma(textureOffset(image, UV, ivec2(-1, 0)).rgb);
+		float luma_right = luma(textureOffset(image, UV, ivec2(1, 0)).rgb);
+
+		float luma_min = min(luma_center, min(min(luma_down, luma_up), min(luma_left, luma_right)));
+		float luma_max = max(luma_center, max(max(luma_down, luma_up), max(luma_left, luma_right)));
+		float luma_range = luma_max - luma_min;
+		if (luma_range < max(EDGE_THRESHOLD_MIN, luma_max * EDGE_THRESHOLD)) {
+			FragColor = vec4(center, 1.0);
+			return;
+		}
+
+		float luma_down_left = luma(textureOffset(image, UV, ivec2(-1, -1)).rgb);
+		float luma_up_right = luma(textureOffset(image, UV, ivec2(1, 1)).rgb);
+		float luma_up_left = luma(textureOffset(image, UV, ivec2(-1, 1)).rgb);
+		float luma_down_right = luma(textureOffset(image, UV, ivec2(1, -1)).rgb);
+
+		float luma_down_up = luma_down + luma_up;
+		float luma_left_right = luma_left + luma_right;
+		float luma_left_corners = luma_down_left + luma_up_left;
+		float luma_down_corners = luma_down_left + luma_down_right;
+		float luma_right_corners = luma_down_right + luma_up_right;
+		float luma_up_corners = luma_up_right + luma_up_left;
+
+		// The edge runs the way the luma changes the least
+		float edge_horizontal = abs(-2.0 * luma_left + luma_left_corners) + abs(-2.0 * luma_center + luma_down_up) * 2.0 + abs(-2.0 * luma_right + luma_right_corners);
+		float edge_vertical = abs(-2.0 * luma_up + luma_up_corners) + abs(-2.0 * luma_center + luma_left_right) * 2.0 + abs(-2.0 * luma_down + luma_down_corners);
+		bool horizontal = edge_horizontal >= edge_vertical;
+
+		// And lies on the side of the pixel with the steepest change
+		vec2 texel = 1.0 / textureSize(image, 0);
+		float luma_1 = horizontal ? luma_down : luma_left;
+		float luma_2 = horizontal ? luma_up : luma_right;
+		float gradient_1 = luma_1 - luma_center;
+		float gradient_2 = luma_2 - luma_center;
+		bool steepest_1 = abs(gradient_1) >= abs(gradient_2);
+		float gradient_scaled = 0.25 * max(abs(gradient_1), abs(gradient_2));
+
+		float step_length = horizontal ? texel.y : texel.x;
+		float luma_local_average;
+		if (steepest_1) {
+			step_length = -step_length;
+			luma_local_average = 0.5 * (luma_1 + luma_center);
+		}
+		else {
+			luma_local_average = 0.5 * (luma_2 + luma_center);
+		}
+
+		// Walk along the edge, halfway between the pixel and its neighbour, both ways until the luma changes
+		vec2 edge_uv = UV;
+		if (horizontal)
+			edge_uv.y += step_length * 0.5;
+		else
+			edge_uv.x += step_length * 0.5;
+		vec2 offset = horizontal ? vec2(texel.x, 0.0) : vec2(0.0, texel.y);
+
+		vec2 uv_1 = edge_uv - offset * SEARCH_STEP_SIZES[0];
+		vec2 uv_2 = edge_uv + offset * SEARCH_STEP_SIZES[0];
+		float luma_end_1 = lumaAt(uv_1) - luma_local_average;
+		float luma_end_2 = lumaAt(uv_2) - luma_local_average;
+		bool reached_1 = abs(luma_end_1) >= gradient_scaled;
+		bool reached_2 = abs(luma_end_2) >= gradient_scaled;
+
+		for (int i = 1; i < SEARCH_STEPS && !(reached_1 && reached_2); i++) {
+			if (!reached_1) {
+				uv_1 -= offset * SEARCH_STEP_SIZES[i];
+				luma_end_1 = lumaAt(uv_1) - luma_local_average;
+				reached_1 = abs(luma_end_1) >= gradient_scaled;
+			}
+			if (!reached_2) {
+				uv_2 += offset * SEARCH_STEP_SIZES[i];
+				luma_end_2 = lumaAt(uv_2) - luma_local_average;
+				reached_2 = abs(luma_end_2) >= gradient_scaled;
+			}
+		}
+
+		// The closer the pixel is to the end of the edge, the more it is blended with the other side
+		float distance_1 = horizontal ? UV.x - uv_1.x : UV.y - uv_1.y;
+		float distance_2 = horizontal ? uv_2.x - UV.x : uv_2.y - UV.y;
+		bool direction_1 = distance_1 < distance_2;
+		float distance_final = min(distance_1, distance_2);
+		float edge_length = distance_1 + distance_2;
+		float pixel_offset = -distance_final / edge_length + 0.5;
+
+		// Only when the luma at that end changes the same way as at the pixel
+		bool center_smaller = luma_center < luma_local_average;
+		bool correct_variation = ((direction_1 ? luma_end_1 : luma_end_2) < 0.0) != center_smaller;
+		float final_offset = correct_variation ? pixel_offset : 0.0;
+
+		// Single pixels are blended with their neighbours by how much they stand out
+		float luma_average = (1.0 / 12.0) * (2.0 * (luma_down_up + luma_left_right) + luma_left_corners + luma_right_corners);
+		float subpixel_1 = clamp(abs(luma_average - luma_center) / luma_range, 0.0, 1.0);
+		float subpixel_2 = (-2.0 * subpixel_1 + 3.0) * subpixel_1 * subpixel_1;
+		final_offset = max(final_offset, subpixel_2 * subpixel_2 * SUBPIXEL_QUALITY);
+
+		vec2 final_uv = UV;
+		if (horizontal)
+			final_uv.y += final_offset * step_length;
+		else
+			final_uv.x += final_offset * step_length;
+		FragColor = vec4(texture(image, final_uv).rgb, 1.0);
+	}
+
+	// Perceived brightness, the edges are found in gamma space like the eye sees them
+	float luma(vec3 color) {
+		return sqrt(dot(color, vec3(0.299, 0.587, 0.114)));
+	}
+
+	float lumaAt(vec2 uv) {
+		return luma(texture(image, uv).rgb);
+	}
@@ -0,0 +1,27 @@
+#version 450 core
+
+// The surface of the objects for the deferred path, lit later for every pixel once
+layout(location = 0) out vec4 GAlbedo;
+layout(location = 1) out vec4 GSpecular;
+layout(location = 2) out vec4 GNormals;
+
+#include "surface.glsl"
+#include "material.glsl"
+
+in vec3 Point;
+in vec3 Normal;
+in vec3 Color;
+in vec2 UV;
+#ifdef NORMAL_MAP
+in mat3 TBN;
+#endif
+
+void main()
+{
+#ifdef NORMAL_MAP
+	Surface surface = materialSurface(UV, Normal, TBN);
+#else
+	Surface surface = materialSurface(UV, Normal, mat3(1.0));
+#endif
+	writeSurface(surface, GAlbedo, GSpecular, GNormals);
+}
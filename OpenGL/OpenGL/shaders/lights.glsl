@@ -0,0 +1,96 @@
+#define MAX_LIGHTS 20
+
+struct DirectionLight {
+	vec3 direction;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+struct PointLight {
+	vec3 position;
+
+	float constant;
+	float linear;
+	float quadratic;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+struct SpotLight {
+	vec3 position;
+	vec3 direction;
+	float cutOff;
+	float outerCutOff;
+
+	float constant;
+	float linear;
+	float quadratic;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+// Shared by every program, only the lights that changed are written. Every property is its own array
+layout(std140, binding = 1) uniform Lights {
+	vec4 directional_direction[MAX_LIGHTS];
+	vec4 directional_ambient[MAX_LIGHTS];
+	vec4 directional_diffuse[MAX_LIGHTS];
+	vec4 directional_specular[MAX_LIGHTS];
+	vec4 point_position[MAX_LIGHTS];
+	vec4 point_ambient[MAX_LIGHTS];
+	vec4 point_diffuse[MAX_LIGHTS];
+	vec4 point_specular[MAX_LIGHTS];
+	vec4 point_attenuation[MAX_LIGHTS];
+	vec4 spot_position[MAX_LIGHTS];
+	vec4 spot_direction[MAX_LIGHTS];
+	vec4 spot_ambient[MAX_LIGHTS];
+	vec4 spot_diffuse[MAX_LIGHTS];
+	vec4 spot_specular[MAX_LIGHTS];
+	vec4 spot_attenuation[MAX_LIGHTS];
+	vec4 spot_cone[MAX_LIGHTS];
+	vec4 light_positions[MAX_LIGHTS];
+	ivec4 light_counts;
+};
+
+// Variants built for a scene have its light counts compiled in, so the loops over the lights are unrolled. Without
+// them the counts are read from the block
+#ifndef DIRECTIONAL_LIGHTS
+#define DIRECTIONAL_LIGHTS light_counts.x
+#endif
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS light_counts.y
+#endif
+#ifndef SPOT_LIGHTS
+#define SPOT_LIGHTS light_counts.z
+#endif
+#ifdef LIGHT_POSITIONS
+#define LIGHT_POSITION_SLOTS max(LIGHT_POSITIONS, 1)
+#else
+#define LIGHT_POSITIONS light_counts.w
+#define LIGHT_POSITION_SLOTS MAX_LIGHTS
+#endif
+
+// gathers the properties of a light from the arrays of the light block
+DirectionLight directionalLight(int i)
+{
+	return DirectionLight(directional_direction[i].xyz, directional_ambient[i].xyz, directional_diffuse[i].xyz, directional_specular[i].xyz);
+}
+
+PointLight pointLight(int i)
+{
+	vec3 attenuation = point_attenuation[i].xyz;
+	return PointLight(point_position[i].xyz, attenuation.x, attenuation.y, attenuation.z,
+		point_ambient[i].xyz, point_diffuse[i].xyz, point_specular[i].xyz);
+}
+
+SpotLight spotLight(int i)
+{
+	vec3 attenuation = spot_attenuation[i].xyz;
+	return SpotLight(spot_position[i].xyz, spot_direction[i].xyz, spot_cone[i].x, spot_cone[i].y, attenuation.x, attenuation.y, attenuation.z,
+		spot_ambient[i].xyz, spot_diffuse[i].xyz, spot_specular[i].xyz);
+}
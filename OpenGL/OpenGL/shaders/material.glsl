@@ -0,0 +1,62 @@
+// The slots of the maps of a material, in the order of MaterialLibrary::Slot
+#define DIFFUSE_SLOT 0
+#define SPECULAR_SLOT 1
+#define NORMAL_SLOT 2
+#define DISPLACEMENT_SLOT 3
+#define AO_SLOT 4
+// Arrays of one slot, MaterialLibrary::MAX_ARRAYS
+#define MATERIAL_ARRAYS 3
+
+// Array and layer of the maps of a material for every slot, the layer is -1 without a map
+struct Material {
+	int layers[5];
+	int arrays[5];
+	float shininess;
+	int padding;
+};
+
+// The maps of all materials, arrays of the sizes and formats of every slot, bound once a frame
+uniform sampler2DArray diffuse_maps[MATERIAL_ARRAYS];
+uniform sampler2DArray specular_maps[MATERIAL_ARRAYS];
+uniform sampler2DArray normal_maps[MATERIAL_ARRAYS];
+uniform sampler2DArray displacement_maps[MATERIAL_ARRAYS];
+uniform sampler2DArray ao_maps[MATERIAL_ARRAYS];
+
+layout(std430, binding = 2) readonly buffer Materials {
+	Material materials[];
+};
+
+// The only thing a draw sets about its material
+uniform int material_index;
+
+// Features of the material, set when the variant is built:
+//	NORMAL_MAP   - lit from the normal map as well
+//	SPECULAR_MAP - has specular highlights, without it they are left out
+
+// samples the maps of the material of the draw, once for all the lights. tbn goes from tangent to world space, and
+// is only read with a normal map. After surface.glsl
+Surface materialSurface(vec2 uv, vec3 normal, mat3 tbn)
+{
+	Material material = materials[material_index];
+	Surface surface;
+	surface.diffuse = texture(diffuse_maps[material.arrays[DIFFUSE_SLOT]], vec3(uv, material.layers[DIFFUSE_SLOT])).rgb;
+#ifdef SPECULAR_MAP
+	surface.specular = texture(specular_maps[material.arrays[SPECULAR_SLOT]], vec3(uv, material.layers[SPECULAR_SLOT])).rgb;
+#else
+	// black without a specular map, as an unbound texture would be
+	surface.specular = vec3(0.0);
+#endif
+	surface.shininess = material.shininess;
+	surface.normal = normalize(normal);
+#ifdef NORMAL_MAP
+	// Only x and y are stored (BC5), z is rebuilt from them
+	vec2 normal_xy = texture(normal_maps[material.arrays[NORMAL_SLOT]], vec3(uv, material.layers[NORMAL_SLOT])).rg * 2.0 - 1.0;
+	vec3 tangent_normal = vec3(normal_xy, sqrt(max(1.0 - dot(normal_xy, normal_xy), 0.0)));
+	surface.normal_mapped = true;
+	surface.mapped_normal = normalize(tbn * tangent_normal);
+#else
+	surface.normal_mapped = false;
+	surface.mapped_normal = surface.normal;
+#endif
+	return surface;
+}
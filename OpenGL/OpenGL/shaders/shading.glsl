@@ -0,0 +1,127 @@
+// Lighting of a surface, the same for the forward and the deferred path. After camera.glsl, lights.glsl,
+// clusters.glsl and surface.glsl
+#define DIRLIGHT_STRENGTH 1.0
+#define POINTLIGHT_STRENGTH 1.0
+#define SPOTLIGHT_STRENGTH 1.0
+#define NORMAL_STRENGTH 0.5
+#define BLINN
+
+vec3 CalcDirectionLight(DirectionLight light, Surface surface, vec3 view_direction);
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 point, vec3 view_direction);
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 point, vec3 view_direction);
+vec3 CalcNormals(vec3 light_position, Surface surface, vec3 point, vec3 view_direction);
+
+// the color of a surface at a point, lit by the directional lights and the point and spot lights of its cluster
+vec3 shade(Surface surface, vec3 point, vec2 frag_coord)
+{
+	// Make sure view_direction is normalized for angle comparisons.
+	vec3 view_direction = normalize(view_position.xyz - point);
+
+	vec3 result = vec3(0.0f);
+	// Calculate directional light(s)
+	for (int i = 0; i < DIRECTIONAL_LIGHTS; i++)
+		result += CalcDirectionLight(directionalLight(i), surface, view_direction) * DIRLIGHT_STRENGTH;
+	// Calculate the point and spot light(s) of the cluster of the point
+	uvec2 cluster = lightCluster(frag_coord, -(view * vec4(point, 1.0)).z);
+	for (uint i = 0; i < cluster.y; i++) {
+		ClusterLight light = cluster_lights[light_indices[cluster.x + i]];
+		if (light.position.w == 0.0)
+			result += CalcPointLight(clusterPointLight(light), surface, point, view_direction) * POINTLIGHT_STRENGTH;
+		else
+			result += CalcSpotLight(clusterSpotLight(light), surface, point, view_direction) * SPOTLIGHT_STRENGTH;
+		// Calculate normals
+		if (surface.normal_mapped)
+			result += CalcNormals(light.position.xyz, surface, point, view_direction) * NORMAL_STRENGTH;
+	}
+	return result;
+}
+
+// what goes on to the bloom, the parts brighter than white
+vec4 brightColor(vec3 color)
+{
+	float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+	if (brightness > 1.0)
+		return vec4(color, 1.0);
+	return vec4(0.0, 0.0, 0.0, 1.0);
+}
+
+// calculates the color when using a directional light.
+vec3 CalcDirectionLight(DirectionLight light, Surface surface, vec3 view_direction)
+{
+	vec3 light_direction = normalize(-light.direction);
+	// diffuse shading
+	float angle = max(dot(surface.normal, light_direction), 0.0);
+	// specular shading
+	vec3 reflect_direction = reflect(-light_direction, surface.normal);
+	float spec = pow(max(dot(view_direction, reflect_direction), 0.0), surface.shininess);
+	// combine results
+	vec3 ambient = light.ambient * surface.diffuse;
+	vec3 diffuse = light.diffuse * angle * surface.diffuse;
+	vec3 specular = light.specular * spec * surface.specular;
+	return (ambient + diffuse + specular);
+}
+
+// calculates the color when using a point light.
+vec3 CalcPointLight(PointLight light, Surface surface, vec3 point, vec3 view_direction)
+{
+	vec3 light_direction = normalize(light.position - point);
+	// diffuse shading
+	float angle = max(dot(surface.normal, light_direction), 0.0);
+	// specular shading, blinn-pong
+#ifdef BLINN
+	vec3 halfway_direction = normalize(light_direction + view_direction);
+	float spec = pow(max(dot(surface.normal, halfway_direction), 0.0), 32.0);
+#else
+	vec3 reflect_direction = reflect(-light_direction, surface.normal);
+	float spec = pow(max(dot(view_direction, reflect_direction), 0.0), surface.shininess);
+#endif
+	// attenuation
+	float distance = length(light.position - point);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	// combine results
+	vec3 ambient = light.ambient * surface.diffuse * attenuation;
+	vec3 diffuse = light.diffuse * angle * surface.diffuse * attenuation;
+	vec3 specular = light.specular * spec * surface.specular * attenuation;
+
+	return (ambient + diffuse + specular);
+}
+
+// calculates the color when using a spot light.
+vec3 CalcSpotLight(SpotLight light, Surface surface, vec3 point, vec3 view_direction)
+{
+	vec3 light_direction = normalize(light.position - point);
+	// diffuse shading
+	float angle = max(dot(surface.normal, light_direction), 0.0);
+	// specular shading
+	vec3 reflect_direction = reflect(-light_direction, surface.normal);
+	float spec = pow(max(dot(view_direction, reflect_direction), 0.0), surface.shininess);
+	// attenuation
+	float distance = length(light.position - point);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	// spotlight intensity
+	float theta = dot(light_direction, normalize(-light.direction));
+	float epsilon = light.cutOff - light.outerCutOff;
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+	// combine results
+	vec3 ambient = light.ambient * surface.diffuse * attenuation * intensity;
+	vec3 diffuse = light.diffuse * angle * surface.diffuse * attenuation * intensity;
+	vec3 specular = light.specular * spec * surface.specular * attenuation * intensity;
+
+	return (ambient + diffuse + specular);
+}
+
+// calculates the light on the normal from the normal map. The mapped normal is in world space, so are the directions
+vec3 CalcNormals(vec3 light_position, Surface surface, vec3 point, vec3 view_direction)
+{
+	// angle
+	vec3 light_direction = normalize(light_position - point);
+	float angle = max(dot(light_direction, surface.mapped_normal), 0.0);
+	// ambient & diffuse
+	vec3 ambient = 0.1 * surface.diffuse;
+	vec3 diffuse = 0.5 * surface.diffuse;
+	// specular
+	vec3 halfway_direction = normalize(light_direction + view_direction);
+	float specular = pow(max(dot(surface.mapped_normal, halfway_direction), 0.0), 32.0) * 0.2;
+
+	return (ambient + diffuse * angle + specular * angle);
+}
@@ -0,0 +1,51 @@
+// What the lights shade at a point of an object, sampled once from the maps of its material
+struct Surface {
+	vec3 diffuse;
+	vec3 specular;
+	float shininess;
+	vec3 normal;	// Of the geometry, normalized
+	bool normal_mapped;
+	vec3 mapped_normal;	// From the normal map, in world space
+};
+
+// The G-buffer of the deferred path:
+//	albedo   - sRGB diffuse color, alpha is 1 with a normal map
+//	specular - sRGB specular color, alpha is the shininess / MAX_SHININESS
+//	normals  - the normal and the mapped normal, both octahedral encoded
+#define MAX_SHININESS 256.0
+
+// a unit vector folded onto the octahedron and flattened, two values in [-1, 1]
+vec2 encodeNormal(vec3 normal)
+{
+	normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+	if (normal.z >= 0.0)
+		return normal.xy;
+	return (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 decodeNormal(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.xy += vec2(normal.x >= 0.0 ? -fold : fold, normal.y >= 0.0 ? -fold : fold);
+	return normalize(normal);
+}
+
+void writeSurface(Surface surface, out vec4 albedo, out vec4 specular, out vec4 normals)
+{
+	albedo = vec4(surface.diffuse, surface.normal_mapped ? 1.0 : 0.0);
+	specular = vec4(surface.specular, clamp(surface.shininess / MAX_SHININESS, 0.0, 1.0));
+	normals = vec4(encodeNormal(surface.normal), encodeNormal(surface.mapped_normal));
+}
+
+Surface readSurface(vec4 albedo, vec4 specular, vec4 normals)
+{
+	Surface surface;
+	surface.diffuse = albedo.rgb;
+	surface.specular = specular.rgb;
+	surface.shininess = specular.a * MAX_SHININESS;
+	surface.normal = decodeNormal(normals.xy);
+	surface.normal_mapped = albedo.a > 0.5;
+	surface.mapped_normal = decodeNormal(normals.zw);
+	return surface;
+}
@@ -0,0 +1,64 @@
+#version 450 core
+
+	layout(location = 0) out vec4 history_color;
+
+	in vec2 UV;
+
+	// The tonemapped scene of this frame, rendered with a jittered projection
+	uniform sampler2D current_color;
+	// The blended frames up to the previous frame
+	uniform sampler2D previous_color;
+	// Depth of the scene, to find where the pixel was on the previous frame
+	uniform sampler2D scene_depth;
+
+	uniform bool history_valid = false;
+	// Weight of this frame in the history
+	uniform float blend = 0.1;
+
+	uniform mat4 inv_view;
+	uniform mat4 inv_proj;
+	uniform mat4 previous_view;
+	uniform mat4 previous_proj;
+
+	vec2 reproject(vec2 uv);
+
+	void main() {
+		ivec2 pixel = ivec2(gl_FragCoord.xy);
+		ivec2 size = textureSize(current_color, 0);
+		vec3 current = texelFetch(current_color, pixel, 0).rgb;
+
+		if (!history_valid) {
+			history_color = vec4(current, 1.0);
+			return;
+		}
+
+		vec2 previous_uv = reproject(UV);
+		if (any(lessThan(previous_uv, vec2(0.0))) || any(greaterThan(previous_uv, vec2(1.0)))) {
+			history_color = vec4(current, 1.0);
+			return;
+		}
+
+		// The history is kept within the colors around the pixel, so what moved or was uncovered does not leave ghosts
+		vec3 low = current;
+		vec3 high = current;
+		for (int y = -1; y <= 1; y++) {
+			for (int x = -1; x <= 1; x++) {
+				vec3 neighbour = texelFetch(current_color, clamp(pixel + ivec2(x, y), ivec2(0), size - 1), 0).rgb;
+				low = min(low, neighbour);
+				high = max(high, neighbour);
+			}
+		}
+		vec3 history = clamp(texture(previous_color, previous_uv).rgb, low, high);
+
+		history_color = vec4(mix(history, current, blend), 1.0);
+	}
+
+	// Where the scene seen through this pixel was on the previous frame, following the camera. Objects that move are
+	// caught by the clamp
+	vec2 reproject(vec2 uv) {
+		float depth = texture(scene_depth, uv).r;
+		vec4 view_position = inv_proj * vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+		vec4 world_position = inv_view * vec4(view_position.xyz / view_position.w, 1.0);
+		vec4 previous_position = previous_proj * previous_view * world_position;
+		return previous_position.xy / previous_position.w * 0.5 + 0.5;
+	}